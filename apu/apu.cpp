@@ -11,6 +11,7 @@
 #include "../msu1.h"
 #include "../snapshot.h"
 #include "../display.h"
+#include "../profile.h"
 #include "resampler.h"
 
 #include "bapu/snes/snes.hpp"
@@ -30,35 +31,37 @@ static const int MINIMUM_BUFFER_SIZE = 550 * 2;
 
 namespace SNES {
 #include "bapu/dsp/blargg_endian.h"
-CPU cpu;
+S9X_INSTANCE CPU cpu;
 } // namespace SNES
 
 namespace spc {
-static apu_callback callback = NULL;
-static void *callback_data = NULL;
+S9X_INSTANCE_STATIC apu_callback callback = NULL;
+S9X_INSTANCE_STATIC void *callback_data = NULL;
 
-static bool8 sound_in_sync = true;
-static bool8 sound_enabled = false;
+S9X_INSTANCE_STATIC bool8 sound_in_sync = true;
+S9X_INSTANCE_STATIC bool8 sound_enabled = false;
 
-static Resampler resampler;
+S9X_INSTANCE_STATIC Resampler resampler;
+// receives samples that must not be heard, see S9xSetSoundDiscard
+S9X_INSTANCE_STATIC Resampler discard_resampler(MINIMUM_BUFFER_SIZE);
 
-static int32 reference_time;
-static uint32 remainder;
+S9X_INSTANCE_STATIC int32 reference_time;
+S9X_INSTANCE_STATIC uint32 remainder;
 
 static const int timing_hack_numerator = 256;
-static int timing_hack_denominator = 256;
+S9X_INSTANCE_STATIC int timing_hack_denominator = 256;
 /* Set these to NTSC for now. Will change to PAL in S9xAPUTimingSetSpeedup
    if necessary on game load. */
-static uint32 ratio_numerator = APU_NUMERATOR_NTSC;
-static uint32 ratio_denominator = APU_DENOMINATOR_NTSC;
+S9X_INSTANCE_STATIC uint32 ratio_numerator = APU_NUMERATOR_NTSC;
+S9X_INSTANCE_STATIC uint32 ratio_denominator = APU_DENOMINATOR_NTSC;
 
-static double dynamic_rate_multiplier = 1.0;
+S9X_INSTANCE_STATIC double dynamic_rate_multiplier = 1.0;
 } // namespace spc
 
 namespace msu {
 // Always 16-bit, Stereo; 1.5x dsp buffer to never overflow
-static Resampler resampler;
-static std::vector<int16_t> resampler_buffer;
+S9X_INSTANCE_STATIC Resampler resampler;
+S9X_INSTANCE_STATIC std::vector<int16_t> resampler_buffer;
 } // namespace msu
 
 static void UpdatePlaybackRate(void);
@@ -214,6 +217,23 @@ void S9xSetSoundMute(bool8 mute)
         Settings.Mute = true;
 }
 
+void S9xSetSoundDiscard(bool8 discard)
+{
+    // Frames emulated a second time (netplay rollback) have already been
+    // heard, so their samples go to a scratch buffer instead of the output.
+    if (discard)
+    {
+        spc::discard_resampler.clear();
+        SNES::dsp.spc_dsp.set_output(&spc::discard_resampler);
+        S9xMSU1SetOutput(&spc::discard_resampler);
+    }
+    else
+    {
+        SNES::dsp.spc_dsp.set_output(&spc::resampler);
+        S9xMSU1SetOutput(&msu::resampler);
+    }
+}
+
 void S9xDumpSPCSnapshot(void)
 {
     SNES::dsp.spc_dsp.dump_spc_snapshot();
@@ -273,6 +293,9 @@ void S9xAPUExecute(void)
     int cycles = S9xAPUGetClock(CPU.Cycles);
     spc::remainder = S9xAPUGetClockRemainder(CPU.Cycles);
     SNES::smp.clock -= cycles;
+#ifdef DEBUGGER
+    S9xProfileSMPClock(cycles);
+#endif
     SNES::smp.enter();
 
     S9xAPUSetReferenceTime(CPU.Cycles);
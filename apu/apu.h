@@ -37,6 +37,7 @@ bool8 S9xSyncSound (void);
 int S9xGetSampleCount (void);
 void S9xSetSoundControl (uint8);
 void S9xSetSoundMute (bool8);
+void S9xSetSoundDiscard (bool8);
 void S9xLandSamples (void);
 void S9xClearSamples (void);
 bool8 S9xMixSamples (uint8 *, int);
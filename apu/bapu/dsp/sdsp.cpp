@@ -3,7 +3,7 @@
 #define DSP_CPP
 namespace SNES {
 
-DSP dsp;
+S9X_INSTANCE DSP dsp;
 
 #include "SPC_DSP.cpp"
 
@@ -42,9 +42,4 @@ void DSP::load_state (uint8 **ptr)
 	spc_dsp.copy_state(ptr, to_dsp_from_state);
 }
 
-DSP::DSP()
-{
-	clock = 0;
-}
-
 }
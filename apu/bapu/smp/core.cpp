@@ -66,6 +66,10 @@ void SMP::op_step() {
     }
 #endif
     opcode_number = op_readpc();
+#ifdef DEBUGGER
+    if (S9xProfile.Targets & (1 << PROFILE_SMP))
+      S9xProfileSMP(regs.pc - 1, regs.sp, opcode_number, clock);
+#endif
   }
 
   switch(opcode_number) {
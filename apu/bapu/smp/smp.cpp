@@ -1,6 +1,7 @@
 #ifdef DEBUGGER
 #include "../../../snes9x.h"
 #include "../../../debug.h"
+#include "../../../profile.h"
 char tmp[1024];
 #endif
 
@@ -13,7 +14,7 @@ namespace SNES {
 #include "debugger/disassembler.cpp"
 #endif
 
-SMP smp;
+S9X_INSTANCE SMP smp;
 
 #include "algorithms.cpp"
 #include "core.cpp"
@@ -65,12 +66,4 @@ void SMP::reset() {
   timer0.stage3_ticks = timer1.stage3_ticks = timer2.stage3_ticks = 0;
 }
 
-SMP::SMP() {
-  apuram = new uint8[64 * 1024];
-}
-
-SMP::~SMP() {
-	delete[] apuram;
-}
-
 }
@@ -1,7 +1,7 @@
 class SMP : public Processor {
 public:
   static const uint8 iplrom[64];
-  uint8 *apuram;
+  uint8 apuram[64 * 1024];
 
   unsigned port_read(unsigned port);
   void port_write(unsigned port, unsigned data);
@@ -16,8 +16,6 @@ public:
   void load_state(uint8 **);
   void save_state(uint8 **);
   void save_spc (uint8 *);
-  SMP();
-  ~SMP();
 
 //private:
   struct Flags {
@@ -123,4 +121,4 @@ public:
 #endif
 };
 
-extern SMP smp;
+extern S9X_INSTANCE SMP smp;
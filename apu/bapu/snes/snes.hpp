@@ -40,7 +40,7 @@ public:
     }
 };
 
-extern CPU cpu;
+extern S9X_INSTANCE CPU cpu;
 
 } // namespace SNES
 
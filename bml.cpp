@@ -122,7 +122,7 @@ static void bml_parse_data(bml_node &node, std::string_view &line)
     }
 }
 
-static std::string bml_read_line(std::ifstream &fd)
+static std::string bml_read_line(std::istream &fd)
 {
     std::string line;
 
@@ -222,7 +222,7 @@ void bml_node::print()
     bml_print_node(*this, -1);
 }
 
-void bml_node::parse(std::ifstream &fd)
+void bml_node::parse(std::istream &fd)
 {
     std::stack<bml_node *> nodestack;
     nodestack.push(this);
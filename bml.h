@@ -13,7 +13,7 @@ struct bml_node
 
     bml_node();
     bool parse_file(const std::string &filename);
-    void parse(std::ifstream &fd);
+    void parse(std::istream &fd);
     bml_node *find_subnode(const std::string &name);
     void print();
 
@@ -46,7 +46,7 @@ struct SBSX_RTC
 	int	ticks;
 };
 
-static struct SBSX_RTC	BSX_RTC;
+S9X_INSTANCE_STATIC struct SBSX_RTC	BSX_RTC;
 
 // flash card vendor information
 static const uint8	flashcard[20] =
@@ -72,9 +72,9 @@ static const uint8	init2192[32] =	// FIXME
 };
 #endif
 
-static bool8	FlashMode;
-static uint32	FlashSize;
-static uint8	*MapROM, *FlashROM;
+S9X_INSTANCE_STATIC bool8	FlashMode;
+S9X_INSTANCE_STATIC uint32	FlashSize;
+S9X_INSTANCE_STATIC uint8	*MapROM, *FlashROM;
 
 static void BSX_Map_SNES (void);
 static void BSX_Map_LoROM (void);
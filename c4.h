@@ -7,18 +7,18 @@
 #ifndef _C4_H_
 #define _C4_H_
 
-extern int16	C4WFXVal;
-extern int16	C4WFYVal;
-extern int16	C4WFZVal;
-extern int16	C4WFX2Val;
-extern int16	C4WFY2Val;
-extern int16	C4WFDist;
-extern int16	C4WFScale;
-extern int16	C41FXVal;
-extern int16	C41FYVal;
-extern int16	C41FAngleRes;
-extern int16	C41FDist;
-extern int16	C41FDistVal;
+extern S9X_INSTANCE int16	C4WFXVal;
+extern S9X_INSTANCE int16	C4WFYVal;
+extern S9X_INSTANCE int16	C4WFZVal;
+extern S9X_INSTANCE int16	C4WFX2Val;
+extern S9X_INSTANCE int16	C4WFY2Val;
+extern S9X_INSTANCE int16	C4WFDist;
+extern S9X_INSTANCE int16	C4WFScale;
+extern S9X_INSTANCE int16	C41FXVal;
+extern S9X_INSTANCE int16	C41FYVal;
+extern S9X_INSTANCE int16	C41FAngleRes;
+extern S9X_INSTANCE int16	C41FDist;
+extern S9X_INSTANCE int16	C41FDistVal;
 
 void C4TransfWireFrame (void);
 void C4TransfWireFrame2 (void);
@@ -5,6 +5,10 @@
 \*****************************************************************************/
 
 #include <ctype.h>
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define CHEAT_SSE2
+#endif
 #include "snes9x.h"
 #include "memmap.h"
 #include "cheats.h"
@@ -37,247 +41,239 @@
 	 (s) == S9X_24_BITS ? (((int32) ((*((m) + (o)) + (*((m) + (o) + 1) << 8) + (*((m) + (o) + 2) << 16)) << 8)) >> 8): \
                            ((int32)  (*((m) + (o)) + (*((m) + (o) + 1) << 8) + (*((m) + (o) + 2) << 16) + (*((m) + (o) + 3) << 24))))
 
-void S9xStartCheatSearch (SCheatData *d)
+// Searches keep one candidate bit per address, 32 to a word. Words with no
+// candidates left are skipped, so a search gets quicker as it narrows down,
+// and the others are compared a word, 32 addresses, at a time. Every
+// comparison, size and signedness is a function of its own, picked once per
+// search; 8-bit ones, the most common, compare 16 bytes at once with SSE2.
+
+typedef uint32 (*CheatMatcher) (const uint8 *, const uint8 *, int64, int);
+
+template <S9xCheatComparisonType cmp>
+static inline bool CheatCompare (int64 a, int64 b)
 {
-	memmove(d->CWRAM, d->RAM, 0x20000);
-	memmove(d->CSRAM, d->SRAM, 0x80000);
-	memmove(d->CIRAM, &d->FillRAM[0x3000], 0x2000);
-	memset((char *) d->ALL_BITS, 0xff, 0x32000 >> 3);
+	return (_S9XCHTC(cmp, a, b));
 }
 
-void S9xSearchForChange (SCheatData *d, S9xCheatComparisonType cmp, S9xCheatDataSize size, bool8 is_signed, bool8 update)
+template <S9xCheatDataSize size, bool is_signed>
+static inline int64 CheatLoad (const uint8 *m)
 {
-	int	l, i;
+	return (is_signed ? (int64) _S9XCHTDS(size, m, 0) : (int64) _S9XCHTD(size, m, 0));
+}
 
-	switch (size)
+// Compares the values at the first count addresses of cur with those at prev,
+// or with value if prev is NULL, and returns one bit per address that passes.
+template <S9xCheatComparisonType cmp, S9xCheatDataSize size, bool is_signed, bool change>
+static uint32 CheatMatch (const uint8 *cur, const uint8 *prev, int64 value, int count)
+{
+	uint32	m = 0;
+
+	for (int k = 0; k < count; k++)
 	{
-		case S9X_8_BITS:	l = 0; break;
-		case S9X_16_BITS:	l = 1; break;
-		case S9X_24_BITS:	l = 2; break;
-		default:
-		case S9X_32_BITS:	l = 3; break;
+		int64	a = CheatLoad<size, is_signed>(cur + k);
+		int64	b = change ? CheatLoad<size, is_signed>(prev + k) : value;
+		m |= (uint32) CheatCompare<cmp>(a, b) << k;
 	}
 
-	if (is_signed)
-	{
-		for (i = 0; i < 0x20000 - l; i++)
-		{
-			if (TEST_BIT(d->WRAM_BITS, i) && _S9XCHTC(cmp, _S9XCHTDS(size, d->RAM, i), _S9XCHTDS(size, d->CWRAM, i)))
-			{
-				if (update)
-					d->CWRAM[i] = d->RAM[i];
-			}
-			else
-				BIT_CLEAR(d->WRAM_BITS, i);
-		}
+	return (m);
+}
 
-		for (i = 0; i < 0x10000 - l; i++)
-		{
-			if (TEST_BIT(d->SRAM_BITS, i) && _S9XCHTC(cmp, _S9XCHTDS(size, d->SRAM, i), _S9XCHTDS(size, d->CSRAM, i)))
-			{
-				if (update)
-					d->CSRAM[i] = d->SRAM[i];
-			}
-			else
-				BIT_CLEAR(d->SRAM_BITS, i);
-		}
+#ifdef CHEAT_SSE2
+template <S9xCheatComparisonType cmp>
+static inline uint32 CheatMatch16 (__m128i a, __m128i b)
+{
+	__m128i	r;
 
-		for (i = 0; i < 0x2000 - l; i++)
-		{
-			if (TEST_BIT(d->IRAM_BITS, i) && _S9XCHTC(cmp, _S9XCHTDS(size, d->FillRAM + 0x3000, i), _S9XCHTDS(size, d->CIRAM, i)))
-			{
-				if (update)
-					d->CIRAM[i] = d->FillRAM[i + 0x3000];
-			}
-			else
-				BIT_CLEAR(d->IRAM_BITS, i);
-		}
-	}
-	else
+	switch (cmp)
 	{
-		for (i = 0; i < 0x20000 - l; i++)
-		{
-			if (TEST_BIT(d->WRAM_BITS, i) && _S9XCHTC(cmp, _S9XCHTD(size, d->RAM, i), _S9XCHTD(size, d->CWRAM, i)))
-			{
-				if (update)
-					d->CWRAM[i] = d->RAM[i];
-			}
-			else
-				BIT_CLEAR(d->WRAM_BITS, i);
-		}
-
-		for (i = 0; i < 0x10000 - l; i++)
-		{
-			if (TEST_BIT(d->SRAM_BITS, i) && _S9XCHTC(cmp, _S9XCHTD(size, d->SRAM, i), _S9XCHTD(size, d->CSRAM, i)))
-			{
-				if (update)
-					d->CSRAM[i] = d->SRAM[i];
-			}
-			else
-				BIT_CLEAR(d->SRAM_BITS, i);
-		}
-
-		for (i = 0; i < 0x2000 - l; i++)
-		{
-			if (TEST_BIT(d->IRAM_BITS, i) && _S9XCHTC(cmp, _S9XCHTD(size, d->FillRAM + 0x3000, i), _S9XCHTD(size, d->CIRAM, i)))
-			{
-				if (update)
-					d->CIRAM[i] = d->FillRAM[i + 0x3000];
-			}
-			else
-				BIT_CLEAR(d->IRAM_BITS, i);
-		}
+		case S9X_LESS_THAN:				r = _mm_cmplt_epi8(a, b); break;
+		case S9X_GREATER_THAN:			r = _mm_cmpgt_epi8(a, b); break;
+		case S9X_LESS_THAN_OR_EQUAL:	r = _mm_cmpgt_epi8(a, b); break;
+		case S9X_GREATER_THAN_OR_EQUAL:	r = _mm_cmplt_epi8(a, b); break;
+		case S9X_EQUAL:					r = _mm_cmpeq_epi8(a, b); break;
+		default:						r = _mm_cmpeq_epi8(a, b); break;
 	}
 
-	for (i = 0x20000 - l; i < 0x20000; i++)
-		BIT_CLEAR(d->WRAM_BITS, i);
+	uint32	m = _mm_movemask_epi8(r);
+
+	// The rest are the opposites of the above.
+	if (cmp == S9X_LESS_THAN_OR_EQUAL || cmp == S9X_GREATER_THAN_OR_EQUAL || cmp == S9X_NOT_EQUAL)
+		m ^= 0xffff;
 
-	for (i = 0x10000 - l; i < 0x10000; i++)
-		BIT_CLEAR(d->SRAM_BITS, i);
+	return (m);
 }
 
-void S9xSearchForValue (SCheatData *d, S9xCheatComparisonType cmp, S9xCheatDataSize size, uint32 value, bool8 is_signed, bool8 update)
+// SSE2 only compares signed bytes; unsigned ones are shifted into that
+// range, which keeps their order.
+template <S9xCheatComparisonType cmp, bool is_signed, bool change>
+static uint32 CheatMatch8 (const uint8 *cur, const uint8 *prev, int64 value, int count)
 {
-	int l, i;
+	if (count < 32)
+		return (CheatMatch<cmp, S9X_8_BITS, is_signed, change>(cur, prev, value, count));
+
+	const __m128i	bias = _mm_set1_epi8(is_signed ? 0 : -128);
+	__m128i			a0 = _mm_xor_si128(_mm_loadu_si128((const __m128i *) cur), bias);
+	__m128i			a1 = _mm_xor_si128(_mm_loadu_si128((const __m128i *) (cur + 16)), bias);
+	__m128i			b0, b1;
+
+	if (change)
+	{
+		b0 = _mm_xor_si128(_mm_loadu_si128((const __m128i *) prev), bias);
+		b1 = _mm_xor_si128(_mm_loadu_si128((const __m128i *) (prev + 16)), bias);
+	}
+	else
+		b0 = b1 = _mm_xor_si128(_mm_set1_epi8((char) value), bias);
+
+	return (CheatMatch16<cmp>(a0, b0) | (CheatMatch16<cmp>(a1, b1) << 16));
+}
+#endif
 
+template <S9xCheatComparisonType cmp, bool change>
+static CheatMatcher CheatSelect (S9xCheatDataSize size, bool8 is_signed, int64 value)
+{
 	switch (size)
 	{
-		case S9X_8_BITS:	l = 0; break;
-		case S9X_16_BITS:	l = 1; break;
-		case S9X_24_BITS:	l = 2; break;
+		case S9X_8_BITS:
+		#ifdef CHEAT_SSE2
+			// A value out of the range of a byte passes everything or
+			// nothing, which the plain comparison gets right.
+			if (change || (is_signed ? value == (int8) value : value == (uint8) value))
+				return (is_signed ? CheatMatch8<cmp, true, change> : CheatMatch8<cmp, false, change>);
+		#endif
+			return (is_signed ? CheatMatch<cmp, S9X_8_BITS, true, change> : CheatMatch<cmp, S9X_8_BITS, false, change>);
+		case S9X_16_BITS:
+			return (is_signed ? CheatMatch<cmp, S9X_16_BITS, true, change> : CheatMatch<cmp, S9X_16_BITS, false, change>);
+		case S9X_24_BITS:
+			return (is_signed ? CheatMatch<cmp, S9X_24_BITS, true, change> : CheatMatch<cmp, S9X_24_BITS, false, change>);
 		default:
-		case S9X_32_BITS:	l = 3; break;
+			return (is_signed ? CheatMatch<cmp, S9X_32_BITS, true, change> : CheatMatch<cmp, S9X_32_BITS, false, change>);
 	}
+}
 
-	if (is_signed)
+template <bool change>
+static CheatMatcher CheatSelect (S9xCheatComparisonType cmp, S9xCheatDataSize size, bool8 is_signed, int64 value)
+{
+	switch (cmp)
 	{
-		for (i = 0; i < 0x20000 - l; i++)
-		{
-			if (TEST_BIT(d->WRAM_BITS, i) && _S9XCHTC(cmp, _S9XCHTDS(size, d->RAM, i), (int32) value))
-			{
-				if (update)
-					d->CWRAM[i] = d->RAM[i];
-			}
-			else
-				BIT_CLEAR(d->WRAM_BITS, i);
-		}
-
-		for (i = 0; i < 0x10000 - l; i++)
-		{
-			if (TEST_BIT(d->SRAM_BITS, i) && _S9XCHTC(cmp, _S9XCHTDS(size, d->SRAM, i), (int32) value))
-			{
-				if (update)
-					d->CSRAM[i] = d->SRAM[i];
-			}
-			else
-				BIT_CLEAR(d->SRAM_BITS, i);
-		}
-
-		for (i = 0; i < 0x2000 - l; i++)
-		{
-			if (TEST_BIT(d->IRAM_BITS, i) && _S9XCHTC(cmp, _S9XCHTDS(size, d->FillRAM + 0x3000, i), (int32) value))
-			{
-				if (update)
-					d->CIRAM[i] = d->FillRAM[i + 0x3000];
-			}
-			else
-				BIT_CLEAR(d->IRAM_BITS, i);
-		}
+		case S9X_LESS_THAN:				return (CheatSelect<S9X_LESS_THAN, change>(size, is_signed, value));
+		case S9X_GREATER_THAN:			return (CheatSelect<S9X_GREATER_THAN, change>(size, is_signed, value));
+		case S9X_LESS_THAN_OR_EQUAL:	return (CheatSelect<S9X_LESS_THAN_OR_EQUAL, change>(size, is_signed, value));
+		case S9X_GREATER_THAN_OR_EQUAL:	return (CheatSelect<S9X_GREATER_THAN_OR_EQUAL, change>(size, is_signed, value));
+		case S9X_EQUAL:					return (CheatSelect<S9X_EQUAL, change>(size, is_signed, value));
+		default:						return (CheatSelect<S9X_NOT_EQUAL, change>(size, is_signed, value));
 	}
-	else
+}
+
+// Values that would run past the end of a region are never candidates.
+static void CheatSearchRegion (uint32 *bits, const uint8 *cur, uint8 *prev, int n, int l, CheatMatcher match, int64 value, bool8 update)
+{
+	for (int i = 0; i < n; i += 32)
 	{
-		for (i = 0; i < 0x20000 - l; i++)
-		{
-			if (TEST_BIT(d->WRAM_BITS, i) && _S9XCHTC(cmp, _S9XCHTD(size, d->RAM, i), value))
-			{
-				if (update)
-					d->CWRAM[i] = d->RAM[i];
-			}
-			else
-				BIT_CLEAR(d->WRAM_BITS, i);
-		}
+		uint32	&b = bits[i >> 5];
+		if (!b)
+			continue;
 
-		for (i = 0; i < 0x10000 - l; i++)
-		{
-			if (TEST_BIT(d->SRAM_BITS, i) && _S9XCHTC(cmp, _S9XCHTD(size, d->SRAM, i), value))
-			{
-				if (update)
-					d->CSRAM[i] = d->SRAM[i];
-			}
-			else
-				BIT_CLEAR(d->SRAM_BITS, i);
-		}
+		int	count = n - l - i < 32 ? n - l - i : 32;
+		b &= count > 0 ? match(cur + i, prev + i, value, count) : 0;
 
-		for (i = 0; i < 0x2000 - l; i++)
+		// Without branches, as about any mix of bits can pass.
+		if (update && b)
 		{
-			if (TEST_BIT(d->IRAM_BITS, i) && _S9XCHTC(cmp, _S9XCHTD(size, d->FillRAM + 0x3000, i), value))
-			{
-				if (update)
-					d->CIRAM[i] = d->FillRAM[i + 0x3000];
-			}
-			else
-				BIT_CLEAR(d->IRAM_BITS, i);
+			for (int k = 0; k < 32; k++)
+				prev[i + k] ^= (prev[i + k] ^ cur[i + k]) & (uint8) -(int) ((b >> k) & 1);
 		}
 	}
-
-	for (i = 0x20000 - l; i < 0x20000; i++)
-		BIT_CLEAR(d->WRAM_BITS, i);
-
-	for (i = 0x10000 - l; i < 0x10000; i++)
-		BIT_CLEAR(d->SRAM_BITS, i);
 }
 
-void S9xSearchForAddress (SCheatData *d, S9xCheatComparisonType cmp, S9xCheatDataSize size, uint32 value, bool8 update)
+static int CheatSizeExtra (S9xCheatDataSize size)
 {
-	int	l, i;
-
 	switch (size)
 	{
-		case S9X_8_BITS:	l = 0; break;
-		case S9X_16_BITS:	l = 1; break;
-		case S9X_24_BITS:	l = 2; break;
+		case S9X_8_BITS:	return (0);
+		case S9X_16_BITS:	return (1);
+		case S9X_24_BITS:	return (2);
 		default:
-		case S9X_32_BITS:	l = 3; break;
+		case S9X_32_BITS:	return (3);
 	}
+}
 
-	for (i = 0; i < 0x20000 - l; i++)
-	{
-		if (TEST_BIT(d->WRAM_BITS, i) && _S9XCHTC(cmp, i, (int32) value))
-		{
-			if (update)
-				d->CWRAM[i] = d->RAM[i];
-		}
-		else
-			BIT_CLEAR(d->WRAM_BITS, i);
-	}
+static void CheatSearch (SCheatData *d, CheatMatcher match, int l, int64 value, bool8 update)
+{
+	CheatSearchRegion(d->WRAM_BITS, d->RAM, d->CWRAM, 0x20000, l, match, value, update);
+	CheatSearchRegion(d->SRAM_BITS, d->SRAM, d->CSRAM, 0x10000, l, match, value, update);
+	CheatSearchRegion(d->IRAM_BITS, d->FillRAM + 0x3000, d->CIRAM, 0x2000, l, match, value, update);
+}
+
+void S9xStartCheatSearch (SCheatData *d)
+{
+	memmove(d->CWRAM, d->RAM, 0x20000);
+	memmove(d->CSRAM, d->SRAM, 0x80000);
+	memmove(d->CIRAM, &d->FillRAM[0x3000], 0x2000);
+	memset((char *) d->ALL_BITS, 0xff, 0x32000 >> 3);
+}
+
+void S9xSearchForChange (SCheatData *d, S9xCheatComparisonType cmp, S9xCheatDataSize size, bool8 is_signed, bool8 update)
+{
+	CheatSearch(d, CheatSelect<true>(cmp, size, is_signed, 0), CheatSizeExtra(size), 0, update);
+}
+
+void S9xSearchForValue (SCheatData *d, S9xCheatComparisonType cmp, S9xCheatDataSize size, uint32 value, bool8 is_signed, bool8 update)
+{
+	int64	v = is_signed ? (int64) (int32) value : (int64) value;
+
+	CheatSearch(d, CheatSelect<false>(cmp, size, is_signed, v), CheatSizeExtra(size), v, update);
+}
 
-	for (i = 0; i < 0x10000 - l; i++)
+void S9xSearchForAddress (SCheatData *d, S9xCheatComparisonType cmp, S9xCheatDataSize size, uint32 value, bool8 update)
+{
+	struct
 	{
-		if (TEST_BIT(d->SRAM_BITS, i) && _S9XCHTC(cmp, i + 0x20000, (int32) value))
-		{
-			if (update)
-				d->CSRAM[i] = d->SRAM[i];
-		}
-		else
-			BIT_CLEAR(d->SRAM_BITS, i);
-	}
+		uint32			*bits;
+		const uint8		*cur;
+		uint8			*prev;
+		int				n, base;
+	}	regions[] =
+	{
+		{ d->WRAM_BITS, d->RAM,              d->CWRAM, 0x20000, 0       },
+		{ d->SRAM_BITS, d->SRAM,             d->CSRAM, 0x10000, 0x20000 },
+		{ d->IRAM_BITS, d->FillRAM + 0x3000, d->CIRAM, 0x2000,  0x30000 }
+	};
+
+	int	l = CheatSizeExtra(size);
 
-	for (i = 0; i < 0x2000 - l; i++)
+	for (auto &r : regions)
 	{
-		if (TEST_BIT(d->IRAM_BITS, i) && _S9XCHTC(cmp, i + 0x30000, (int32) value))
+		for (int i = 0; i < r.n; i++)
 		{
-			if (update)
-				d->CIRAM[i] = d->FillRAM[i + 0x3000];
+			if (!TEST_BIT(r.bits, i))
+				continue;
+
+			if (i < r.n - l && _S9XCHTC(cmp, i + r.base, (int32) value))
+			{
+				if (update)
+					r.prev[i] = r.cur[i];
+			}
+			else
+				BIT_CLEAR(r.bits, i);
 		}
-		else
-			BIT_CLEAR(d->IRAM_BITS, i);
 	}
+}
 
-	for (i = 0x20000 - l; i < 0x20000; i++)
-		BIT_CLEAR(d->WRAM_BITS, i);
+// Narrows the search down at the end of every frame, for things like values
+// that never change or only ever go up, which a single comparison wouldn't
+// find. Cheap once the first few frames have weeded most addresses out.
+void S9xSearchEveryFrame (SCheatData *d, bool8 enable, S9xCheatComparisonType cmp, S9xCheatDataSize size, bool8 is_signed)
+{
+	d->search_every_frame = enable;
+	d->search_cmp = cmp;
+	d->search_size = size;
+	d->search_signed = is_signed;
+}
 
-	for (i = 0x10000 - l; i < 0x10000; i++)
-		BIT_CLEAR(d->SRAM_BITS, i);
+void S9xCheatSearchFrame (SCheatData *d)
+{
+	if (d->search_every_frame)
+		S9xSearchForChange(d, d->search_cmp, d->search_size, d->search_signed, TRUE);
 }
 
 void S9xOutputCheatSearchResults (SCheatData *d)
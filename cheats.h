@@ -10,6 +10,7 @@
 #include <cstdint>
 #include <string>
 #include <vector>
+#include "port.h"
 
 using bool8 = uint8_t;
 
@@ -31,6 +32,24 @@ struct SCheatGroup
 	std::vector<struct SCheat> cheat;
 };
 
+typedef enum
+{
+	S9X_LESS_THAN,
+	S9X_GREATER_THAN,
+	S9X_LESS_THAN_OR_EQUAL,
+	S9X_GREATER_THAN_OR_EQUAL,
+	S9X_EQUAL,
+	S9X_NOT_EQUAL
+}	S9xCheatComparisonType;
+
+typedef enum
+{
+	S9X_8_BITS,
+	S9X_16_BITS,
+	S9X_24_BITS,
+	S9X_32_BITS
+}	S9xCheatDataSize;
+
 struct SCheatData
 {
 	std::vector<struct SCheatGroup> group;
@@ -43,6 +62,10 @@ struct SCheatData
 	uint8_t	*SRAM;
 	uint32_t	ALL_BITS[0x32000 >> 5];
 	uint8_t	CWatchRAM[0x32000];
+	bool8	search_every_frame;
+	S9xCheatComparisonType	search_cmp;
+	S9xCheatDataSize	search_size;
+	bool8	search_signed;
 };
 
 struct Watch
@@ -55,26 +78,8 @@ struct Watch
 	char	desc[32];
 };
 
-typedef enum
-{
-	S9X_LESS_THAN,
-	S9X_GREATER_THAN,
-	S9X_LESS_THAN_OR_EQUAL,
-	S9X_GREATER_THAN_OR_EQUAL,
-	S9X_EQUAL,
-	S9X_NOT_EQUAL
-}	S9xCheatComparisonType;
-
-typedef enum
-{
-	S9X_8_BITS,
-	S9X_16_BITS,
-	S9X_24_BITS,
-	S9X_32_BITS
-}	S9xCheatDataSize;
-
-extern SCheatData	Cheat;
-extern Watch		watches[16];
+extern S9X_INSTANCE SCheatData	Cheat;
+extern S9X_INSTANCE Watch		watches[16];
 
 int S9xAddCheatGroup(const std::string &name, const std::string &cheat);
 int S9xModifyCheatGroup(uint32_t index, const std::string &name, const std::string &cheat);
@@ -98,6 +103,8 @@ void S9xStartCheatSearch (SCheatData *);
 void S9xSearchForChange (SCheatData *, S9xCheatComparisonType, S9xCheatDataSize, bool8, bool8);
 void S9xSearchForValue (SCheatData *, S9xCheatComparisonType, S9xCheatDataSize, uint32_t, bool8, bool8);
 void S9xSearchForAddress (SCheatData *, S9xCheatComparisonType, S9xCheatDataSize, uint32_t, bool8);
+void S9xSearchEveryFrame (SCheatData *, bool8, S9xCheatComparisonType, S9xCheatDataSize, bool8);
+void S9xCheatSearchFrame (SCheatData *);
 void S9xOutputCheatSearchResults (SCheatData *);
 
 #endif
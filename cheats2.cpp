@@ -9,6 +9,9 @@
 #include "snes9x.h"
 #include "memmap.h"
 #include <cassert>
+#include <sstream>
+#include <algorithm>
+#include <sys/stat.h>
 
 static inline uint8 S9xGetByteFree(uint32 Address)
 {
@@ -761,36 +764,245 @@ void S9xCheatsEnable(void)
     }
 }
 
-int S9xImportCheatsFromDatabase(const std::string &filename)
+// The cheat database is looked up through an index kept next to it, as
+// <database>.idx, so that only the block of the loaded cartridge has to be
+// parsed. The index starts with the size and modification time of the
+// database it was built from, followed by one entry per cartridge sorted by
+// SHA-256: the hash, and the offset and length of the cartridge's block.
+// Numbers are little-endian.
+
+#define CHEAT_INDEX_MAGIC  "S9xCDBI1"
+#define CHEAT_INDEX_HEADER 24
+#define CHEAT_INDEX_ENTRY  40
+
+struct cheat_index_entry
 {
-    char sha256_txt[65];
-    char hextable[] = "0123456789abcdef";
-    unsigned int i;
+    uint8 sha256[32];
+    uint32 offset;
+    uint32 length;
 
-    bml_node bml;
-    if (!bml.parse_file(filename))
-        return -1; // No file
+    bool operator<(const cheat_index_entry &e) const
+    {
+        return memcmp(sha256, e.sha256, 32) < 0;
+    }
+};
+
+static bool S9xParseSHA256Text(const char *text, uint8 *sha256)
+{
+    for (int i = 0; i < 64; i++)
+    {
+        char c = text[i];
+        int v;
+
+        if (c >= '0' && c <= '9')
+            v = c - '0';
+        else if (c >= 'a' && c <= 'f')
+            v = c - 'a' + 10;
+        else if (c >= 'A' && c <= 'F')
+            v = c - 'A' + 10;
+        else
+            return false;
+
+        if (i & 1)
+            sha256[i >> 1] |= v;
+        else
+            sha256[i >> 1] = v << 4;
+    }
+
+    return true;
+}
+
+// Finds the blocks of the database without parsing them: a block starts at
+// every line that isn't indented, and a cartridge's hash is given either on
+// that line or on one of the lines below it.
+static bool S9xBuildCheatIndex(const std::string &filename, std::vector<cheat_index_entry> &index)
+{
+    FILE *file = fopen(filename.c_str(), "rb");
+    if (!file)
+        return false;
+
+    char line[1024];
+    uint32 offset = 0;
+    cheat_index_entry entry;
+    bool in_cartridge = false, have_hash = false, line_start = true;
+
+    while (fgets(line, sizeof(line), file))
+    {
+        uint32 length = strlen(line);
+
+        if (line_start && line[0] != ' ' && line[0] != '\t' && line[0] != '\r' && line[0] != '\n')
+        {
+            if (in_cartridge && have_hash)
+            {
+                entry.length = offset - entry.offset;
+                index.push_back(entry);
+            }
+
+            in_cartridge = !strncasecmp(line, "cartridge", 9);
+            have_hash = false;
+            entry.offset = offset;
+        }
+
+        if (in_cartridge && !have_hash)
+        {
+            char *p = strstr(line, "sha256");
+            if (p && (p[6] == ':' || p[6] == '='))
+            {
+                p += 7;
+                while (*p == ' ' || *p == '"')
+                    p++;
+                have_hash = S9xParseSHA256Text(p, entry.sha256);
+            }
+        }
+
+        offset += length;
+        line_start = length && line[length - 1] == '\n';
+    }
+
+    if (in_cartridge && have_hash)
+    {
+        entry.length = offset - entry.offset;
+        index.push_back(entry);
+    }
+
+    fclose(file);
+
+    std::sort(index.begin(), index.end());
+
+    return true;
+}
+
+static void S9xWriteCheatIndex(const std::string &filename, const struct stat &st, const std::vector<cheat_index_entry> &index)
+{
+    FILE *file = fopen(filename.c_str(), "wb");
+    if (!file)
+        return; // the database may be installed read-only
 
-    for (i = 0; i < 32; i++)
+    uint8 header[CHEAT_INDEX_HEADER], record[CHEAT_INDEX_ENTRY];
+    uint64 size = st.st_size, mtime = st.st_mtime;
+
+    memcpy(header, CHEAT_INDEX_MAGIC, 8);
+    WRITE_DWORD(header + 8, (uint32) size);
+    WRITE_DWORD(header + 12, (uint32) (size >> 32));
+    WRITE_DWORD(header + 16, (uint32) mtime);
+    WRITE_DWORD(header + 20, (uint32) (mtime >> 32));
+    bool ok = fwrite(header, 1, sizeof(header), file) == sizeof(header);
+
+    for (auto &e : index)
     {
-        sha256_txt[i * 2]     = hextable[Memory.ROMSHA256[i] >> 4];
-        sha256_txt[i * 2 + 1] = hextable[Memory.ROMSHA256[i] & 0xf];
+        memcpy(record, e.sha256, 32);
+        WRITE_DWORD(record + 32, e.offset);
+        WRITE_DWORD(record + 36, e.length);
+        ok = ok && fwrite(record, 1, sizeof(record), file) == sizeof(record);
     }
-    sha256_txt[64] = '\0';
 
-    for (auto &c : bml.child)
+    fclose(file);
+
+    if (!ok)
+        remove(filename.c_str());
+}
+
+// Returns 1 and the block if the cartridge is in the index, 0 if it isn't,
+// and -1 if there is no index that matches the database.
+static int S9xLookupCheatIndex(const std::string &filename, const struct stat &st, const uint8 *sha256, cheat_index_entry &found)
+{
+    FILE *file = fopen(filename.c_str(), "rb");
+    if (!file)
+        return -1;
+
+    uint8 header[CHEAT_INDEX_HEADER], record[CHEAT_INDEX_ENTRY];
+    uint64 size = st.st_size, mtime = st.st_mtime;
+    int result = -1;
+
+    if (fread(header, 1, sizeof(header), file) == sizeof(header) &&
+        !memcmp(header, CHEAT_INDEX_MAGIC, 8) &&
+        READ_DWORD(header + 8) == (uint32) size && READ_DWORD(header + 12) == (uint32) (size >> 32) &&
+        READ_DWORD(header + 16) == (uint32) mtime && READ_DWORD(header + 20) == (uint32) (mtime >> 32) &&
+        !fseek(file, 0, SEEK_END))
     {
-        if (!strcasecmp(c.name.c_str(), "cartridge"))
+        long lo = 0, hi = (ftell(file) - CHEAT_INDEX_HEADER) / CHEAT_INDEX_ENTRY;
+
+        result = 0;
+
+        while (lo < hi)
         {
-            auto n = c.find_subnode("sha256");
+            long mid = (lo + hi) / 2;
+
+            if (fseek(file, CHEAT_INDEX_HEADER + mid * CHEAT_INDEX_ENTRY, SEEK_SET) ||
+                fread(record, 1, sizeof(record), file) != sizeof(record))
+            {
+                result = -1;
+                break;
+            }
 
-            if (n && !strcasecmp(n->data.c_str(), sha256_txt))
+            int cmp = memcmp(record, sha256, 32);
+            if (cmp == 0)
             {
-                S9xLoadCheatsFromBMLNode(c);
-                return 0;
+                memcpy(found.sha256, record, 32);
+                found.offset = READ_DWORD(record + 32);
+                found.length = READ_DWORD(record + 36);
+                result = 1;
+                break;
             }
+
+            if (cmp < 0)
+                lo = mid + 1;
+            else
+                hi = mid;
         }
     }
 
-    return -2; /* No codes */
+    fclose(file);
+
+    return result;
+}
+
+int S9xImportCheatsFromDatabase(const std::string &filename)
+{
+    struct stat st;
+    cheat_index_entry entry;
+
+    if (stat(filename.c_str(), &st))
+        return -1; // No file
+
+    std::string index_filename = filename + ".idx";
+    int found = S9xLookupCheatIndex(index_filename, st, Memory.ROMSHA256, entry);
+
+    if (found < 0)
+    {
+        std::vector<cheat_index_entry> index;
+        if (!S9xBuildCheatIndex(filename, index))
+            return -1;
+
+        S9xWriteCheatIndex(index_filename, st, index);
+
+        memcpy(entry.sha256, Memory.ROMSHA256, 32);
+        auto i = std::lower_bound(index.begin(), index.end(), entry);
+        found = (i != index.end() && !memcmp(i->sha256, entry.sha256, 32));
+        if (found)
+            entry = *i;
+    }
+
+    if (!found)
+        return -2; /* No codes */
+
+    std::string block(entry.length, '\0');
+    FILE *file = fopen(filename.c_str(), "rb");
+    if (!file)
+        return -1;
+
+    bool ok = !fseek(file, entry.offset, SEEK_SET) && fread(&block[0], 1, entry.length, file) == entry.length;
+    fclose(file);
+    if (!ok)
+        return -1;
+
+    std::istringstream stream(block);
+    bml_node bml;
+    bml.parse(stream);
+
+    if (bml.child.empty())
+        return -2;
+
+    S9xLoadCheatsFromBMLNode(bml.child[0]);
+    return 0;
 }
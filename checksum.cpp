@@ -0,0 +1,319 @@
+/*****************************************************************************\
+     Snes9x - Portable Super Nintendo Entertainment System (TM) emulator.
+                This file is licensed under the Snes9x License.
+   For further information, consult the LICENSE file in the root directory.
+\*****************************************************************************/
+
+// ROMs are hashed whole on every load, and the scanner hashes whole
+// libraries, so these use whatever the CPU offers. The CRC folds 64 bytes at
+// a time with carry-less multiplication on x86 (the method of Intel's "Fast
+// CRC Computation for Generic Polynomials Using PCLMULQDQ"), uses the CRC32
+// instructions on ARMv8 and otherwise reads 8 bytes at a time through eight
+// tables. SHA-256 uses the SHA extensions on x86. What is used on x86 is
+// decided once, at startup; the ARMv8 instructions are used when the
+// compiler is told the target has them.
+
+#include "port.h"
+#include "checksum.h"
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#if defined(_MSC_VER) || defined(__clang__) || (defined(__GNUC__) && __GNUC__ >= 5)
+#define CHECKSUM_X86
+#endif
+#endif
+
+#ifdef CHECKSUM_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define TARGET(features)
+#else
+#include <cpuid.h>
+#define TARGET(features)	__attribute__((target(features)))
+#endif
+#endif
+
+#if defined(__ARM_FEATURE_CRC32)
+#include <arm_acle.h>
+#endif
+
+static uint32	crc_table[8][256];
+
+static bool8 BuildCRCTables (void)
+{
+	for (uint32 i = 0; i < 256; i++)
+	{
+		uint32	c = i;
+		for (int k = 0; k < 8; k++)
+			c = (c >> 1) ^ (c & 1 ? 0xedb88320 : 0);
+		crc_table[0][i] = c;
+	}
+
+	for (uint32 i = 0; i < 256; i++)
+	{
+		for (int t = 1; t < 8; t++)
+			crc_table[t][i] = (crc_table[t - 1][i] >> 8) ^ crc_table[0][crc_table[t - 1][i] & 0xff];
+	}
+
+	return (TRUE);
+}
+
+static bool8	crc_tables_built = BuildCRCTables();
+
+static uint32 CRC32Tables (const uint8 *p, size_t size, uint32 crc)
+{
+	for (; size && ((uintptr_t) p & 7); size--)
+		crc = (crc >> 8) ^ crc_table[0][(crc ^ *p++) & 0xff];
+
+#ifdef LSB_FIRST
+	for (; size >= 8; size -= 8, p += 8)
+	{
+		uint32	lo, hi;
+		memcpy(&lo, p, 4);
+		memcpy(&hi, p + 4, 4);
+		lo ^= crc;
+
+		crc = crc_table[7][lo & 0xff] ^ crc_table[6][(lo >> 8) & 0xff] ^
+			  crc_table[5][(lo >> 16) & 0xff] ^ crc_table[4][lo >> 24] ^
+			  crc_table[3][hi & 0xff] ^ crc_table[2][(hi >> 8) & 0xff] ^
+			  crc_table[1][(hi >> 16) & 0xff] ^ crc_table[0][hi >> 24];
+	}
+#endif
+
+	for (; size; size--)
+		crc = (crc >> 8) ^ crc_table[0][(crc ^ *p++) & 0xff];
+
+	return (crc);
+}
+
+#if defined(__ARM_FEATURE_CRC32)
+static uint32 CRC32ARM (const uint8 *p, size_t size, uint32 crc)
+{
+	for (; size && ((uintptr_t) p & 7); size--)
+		crc = __crc32b(crc, *p++);
+
+	for (; size >= 8; size -= 8, p += 8)
+	{
+		uint64	v;
+		memcpy(&v, p, 8);
+		crc = __crc32d(crc, v);
+	}
+
+	for (; size; size--)
+		crc = __crc32b(crc, *p++);
+
+	return (crc);
+}
+#endif
+
+#ifdef CHECKSUM_X86
+// Constants for the zip polynomial, bit-reflected: x^(4*128+32), x^(4*128-32),
+// x^(128+32), x^(128-32) and x^64 mod P, then P and the Barrett constant.
+alignas(16) static const uint64	k1k2[2] = { 0x0154442bd4ULL, 0x01c6e41596ULL };
+alignas(16) static const uint64	k3k4[2] = { 0x01751997d0ULL, 0x00ccaa009eULL };
+alignas(16) static const uint64	k5k0[2] = { 0x0163cd6124ULL, 0x0000000000ULL };
+alignas(16) static const uint64	poly[2] = { 0x01db710641ULL, 0x01f7011641ULL };
+
+// size is at least 64 and a multiple of 16.
+TARGET("pclmul,sse2")
+static uint32 CRC32Fold (const uint8 *p, size_t size, uint32 crc)
+{
+	__m128i	x0, x1, x2, x3, x4, x5, x6, x7, x8;
+
+	x1 = _mm_loadu_si128((const __m128i *) (p + 0x00));
+	x2 = _mm_loadu_si128((const __m128i *) (p + 0x10));
+	x3 = _mm_loadu_si128((const __m128i *) (p + 0x20));
+	x4 = _mm_loadu_si128((const __m128i *) (p + 0x30));
+	x1 = _mm_xor_si128(x1, _mm_cvtsi32_si128(crc));
+	x0 = _mm_load_si128((const __m128i *) k1k2);
+	p += 64;
+	size -= 64;
+
+	// Four lanes of 128 bits each, folded forward 512 bits at a time.
+	for (; size >= 64; size -= 64, p += 64)
+	{
+		x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+		x6 = _mm_clmulepi64_si128(x2, x0, 0x00);
+		x7 = _mm_clmulepi64_si128(x3, x0, 0x00);
+		x8 = _mm_clmulepi64_si128(x4, x0, 0x00);
+		x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+		x2 = _mm_clmulepi64_si128(x2, x0, 0x11);
+		x3 = _mm_clmulepi64_si128(x3, x0, 0x11);
+		x4 = _mm_clmulepi64_si128(x4, x0, 0x11);
+		x1 = _mm_xor_si128(_mm_xor_si128(x1, x5), _mm_loadu_si128((const __m128i *) (p + 0x00)));
+		x2 = _mm_xor_si128(_mm_xor_si128(x2, x6), _mm_loadu_si128((const __m128i *) (p + 0x10)));
+		x3 = _mm_xor_si128(_mm_xor_si128(x3, x7), _mm_loadu_si128((const __m128i *) (p + 0x20)));
+		x4 = _mm_xor_si128(_mm_xor_si128(x4, x8), _mm_loadu_si128((const __m128i *) (p + 0x30)));
+	}
+
+	// Into one lane, which then takes what is left 128 bits at a time.
+	x0 = _mm_load_si128((const __m128i *) k3k4);
+
+	x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+	x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+	x1 = _mm_xor_si128(_mm_xor_si128(x1, x2), x5);
+	x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+	x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+	x1 = _mm_xor_si128(_mm_xor_si128(x1, x3), x5);
+	x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+	x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+	x1 = _mm_xor_si128(_mm_xor_si128(x1, x4), x5);
+
+	for (; size >= 16; size -= 16, p += 16)
+	{
+		x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+		x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+		x1 = _mm_xor_si128(_mm_xor_si128(x1, _mm_loadu_si128((const __m128i *) p)), x5);
+	}
+
+	// 128 bits down to 64, then Barrett reduction to 32.
+	x2 = _mm_clmulepi64_si128(x1, x0, 0x10);
+	x3 = _mm_setr_epi32(~0, 0, ~0, 0);
+	x1 = _mm_xor_si128(_mm_srli_si128(x1, 8), x2);
+
+	x0 = _mm_loadl_epi64((const __m128i *) k5k0);
+	x2 = _mm_srli_si128(x1, 4);
+	x1 = _mm_and_si128(x1, x3);
+	x1 = _mm_clmulepi64_si128(x1, x0, 0x00);
+	x1 = _mm_xor_si128(x1, x2);
+
+	x0 = _mm_load_si128((const __m128i *) poly);
+	x2 = _mm_and_si128(x1, x3);
+	x2 = _mm_clmulepi64_si128(x2, x0, 0x10);
+	x2 = _mm_and_si128(x2, x3);
+	x2 = _mm_clmulepi64_si128(x2, x0, 0x00);
+	x1 = _mm_xor_si128(x1, x2);
+
+	return ((uint32) _mm_cvtsi128_si32(_mm_srli_si128(x1, 4)));
+}
+
+static uint32 CRC32PCLMUL (const uint8 *p, size_t size, uint32 crc)
+{
+	if (size >= 64)
+	{
+		size_t	n = size & ~(size_t) 15;
+		crc = CRC32Fold(p, n, crc);
+		p += n;
+		size -= n;
+	}
+
+	return (CRC32Tables(p, size, crc));
+}
+
+alignas(16) static const uint32	sha256_k[64] =
+{
+	0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+	0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+	0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+	0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+	0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+	0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+	0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+	0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+TARGET("sha,sse4.1,ssse3")
+static void SHA256BlocksNI (uint32 *state, const uint8 *data, size_t blocks)
+{
+	const __m128i	bswap = _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+	__m128i			abef, cdgh, tmp, w[4];
+
+	// The instructions want the state as ABEF and CDGH.
+	tmp  = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *) &state[0]), 0xb1);
+	cdgh = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *) &state[4]), 0x1b);
+	abef = _mm_alignr_epi8(tmp, cdgh, 8);
+	cdgh = _mm_blend_epi16(cdgh, tmp, 0xf0);
+
+	for (; blocks; blocks--, data += 64)
+	{
+		__m128i	abef_in = abef, cdgh_in = cdgh;
+
+		// Four rounds a time, each taking the next four words of the schedule.
+		for (int i = 0; i < 16; i++)
+		{
+			__m128i	m;
+
+			if (i < 4)
+				m = w[i] = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *) (data + i * 16)), bswap);
+			else
+				m = w[i & 3] = _mm_sha256msg2_epu32(
+					_mm_add_epi32(_mm_sha256msg1_epu32(w[i & 3], w[(i + 1) & 3]), _mm_alignr_epi8(w[(i + 3) & 3], w[(i + 2) & 3], 4)),
+					w[(i + 3) & 3]);
+
+			m = _mm_add_epi32(m, _mm_load_si128((const __m128i *) &sha256_k[i * 4]));
+			cdgh = _mm_sha256rnds2_epu32(cdgh, abef, m);
+			abef = _mm_sha256rnds2_epu32(abef, cdgh, _mm_shuffle_epi32(m, 0x0e));
+		}
+
+		abef = _mm_add_epi32(abef, abef_in);
+		cdgh = _mm_add_epi32(cdgh, cdgh_in);
+	}
+
+	tmp  = _mm_shuffle_epi32(abef, 0x1b);
+	cdgh = _mm_shuffle_epi32(cdgh, 0xb1);
+	_mm_storeu_si128((__m128i *) &state[0], _mm_blend_epi16(tmp, cdgh, 0xf0));
+	_mm_storeu_si128((__m128i *) &state[4], _mm_alignr_epi8(cdgh, tmp, 8));
+}
+
+static void CPUID (uint32 leaf, uint32 regs[4])
+{
+#ifdef _MSC_VER
+	int	r[4];
+	__cpuidex(r, leaf, 0);
+	for (int i = 0; i < 4; i++)
+		regs[i] = r[i];
+#else
+	regs[0] = regs[1] = regs[2] = regs[3] = 0;
+	__cpuid_count(leaf, 0, regs[0], regs[1], regs[2], regs[3]);
+#endif
+}
+
+static bool8 HasX86Features (bool8 sha)
+{
+	uint32	regs[4];
+
+	CPUID(0, regs);
+	uint32	max_leaf = regs[0];
+
+	CPUID(1, regs);
+	bool8	pclmul = (regs[2] >> 1) & 1, ssse3 = (regs[2] >> 9) & 1, sse41 = (regs[2] >> 19) & 1;
+
+	if (!sha)
+		return (pclmul);
+
+	if (max_leaf < 7 || !ssse3 || !sse41)
+		return (FALSE);
+
+	CPUID(7, regs);
+	return ((regs[1] >> 29) & 1);
+}
+
+static bool8	has_pclmul = HasX86Features(FALSE);
+static bool8	has_sha = HasX86Features(TRUE);
+#endif
+
+uint32 caCRC32 (const uint8 *array, uint32 size, uint32 crc32)
+{
+#if defined(__ARM_FEATURE_CRC32)
+	crc32 = CRC32ARM(array, size, crc32);
+#elif defined(CHECKSUM_X86)
+	crc32 = has_pclmul ? CRC32PCLMUL(array, size, crc32) : CRC32Tables(array, size, crc32);
+#else
+	crc32 = CRC32Tables(array, size, crc32);
+#endif
+
+	return (~crc32);
+}
+
+bool S9xSHA256Blocks (uint32_t *state, const uint8_t *data, size_t blocks)
+{
+#ifdef CHECKSUM_X86
+	if (has_sha)
+	{
+		SHA256BlocksNI(state, data, blocks);
+		return (true);
+	}
+#endif
+
+	return (false);
+}
@@ -0,0 +1,24 @@
+/*****************************************************************************\
+     Snes9x - Portable Super Nintendo Entertainment System (TM) emulator.
+                This file is licensed under the Snes9x License.
+   For further information, consult the LICENSE file in the root directory.
+\*****************************************************************************/
+
+#ifndef _CHECKSUM_H_
+#define _CHECKSUM_H_
+
+// Plain standard types, as this is also used by sha256.cpp and the JMA code,
+// which don't include port.h.
+#include <stddef.h>
+#include <stdint.h>
+
+// The zip CRC-32 of size bytes. To continue an earlier one, pass it back in
+// inverted.
+uint32_t caCRC32 (const uint8_t *, uint32_t, uint32_t crc32 = 0xffffffff);
+
+// Runs the SHA-256 compression function over whole 64-byte blocks with the
+// instructions the CPU has for it, if any. Returns false, having done
+// nothing, when the portable code in sha256.cpp has to do it.
+bool S9xSHA256Blocks (uint32_t *, const uint8_t *, size_t);
+
+#endif
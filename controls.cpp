@@ -68,8 +68,8 @@ using namespace	std;
 #define FLAG_IOBIT1				(Memory.FillRAM[0x4213] & 0x80)
 #define FLAG_IOBIT(n)			((n) ? (FLAG_IOBIT1) : (FLAG_IOBIT0))
 
-bool8	pad_read = 0, pad_read_last = 0;
-uint8	read_idx[2 /* ports */][2 /* per port */];
+S9X_INSTANCE bool8	pad_read = 0, pad_read_last = 0;
+S9X_INSTANCE uint8	read_idx[2 /* ports */][2 /* per port */];
 
 struct exemulti
 {
@@ -85,7 +85,7 @@ struct crosshair
 	uint8				fg, bg;
 };
 
-static struct
+S9X_INSTANCE_STATIC struct
 {
 	int16				x, y;
 	int16				V_adj;
@@ -95,7 +95,7 @@ static struct
 	bool8				mapped;
 }	pseudopointer[8];
 
-static struct
+S9X_INSTANCE_STATIC struct
 {
 	uint16				buttons;
 	uint16				turbos;
@@ -104,7 +104,7 @@ static struct
 	uint8				turbo_ct;
 }	joypad[8];
 
-static struct
+S9X_INSTANCE_STATIC struct
 {
 	uint8				delta_x, delta_y;
 	int16				old_x, old_y;
@@ -114,7 +114,7 @@ static struct
 	struct crosshair	crosshair;
 }	mouse[2];
 
-static struct
+S9X_INSTANCE_STATIC struct
 {
 	int16				x, y;
 	uint8				phys_buttons;
@@ -124,7 +124,7 @@ static struct
 	struct crosshair	crosshair;
 }	superscope;
 
-static struct
+S9X_INSTANCE_STATIC struct
 {
 	int16				x[2], y[2];
 	uint8				buttons;
@@ -133,12 +133,12 @@ static struct
 	struct crosshair	crosshair[2];
 }	justifier;
 
-static struct
+S9X_INSTANCE_STATIC struct
 {
 	int8				pads[4];
 }	mp5[2];
 
-static struct
+S9X_INSTANCE_STATIC struct
 {
 	int16				x, y;
 	uint8				buttons;
@@ -146,16 +146,16 @@ static struct
 	struct crosshair	crosshair;
 }	macsrifle;
 
-static set<struct exemulti *>		exemultis;
-static set<uint32>					pollmap[NUMCTLS + 1];
-static map<uint32, s9xcommand_t>	keymap;
-static vector<s9xcommand_t *>		multis;
-static uint8						turbo_time;
-static uint8						pseudobuttons[256];
-static bool8						FLAG_LATCH = FALSE;
-static int32						curcontrollers[2] = { NONE,    NONE };
-static int32						newcontrollers[2] = { JOYPAD0, NONE };
-static char							buf[256];
+S9X_INSTANCE_STATIC set<struct exemulti *>		exemultis;
+S9X_INSTANCE_STATIC set<uint32>					pollmap[NUMCTLS + 1];
+S9X_INSTANCE_STATIC map<uint32, s9xcommand_t>	keymap;
+S9X_INSTANCE_STATIC vector<s9xcommand_t *>		multis;
+S9X_INSTANCE_STATIC uint8						turbo_time;
+S9X_INSTANCE_STATIC uint8						pseudobuttons[256];
+S9X_INSTANCE_STATIC bool8						FLAG_LATCH = FALSE;
+S9X_INSTANCE_STATIC int32						curcontrollers[2] = { NONE,    NONE };
+S9X_INSTANCE_STATIC int32						newcontrollers[2] = { JOYPAD0, NONE };
+S9X_INSTANCE_STATIC char							buf[256];
 
 static const char	*color_names[32] =
 {
@@ -785,7 +785,7 @@ void S9xGetController (int port, enum controllers *controller, int8 *id1, int8 *
 
 void S9xReportControllers (void)
 {
-	static char	mes[128];
+	S9X_INSTANCE_STATIC char	mes[128];
 	char		*c = mes;
 
 	S9xVerifyControllers();
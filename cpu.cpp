@@ -15,6 +15,7 @@
 #include "cheats.h"
 #ifdef DEBUGGER
 #include "debug.h"
+#include "history.h"
 #endif
 
 static void S9xResetCPU (void);
@@ -38,7 +39,7 @@ static void S9xSoftResetCPU (void)
 	CPU.Cycles = 182; // Or 188. This is the cycle count just after the jump to the Reset Vector.
 	CPU.PrevCycles = CPU.Cycles;
 	CPU.V_Counter = 0;
-	CPU.Flags = CPU.Flags & (DEBUG_MODE_FLAG | TRACE_FLAG);
+	CPU.Flags = CPU.Flags & (DEBUG_MODE_FLAG | TRACE_FLAG | BREAK_FLAG);
 	CPU.PCBase = NULL;
 	CPU.NMIPending = FALSE;
 	CPU.IRQLine = FALSE;
@@ -100,6 +101,7 @@ void S9xReset (void)
 
 	memset(Memory.RAM, 0x55, sizeof(Memory.RAM));
 	memset(Memory.VRAM, 0x00, sizeof(Memory.VRAM));
+	S9xStateHashInvalidate();
 	memset(Memory.FillRAM, 0, 0x8000);
 
 	S9xResetBSX();
@@ -129,6 +131,10 @@ void S9xReset (void)
 		S9xMSU1Init();
 
 	S9xInitCheatData();
+
+#ifdef DEBUGGER
+	S9xHistoryReset();
+#endif
 }
 
 void S9xSoftReset (void)
@@ -166,4 +172,8 @@ void S9xSoftReset (void)
 		S9xMSU1Init();
 
 	S9xInitCheatData();
+
+#ifdef DEBUGGER
+	S9xHistoryReset();
+#endif
 }
@@ -14,6 +14,8 @@
 #include "movie.h"
 #ifdef DEBUGGER
 #include "debug.h"
+#include "profile.h"
+#include "history.h"
 #include "missing.h"
 #endif
 
@@ -42,8 +44,18 @@ void S9xMainLoop (void)
 		S9xMovieUpdate();
 	}
 
+#ifdef DEBUGGER
+	if (S9xHistory.Recording && !S9xHistory.Replaying)
+		S9xHistoryRecord();
+#endif
+
 	for (;;)
 	{
+	#ifdef DEBUGGER
+		if (S9xHistory.Replaying)
+			S9xHistoryReplay();
+	#endif
+
 		if (CPU.NMIPending)
 		{
 			#ifdef DEBUGGER
@@ -101,21 +113,8 @@ void S9xMainLoop (void)
 		CHECK_FOR_IRQ_CHANGE();
 
 	#ifdef DEBUGGER
-		if ((CPU.Flags & BREAK_FLAG) && !(CPU.Flags & SINGLE_STEP_FLAG))
-		{
-			for (int Break = 0; Break != 6; Break++)
-			{
-				if (S9xBreakpoint[Break].Enabled &&
-					S9xBreakpoint[Break].Bank == Registers.PB &&
-					S9xBreakpoint[Break].Address == Registers.PCw)
-				{
-					if (S9xBreakpoint[Break].Enabled == 2)
-						S9xBreakpoint[Break].Enabled = TRUE;
-					else
-						CPU.Flags |= DEBUG_MODE_FLAG;
-				}
-			}
-		}
+		if ((CPU.Flags & BREAK_FLAG) && !(CPU.Flags & SINGLE_STEP_FLAG) && S9xBreakCheck(BREAK_EXECUTE, Registers.PBPC))
+			S9xBreakHit(BREAK_EXECUTE, Registers.PBPC, 0);
 
 		if (CPU.Flags & DEBUG_MODE_FLAG)
 			break;
@@ -168,6 +167,14 @@ void S9xMainLoop (void)
 				Opcodes = S9xOpcodesSlow;
 		}
 
+	#ifdef DEBUGGER
+		if (S9xProfile.Targets & (1 << PROFILE_CPU))
+			S9xProfileCPU(Op);
+
+		if (S9xHistory.Recording)
+			S9xHistory.Instructions++;
+	#endif
+
 		Registers.PCw++;
 		(*Opcodes[Op].S9xOpcode)();
 
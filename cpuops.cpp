@@ -13,6 +13,7 @@
 #include "snapshot.h"
 #include "display.h"
 #include "debug.h"
+#include "profile.h"
 #include "missing.h"
 #endif
 
@@ -2596,6 +2597,12 @@ void S9xOpcode_IRQ (void)
 	#else
 		S9xTraceMessage("*** IRQ");
 	#endif
+
+	#ifdef SA1_OPCODES
+	S9xProfileInterrupt(PROFILE_SA1);
+	#else
+	S9xProfileInterrupt(PROFILE_CPU);
+	#endif
 #endif
 
 	// IRQ and NMI do an opcode fetch as their first "IO" cycle.
@@ -2671,6 +2678,12 @@ void S9xOpcode_NMI (void)
 	#else
 		S9xTraceMessage("*** NMI");
 	#endif
+
+	#ifdef SA1_OPCODES
+	S9xProfileInterrupt(PROFILE_SA1);
+	#else
+	S9xProfileInterrupt(PROFILE_CPU);
+	#endif
 #endif
 
 	// IRQ and NMI do an opcode fetch as their first "IO" cycle.
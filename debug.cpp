@@ -6,6 +6,7 @@
 
 #ifdef DEBUGGER
 
+#include <ctype.h>
 #include <stdarg.h>
 #include "snes9x.h"
 #include "memmap.h"
@@ -15,14 +16,51 @@
 #include "display.h"
 #include "debug.h"
 #include "missing.h"
+#include "profile.h"
+#include "history.h"
+#include "movie.h"
 
 #include "apu/bapu/snes/snes.hpp"
 
-extern SDMA	DMA[8];
+extern S9X_INSTANCE SDMA	DMA[8];
 extern FILE	*apu_trace;
 FILE		*trace = NULL, *trace2 = NULL;
 
-struct SBreakPoint	S9xBreakpoint[6];
+// Binary traces are a 16-byte header, "S9XTRACE", a version, the record size
+// and 0 for the S-CPU or 1 for the SA-1, followed by a 32-byte record for each
+// instruction, all little-endian:
+//
+//	 0	PB:PC (24 bits)			 3	status (see below)
+//	 4	the instruction's four bytes
+//	 8	A, X, Y, D, S, P (16 bits each)
+//	20	DB				21	0
+//	22	V counter (16 bits)		24	H position in cycles (32 bits)
+//	28	frame count (32 bits)
+//
+// The status bits are, from bit 0, NMIPending, IRQLine, IRQExternal,
+// IRQTransition, the H and V timers being enabled, and bit 7 of $4200 and
+// $4210. Writing one takes a fraction of the time it takes to format a line
+// of trace.log; S9xDecodeTrace turns the records back into those lines.
+#define TRACE_VERSION		1
+#define TRACE_HEADER_SIZE	16
+#define TRACE_RECORD_SIZE	32
+
+static FILE	*trace_bin = NULL, *trace2_bin = NULL;
+
+// The instruction whose record is being decoded, which the debugger's memory
+// reads see in place of what the address holds now.
+static const uint8	*trace_opcode = NULL;
+static uint32		trace_pbpc;
+
+std::vector<struct SBreakPoint>	S9xBreakpoints;
+uint8							*S9xBreakMap[BREAK_TYPES][256];
+
+// The points that cover each bank, by type, which are all a hit has to test.
+static std::vector<uint32>	break_bank[BREAK_TYPES][256];
+
+// The breakpoint "g" goes from, which isn't stopped at again until its
+// instruction has run.
+static uint32	break_skip = 0xffffffff;
 
 struct SDebug
 {
@@ -52,6 +90,22 @@ static const char	*HelpMessage[] =
 	"s                      - Skip to next instruction    [skip]",
 	"T                      - Toggle CPU instruction tracing to trace.log",
 	"TS                     - Toggle SA-1 instruction tracing to trace_sa1.log",
+	"TB                     - Toggle binary instruction tracing to trace.bin",
+	"                         and trace_sa1.bin instead",
+	"profile [Targets] [Number] - Profile the cpu, sa1, smp and/or gsu, all by",
+	"                         default, every instruction or one sample per",
+	"                         [Number] cycles [example: profile cpu smp #1000]",
+	"profile stop           - Stop profiling and write profile.txt and",
+	"                         profile.folded",
+	"history [Number] [Number] - Record history to step back through, a",
+	"                         snapshot every [Number] frames, 60 by default,",
+	"                         keeping [Number], 60 by default [example:",
+	"                         history #30 #120]",
+	"history off            - Stop recording history",
+	"rs [Number]            - Step back one or [Number] instructions",
+	"rc                     - Continue back to the last breakpoint or",
+	"                         watchpoint hit",
+	"rw [Address]           - Go back to the last write to [Address]",
 	"E                      - Toggle HC-based event tracing to trace.log",
 	"V                      - Toggle non-DMA V-RAM read/write tracing to stdout",
 	"D                      - Toggle on-screen DMA tracing",
@@ -62,10 +116,15 @@ static const char	*HelpMessage[] =
 	"g [Address]            - Go or go to [Address]",
 	"u [Address]            - Disassemble from PC or [Address]",
 	"d [Address]            - Dump from PC or [Address]",
-	"bv [Number]            - View breakpoints or view breakpoint [Number]",
-	"bs [Number] [Address]  - Enable/disable breakpoint",
-	"                         [enable example: bs #2 $02:8002]",
-	"                         [disable example: bs #2]",
+	"bv [Number]            - View breakpoints and watchpoints or view [Number]",
+	"bs [Address] [Condition] - Set a breakpoint",
+	"br [Address] [Condition] - Set a watchpoint on reads",
+	"bw [Address] [Condition] - Set a watchpoint on writes",
+	"                         [example: bs $02:8002 X==$10]",
+	"                         [example: bw $7E:0100-$7E:01FF V>=$80]",
+	"bs [Number] [Address]  - Replace point [Number], or delete it",
+	"                         [delete example: bs #2]",
+	"bc                     - Clear all breakpoints and watchpoints",
 	"c                      - Dump SNES colour palette",
 	"W                      - Show what SNES hardware features the ROM is using",
 	"                         which might not be implemented yet",
@@ -84,6 +143,8 @@ static const char	*HelpMessage[] =
 	"                         [for example: $01:8123]",
 	"[Number]               - #Number",
 	"                         [for example: #1]",
+	"[Condition]            - A, X, Y, S, D, DB, P or V, the byte written,",
+	"                         then ==, !=, <, >, <= or >=, then $Hex or #Number",
 	"z                      - ",
 	"f                      - ",
 	"dump                   - ",
@@ -157,6 +218,10 @@ static uint8 debug_sa1_op_print (char *, uint8, uint16);
 static void debug_line_print (const char *);
 static int debug_get_number (char *, uint16 *);
 static short debug_get_start_address (char *, uint8 *, uint32 *);
+static bool8 debug_get_breakpoint (char *, struct SBreakPoint *);
+static void debug_breakpoint_print (char *, uint32);
+static void debug_add_temporary (uint8, uint16);
+static void debug_clear_temporary (void);
 static void debug_print_window (uint8 *);
 static const char * debug_clip_fn (int);
 static void debug_whats_used (void);
@@ -169,6 +234,9 @@ static uint8 S9xDebugGetByte (uint32 Address)
 	uint8	*GetAddress = Memory.Map[block];
 	uint8	byte = 0;
 
+	if (trace_opcode && ((Address - trace_pbpc) & 0xffffff) < 4)
+		return (trace_opcode[(Address - trace_pbpc) & 3]);
+
 	if (GetAddress >= (uint8 *) CMemory::MAP_LAST)
 	{
 		byte = *(GetAddress + (Address & 0xffff));
@@ -216,6 +284,9 @@ static uint8 S9xDebugSA1GetByte (uint32 Address)
 	uint8	*GetAddress = SA1.Map[block];
 	uint8	byte = 0;
 
+	if (trace_opcode && ((Address - trace_pbpc) & 0xffffff) < 4)
+		return (trace_opcode[(Address - trace_pbpc) & 3]);
+
 	if (GetAddress >= (uint8 *) CMemory::MAP_LAST)
 	{
 		byte = *(GetAddress + (Address & 0xffff));
@@ -1190,6 +1261,287 @@ static short debug_get_start_address (char *Line, uint8 *Bank, uint32 *Address)
 	return (1);
 }
 
+// Reads "$Bank:Address[-$Bank:Address] [Condition]" into bp.
+static bool8 debug_get_breakpoint (char *Line, struct SBreakPoint *bp)
+{
+	static const char	*registers[] = { "A", "X", "Y", "S", "D", "DB", "P", "V" };
+	static const char	*compares[] = { "==", "!=", "<", ">", "<=", ">=" };
+	uint32				b, a;
+	int					n = 0;
+
+	if (sscanf(Line, " $%x:%x%n", &b, &a, &n) != 2)
+		return (FALSE);
+
+	Line += n;
+	bp->From = bp->To = ((b & 0xff) << 16) | (a & 0xffff);
+	bp->Register = BREAK_IF_ALWAYS;
+	bp->Compare = BREAK_EQUAL;
+	bp->Value = 0;
+	bp->Temporary = FALSE;
+
+	n = 0;
+	if (sscanf(Line, " -$%x:%x%n", &b, &a, &n) == 2)
+	{
+		Line += n;
+		bp->To = ((b & 0xff) << 16) | (a & 0xffff);
+		if (bp->To < bp->From)
+			return (FALSE);
+	}
+
+	while (isspace(*Line))
+		Line++;
+
+	if (!*Line)
+		return (TRUE);
+
+	int	len;
+
+	for (len = 0; isalpha(Line[len]); len++) ;
+
+	for (int i = 0; i < 8; i++)
+	{
+		if ((int) strlen(registers[i]) == len && strncasecmp(Line, registers[i], len) == 0)
+			bp->Register = BREAK_IF_A + i;
+	}
+
+	// The byte isn't known before it's read.
+	if (bp->Register == BREAK_IF_ALWAYS || (bp->Register == BREAK_IF_VALUE && bp->Type != BREAK_WRITE))
+		return (FALSE);
+
+	for (Line += len; isspace(*Line); Line++) ;
+
+	// Longest first, so <= isn't taken for <.
+	int	i;
+
+	for (i = 5; i >= 0 && strncmp(Line, compares[i], strlen(compares[i])) != 0; i--) ;
+
+	if (i < 0)
+		return (FALSE);
+
+	bp->Compare = BREAK_EQUAL + i;
+
+	char	*end;
+
+	for (Line += strlen(compares[i]); isspace(*Line); Line++) ;
+
+	if (*Line == '$')
+		bp->Value = strtoul(Line + 1, &end, 16);
+	else
+	if (*Line == '#')
+		bp->Value = strtoul(Line + 1, &end, 10);
+	else
+		return (FALSE);
+
+	if (end == Line + 1)
+		return (FALSE);
+
+	for (Line = end; isspace(*Line); Line++) ;
+
+	return (*Line == 0);
+}
+
+static void debug_breakpoint_print (char *Line, uint32 Number)
+{
+	static const char			*types[BREAK_TYPES] = { "break", "read ", "write" };
+	static const char			*registers[] = { "", "A", "X", "Y", "S", "D", "DB", "P", "V" };
+	static const char			*compares[] = { "==", "!=", "<", ">", "<=", ">=" };
+	const struct SBreakPoint	&bp = S9xBreakpoints[Number];
+
+	Line += sprintf(Line, "%u %s @ $%02X:%04X", Number, types[bp.Type], bp.From >> 16, bp.From & 0xffff);
+
+	if (bp.To != bp.From)
+		Line += sprintf(Line, "-$%02X:%04X", bp.To >> 16, bp.To & 0xffff);
+
+	if (bp.Register != BREAK_IF_ALWAYS)
+		Line += sprintf(Line, " if %s%s$%X", registers[bp.Register], compares[bp.Compare], bp.Value);
+
+	if (bp.Temporary)
+		sprintf(Line, " (temporary)");
+}
+
+// Where "g" or "p" is to stop, until any point is hit.
+static void debug_add_temporary (uint8 Bank, uint16 Address)
+{
+	struct SBreakPoint	bp;
+
+	bp.Type = BREAK_EXECUTE;
+	bp.From = bp.To = (Bank << 16) | Address;
+	bp.Register = BREAK_IF_ALWAYS;
+	bp.Compare = BREAK_EQUAL;
+	bp.Value = 0;
+	bp.Temporary = TRUE;
+
+	S9xBreakpoints.push_back(bp);
+	S9xUpdateBreakpoints();
+}
+
+static void debug_clear_temporary (void)
+{
+	size_t	n = S9xBreakpoints.size();
+
+	for (size_t i = n; i-- > 0; )
+	{
+		if (S9xBreakpoints[i].Temporary)
+			S9xBreakpoints.erase(S9xBreakpoints.begin() + i);
+	}
+
+	if (S9xBreakpoints.size() != n)
+		S9xUpdateBreakpoints();
+}
+
+static bool8 debug_break_condition (const struct SBreakPoint &bp, uint32 value)
+{
+	uint32	r;
+
+	switch (bp.Register)
+	{
+		case BREAK_IF_A:
+			r = CheckMemory() ? Registers.AL : Registers.A.W;
+			break;
+
+		case BREAK_IF_X:
+			r = Registers.X.W;
+			break;
+
+		case BREAK_IF_Y:
+			r = Registers.Y.W;
+			break;
+
+		case BREAK_IF_S:
+			r = Registers.S.W;
+			break;
+
+		case BREAK_IF_D:
+			r = Registers.D.W;
+			break;
+
+		case BREAK_IF_DB:
+			r = Registers.DB;
+			break;
+
+		case BREAK_IF_P:
+			S9xPackStatus();
+			r = Registers.PL;
+			break;
+
+		case BREAK_IF_VALUE:
+			r = value;
+			break;
+
+		default:
+			return (TRUE);
+	}
+
+	switch (bp.Compare)
+	{
+		case BREAK_NOT_EQUAL:
+			return (r != bp.Value);
+
+		case BREAK_LESS:
+			return (r < bp.Value);
+
+		case BREAK_GREATER:
+			return (r > bp.Value);
+
+		case BREAK_LESS_EQUAL:
+			return (r <= bp.Value);
+
+		case BREAK_GREATER_EQUAL:
+			return (r >= bp.Value);
+
+		default:
+			return (r == bp.Value);
+	}
+}
+
+void S9xUpdateBreakpoints (void)
+{
+	bool8	execute = FALSE;
+
+	for (int t = 0; t < BREAK_TYPES; t++)
+	{
+		for (int b = 0; b < 256; b++)
+		{
+			delete [] S9xBreakMap[t][b];
+			S9xBreakMap[t][b] = NULL;
+			break_bank[t][b].clear();
+		}
+	}
+
+	for (uint32 i = 0; i < S9xBreakpoints.size(); i++)
+	{
+		const struct SBreakPoint	&bp = S9xBreakpoints[i];
+
+		for (uint32 bank = bp.From >> 16; bank <= (bp.To >> 16); bank++)
+		{
+			uint8	*&page = S9xBreakMap[bp.Type][bank];
+			uint32	from = bank == (bp.From >> 16) ? bp.From & 0xffff : 0;
+			uint32	to = bank == (bp.To >> 16) ? bp.To & 0xffff : 0xffff;
+
+			if (!page)
+				page = new uint8[0x10000 >> 3]();
+
+			for (uint32 a = from; a <= to; a++)
+				page[a >> 3] |= 1 << (a & 7);
+
+			break_bank[bp.Type][bank].push_back(i);
+		}
+
+		if (bp.Type == BREAK_EXECUTE)
+			execute = TRUE;
+	}
+
+	if (execute)
+		CPU.Flags |= BREAK_FLAG;
+	else
+		CPU.Flags &= ~BREAK_FLAG;
+}
+
+// Called when S9xBreakCheck finds a point may cover Address, with the byte
+// written for a watchpoint on writes. Tests the conditions of the points
+// there and stops when one is met.
+void S9xBreakHit (int type, uint32 Address, uint32 value)
+{
+	Address &= 0xffffff;
+
+	if (type == BREAK_EXECUTE && Address == break_skip && !S9xHistory.Replaying)
+	{
+		break_skip = 0xffffffff;
+		return;
+	}
+
+	const std::vector<uint32>	&points = break_bank[type][Address >> 16];
+
+	for (size_t i = 0; i < points.size(); i++)
+	{
+		const struct SBreakPoint	&bp = S9xBreakpoints[points[i]];
+
+		if (Address < bp.From || Address > bp.To || !debug_break_condition(bp, value))
+			continue;
+
+		// Going over history again stops only where it was told to.
+		if (S9xHistory.Replaying)
+		{
+			if (S9xHistory.Searching && !bp.Temporary)
+				S9xHistoryHit();
+			return;
+		}
+
+		if (type == BREAK_WRITE)
+			printf("Watchpoint %u: $%02X written to $%02X:%04X\n", points[i], value, Address >> 16, Address & 0xffff);
+		else
+		if (type == BREAK_READ)
+			printf("Watchpoint %u: $%02X:%04X read\n", points[i], Address >> 16, Address & 0xffff);
+		else
+		if (!bp.Temporary)
+			printf("Breakpoint %u: $%02X:%04X\n", points[i], Address >> 16, Address & 0xffff);
+
+		CPU.Flags |= DEBUG_MODE_FLAG;
+		debug_clear_temporary();
+		return;
+	}
+}
+
 void S9xDebugProcessCommand(char *Line)
 {
 	uint8	Bank = Registers.PB;
@@ -1224,6 +1576,171 @@ void S9xDebugProcessCommand(char *Line)
 		return;
 	}
 
+	// Matched here, before 'p' is taken to mean proceed.
+	if (strncasecmp(Line, "profile", 7) == 0)
+	{
+		static const char	*targets[PROFILE_TARGETS] = { "cpu", "sa1", "smp", "gsu" };
+		uint8				Targets = 0;
+		uint32				Interval = 0;
+
+		strncpy(string, &Line[7], sizeof(string) - 1);
+		string[sizeof(string) - 1] = 0;
+
+		for (char *token = strtok(string, " \t\r\n"); token; token = strtok(NULL, " \t\r\n"))
+		{
+			int	i;
+
+			for (i = 0; i < PROFILE_TARGETS; i++)
+			{
+				if (strcasecmp(token, targets[i]) == 0)
+					break;
+			}
+
+			if (i < PROFILE_TARGETS)
+				Targets |= 1 << i;
+			else
+			if (strcasecmp(token, "all") == 0)
+				Targets = (1 << PROFILE_TARGETS) - 1;
+			else
+			if (*token == '#')
+				Interval = strtoul(token + 1, NULL, 10);
+			else
+			if (strcasecmp(token, "stop") == 0)
+			{
+				S9xProfileStop();
+				if (S9xProfileWrite())
+					printf("Profile written to profile.txt and profile.folded\n");
+				else
+					printf("Can't write the profile\n");
+				return;
+			}
+			else
+			{
+				printf("Usage: profile [cpu] [sa1] [smp] [gsu] [#interval] or profile stop\n");
+				return;
+			}
+		}
+
+		if (!Targets)
+			Targets = (1 << PROFILE_TARGETS) - 1;
+
+		S9xProfileStart(Targets, Interval);
+
+		if (Interval)
+			printf("Profiling, one sample every %u cycles\n", Interval);
+		else
+			printf("Profiling every instruction\n");
+
+		return;
+	}
+
+	if (strncasecmp(Line, "history", 7) == 0)
+	{
+		uint32	Interval = 0, Count = 0;
+		char	*end;
+
+		for (end = &Line[7]; isspace(*end); end++) ;
+
+		if (strncasecmp(end, "off", 3) == 0)
+		{
+			S9xHistoryStop();
+			printf("History off\n");
+			return;
+		}
+
+		if (Settings.NetPlay || S9xMovieActive())
+		{
+			printf("History can't be recorded during netplay or a movie\n");
+			return;
+		}
+
+		if (*end && sscanf(end, "#%u #%u", &Interval, &Count) < 1)
+		{
+			printf("Usage: history [#Interval] [#Count] or history off\n");
+			return;
+		}
+
+		S9xHistoryStart(Interval, Count);
+		printf("Recording history\n");
+
+		return;
+	}
+
+	// Matched here, before 'r' is taken to show the registers.
+	if (*Line == 'r' && (Line[1] == 's' || Line[1] == 'c' || Line[1] == 'w'))
+	{
+		uint64	Now = S9xHistory.Instructions;
+		uint32	Count = 1;
+		bool8	found;
+
+		if (!S9xHistory.Recording || S9xMovieActive())
+		{
+			printf("No history is being recorded, see \"history\"\n");
+			return;
+		}
+
+		debug_clear_temporary();
+
+		if (Line[1] == 's')
+		{
+			if (Line[2] && sscanf(&Line[2], " #%u", &Count) != 1)
+			{
+				printf("Usage: rs [#Number]\n");
+				return;
+			}
+
+			uint64	Back = Now - S9xHistoryOldest();
+
+			if (Back < Count)
+				printf("History only goes back %llu instructions\n", (unsigned long long) Back);
+			else
+				Back = Count;
+
+			found = S9xHistorySeek(Now - Back);
+		}
+		else
+		if (Line[1] == 'c')
+			found = S9xHistorySearch();
+		else
+		{
+			std::vector<SBreakPoint>	points;
+			struct SBreakPoint			bp;
+
+			if (debug_get_start_address(&Line[1], &Bank, &Address) != 1)
+			{
+				printf("Usage: rw $Bank:Address\n");
+				return;
+			}
+
+			bp.Type = BREAK_WRITE;
+			bp.From = bp.To = (Bank << 16) | (Address & 0xffff);
+			bp.Register = BREAK_IF_ALWAYS;
+			bp.Compare = BREAK_EQUAL;
+			bp.Value = 0;
+			bp.Temporary = FALSE;
+
+			// Only writes to Address are looked for.
+			points.swap(S9xBreakpoints);
+			S9xBreakpoints.push_back(bp);
+			S9xUpdateBreakpoints();
+
+			found = S9xHistorySearch();
+
+			points.swap(S9xBreakpoints);
+			S9xUpdateBreakpoints();
+		}
+
+		if (!found)
+			printf("%s\n", Line[1] == 's' ? "Couldn't go back in history" : "Not found in history");
+		else
+			printf("%llu instructions back\n", (unsigned long long) (Now - S9xHistory.Instructions));
+
+		debug_cpu_op_print(string, Registers.PB, Registers.PCw);
+		debug_line_print(string);
+
+		return;
+	}
+
 	if (*Line == 'i')
 	{
 		printf("Vectors:\n");
@@ -1363,6 +1880,12 @@ void S9xDebugProcessCommand(char *Line)
 
 	if (*Line == 'T')
 	{
+		if (Line[1] == 'B')
+		{
+			Settings.TraceBinary = !Settings.TraceBinary;
+			printf("Instruction tracing to %s.\n", Settings.TraceBinary ? "trace.bin and trace_sa1.bin" : "trace.log and trace_sa1.log");
+		}
+		else
 		if (Line[1] == 'S')
 		{
 			SA1.Flags ^= TRACE_FLAG;
@@ -1370,13 +1893,18 @@ void S9xDebugProcessCommand(char *Line)
 			if (SA1.Flags & TRACE_FLAG)
 			{
 				printf("SA1 CPU instruction tracing enabled.\n");
-				ENSURE_TRACE_OPEN(trace2, "trace_sa1.log", "wb")
+				if (!Settings.TraceBinary)
+					ENSURE_TRACE_OPEN(trace2, "trace_sa1.log", "wb")
 			}
 			else
 			{
 				printf("SA1 CPU instruction tracing disabled.\n");
-				fclose(trace2);
+				if (trace2)
+					fclose(trace2);
 				trace2 = NULL;
+				if (trace2_bin)
+					fclose(trace2_bin);
+				trace2_bin = NULL;
 			}
 		}
 		else
@@ -1386,13 +1914,18 @@ void S9xDebugProcessCommand(char *Line)
 			if (CPU.Flags & TRACE_FLAG)
 			{
 				printf("CPU instruction tracing enabled.\n");
-				ENSURE_TRACE_OPEN(trace, "trace.log", "wb")
+				if (!Settings.TraceBinary)
+					ENSURE_TRACE_OPEN(trace, "trace.log", "wb")
 			}
 			else
 			{
 				printf("CPU instruction tracing disabled.\n");
-				fclose(trace);
+				if (trace)
+					fclose(trace);
 				trace = NULL;
+				if (trace_bin)
+					fclose(trace_bin);
+				trace_bin = NULL;
 			}
 		}
 	}
@@ -1488,7 +2021,7 @@ void S9xDebugProcessCommand(char *Line)
 
 	if (*Line == 'p')
 	{
-		S9xBreakpoint[5].Enabled = FALSE;
+		debug_clear_temporary();
 		Address += debug_cpu_op_print(string, Bank, Address);
 
 		if (strncmp(&string[18], "JMP", 3) != 0 &&
@@ -1496,9 +2029,11 @@ void S9xDebugProcessCommand(char *Line)
 		    strncmp(&string[18], "RT" , 2) != 0 &&
 		    strncmp(&string[18], "BRA", 3))
 		{
-			S9xBreakpoint[5].Enabled = TRUE;
-			S9xBreakpoint[5].Bank = Bank;
-			S9xBreakpoint[5].Address = Address;
+			if (S9xBreakCheck(BREAK_EXECUTE, Registers.PBPC))
+				break_skip = Registers.PBPC & 0xffffff;
+
+			debug_add_temporary(Bank, Address);
+			CPU.Flags &= ~DEBUG_MODE_FLAG;
 		}
 		else
 		{
@@ -1509,56 +2044,66 @@ void S9xDebugProcessCommand(char *Line)
 
 	if (*Line == 'b')
 	{
-		if (Line[1] == 's')
+		if (Line[1] == 's' || Line[1] == 'r' || Line[1] == 'w')
 		{
-			debug_get_number(Line + 2, &Hold);
+			struct SBreakPoint	bp;
+			char				*p = Line + 2;
+			int					n = 0;
+			bool8				numbered = sscanf(p, " #%hu%n", &Hold, &n) == 1;
 
-			if (Hold > 4)
-				Hold = 0;
+			p += n;
 
-			if (Hold < 5)
+			bp.Type = Line[1] == 's' ? BREAK_EXECUTE : (Line[1] == 'r' ? BREAK_READ : BREAK_WRITE);
+
+			if (debug_get_breakpoint(p, &bp))
 			{
-				if (debug_get_start_address(Line + 5, &Bank, &Address) == -1)
-					S9xBreakpoint[Hold].Enabled = FALSE;
+				if (numbered && Hold < S9xBreakpoints.size())
+					S9xBreakpoints[Hold] = bp;
 				else
-				{
-					S9xBreakpoint[Hold].Enabled = TRUE;
-					S9xBreakpoint[Hold].Bank = Bank;
-					S9xBreakpoint[Hold].Address = Address;
-					CPU.Flags |= BREAK_FLAG;
-				}
+					S9xBreakpoints.push_back(bp);
+			}
+			else
+			if (numbered && Hold < S9xBreakpoints.size() && strspn(p, " ") == strlen(p))
+				S9xBreakpoints.erase(S9xBreakpoints.begin() + Hold);
+			else
+			{
+				printf("Usage: b%c [#Number] $Bank:Address[-$Bank:Address] [Condition]\n", Line[1]);
+				return;
 			}
 
+			S9xUpdateBreakpoints();
+
 			Line[1] = 'v';
+			Line[2] = 0;
 		}
 
-		if (Line[1] == 'v')
+		if (Line[1] == 'c')
 		{
-			Number = 0;
+			S9xBreakpoints.clear();
+			S9xUpdateBreakpoints();
+			Line[1] = 'v';
+			Line[2] = 0;
+		}
 
-			if (debug_get_number(Line + 2, &Number) == -1 && Number < 5)
+		if (Line[1] == 'v')
+		{
+			if (debug_get_number(Line + 2, &Number) == -1 || Number >= S9xBreakpoints.size())
 			{
 				debug_line_print("Breakpoints:");
 
-				for (Number = 0; Number != 5; Number++)
+				for (Number = 0; Number < S9xBreakpoints.size(); Number++)
 				{
-					if (S9xBreakpoint[Number].Enabled)
-						sprintf(string, "%i @ $%02X:%04X", Number, S9xBreakpoint[Number].Bank, S9xBreakpoint[Number].Address);
-					else
-						sprintf(string, "%i @ Disabled", Number);
-
+					debug_breakpoint_print(string, Number);
 					debug_line_print(string);
 				}
+
+				if (S9xBreakpoints.empty())
+					debug_line_print("None");
 			}
 			else
 			{
 				debug_line_print("Breakpoint:");
-
-				if (S9xBreakpoint[Number].Enabled)
-					sprintf(string, "%i @ $%02X:%04X", Number, S9xBreakpoint[Number].Bank, S9xBreakpoint[Number].Address);
-				else
-					sprintf(string, "%i @ Disabled", Number);
-
+				debug_breakpoint_print(string, Number);
 				debug_line_print(string);
 			}
 		}
@@ -1590,36 +2135,15 @@ void S9xDebugProcessCommand(char *Line)
 
 	if (*Line == 'g')
 	{
-		S9xBreakpoint[5].Enabled = FALSE;
-
-		bool8	found = FALSE;
-
-		for (int i = 0; i < 5; i++)
-		{
-			if (S9xBreakpoint[i].Enabled)
-			{
-				found = TRUE;
-
-				if (S9xBreakpoint[i].Bank == Registers.PB && S9xBreakpoint[i].Address == Registers.PCw)
-				{
-					S9xBreakpoint[i].Enabled = 2;
-					break;
-				}
-			}
-		}
+		debug_clear_temporary();
 
-		if (!found)
-			CPU.Flags &= ~BREAK_FLAG;
+		if (S9xBreakCheck(BREAK_EXECUTE, Registers.PBPC))
+			break_skip = Registers.PBPC & 0xffffff;
 
 		ErrorCode = debug_get_start_address(Line, &Bank, &Address);
 
 		if (ErrorCode == 1)
-		{
-			S9xBreakpoint[5].Enabled = TRUE;
-			S9xBreakpoint[5].Bank = Bank;
-			S9xBreakpoint[5].Address = Address;
-			CPU.Flags |= BREAK_FLAG;
-		}
+			debug_add_temporary(Bank, Address);
 
 		CPU.Flags &= ~DEBUG_MODE_FLAG;
 	}
@@ -2373,6 +2897,7 @@ void S9xDoDebug (void)
 	Debug.Unassemble.Address = 0;
 
 	S9xTextMode();
+	S9xFlushTrace();
 
 	strcpy(Line, "r");
 	S9xDebugProcessCommand(Line);
@@ -2397,10 +2922,108 @@ void S9xDoDebug (void)
 		S9xGraphicsMode();
 }
 
+static FILE * debug_open_binary_trace (const char *name, uint8 cpu)
+{
+	std::string	fn = S9xGetDirectory(LOG_DIR);
+	fn += SLASH_STR;
+	fn += name;
+
+	FILE	*fp = fopen(fn.c_str(), "wb");
+	if (!fp)
+		return (NULL);
+
+	// Whole levels' worth of records go out in big writes.
+	setvbuf(fp, NULL, _IOFBF, 1 << 20);
+
+	uint8	header[TRACE_HEADER_SIZE];
+
+	memset(header, 0, sizeof(header));
+	memcpy(header, "S9XTRACE", 8);
+	WRITE_WORD(header + 8, TRACE_VERSION);
+	WRITE_WORD(header + 10, TRACE_RECORD_SIZE);
+	header[12] = cpu;
+	fwrite(header, 1, sizeof(header), fp);
+
+	return (fp);
+}
+
+template <class R>
+static void debug_write_trace_record (FILE *fp, const R &r, uint8 (*get_byte) (uint32))
+{
+	uint8	record[TRACE_RECORD_SIZE];
+	uint32	pbpc = r.PBPC & 0xffffff;
+
+	WRITE_3WORD(record, pbpc);
+	record[3] = (CPU.NMIPending ? 0x01 : 0) |
+	            (CPU.IRQLine ? 0x02 : 0) |
+	            (CPU.IRQExternal ? 0x04 : 0) |
+	            (CPU.IRQTransition ? 0x08 : 0) |
+	            (PPU.HTimerEnabled ? 0x10 : 0) |
+	            (PPU.VTimerEnabled ? 0x20 : 0) |
+	            ((Memory.FillRAM[0x4200] & 0x80) ? 0x40 : 0) |
+	            ((Memory.FillRAM[0x4210] & 0x80) ? 0x80 : 0);
+
+	for (int i = 0; i < 4; i++)
+		record[4 + i] = get_byte(pbpc + i);
+
+	WRITE_WORD(record +  8, r.A.W);
+	WRITE_WORD(record + 10, r.X.W);
+	WRITE_WORD(record + 12, r.Y.W);
+	WRITE_WORD(record + 14, r.D.W);
+	WRITE_WORD(record + 16, r.S.W);
+	WRITE_WORD(record + 18, r.P.W);
+	record[20] = r.DB;
+	record[21] = 0;
+	WRITE_WORD(record + 22, (uint16) CPU.V_Counter);
+	WRITE_DWORD(record + 24, (uint32) CPU.Cycles);
+	WRITE_DWORD(record + 28, IPPU.FrameCount);
+
+	fwrite(record, 1, sizeof(record), fp);
+}
+
+template <class R>
+static void debug_read_trace_record (const uint8 *record, R &r)
+{
+	r.PBPC = READ_3WORD(record);
+	r.A.W = READ_WORD(record +  8);
+	r.X.W = READ_WORD(record + 10);
+	r.Y.W = READ_WORD(record + 12);
+	r.D.W = READ_WORD(record + 14);
+	r.S.W = READ_WORD(record + 16);
+	r.P.W = READ_WORD(record + 18);
+	r.DB = record[20];
+
+	CPU.NMIPending = (record[3] & 0x01) != 0;
+	CPU.IRQLine = (record[3] & 0x02) != 0;
+	CPU.IRQExternal = (record[3] & 0x04) != 0;
+	CPU.IRQTransition = (record[3] & 0x08) != 0;
+	PPU.HTimerEnabled = (record[3] & 0x10) != 0;
+	PPU.VTimerEnabled = (record[3] & 0x20) != 0;
+	Memory.FillRAM[0x4200] = (record[3] & 0x40) ? 0x80 : 0;
+	Memory.FillRAM[0x4210] = (record[3] & 0x80) ? 0x80 : 0;
+	CPU.V_Counter = READ_WORD(record + 22);
+	CPU.Cycles = (int32) READ_DWORD(record + 24);
+	IPPU.FrameCount = READ_DWORD(record + 28);
+}
+
 void S9xTrace (void)
 {
 	char	msg[512];
 
+	if (Settings.TraceBinary)
+	{
+		if (!trace_bin)
+			trace_bin = debug_open_binary_trace("trace.bin", 0);
+		if (trace_bin)
+		{
+			// The flags are kept apart while the CPU runs.
+			S9xPackStatus();
+			debug_write_trace_record(trace_bin, Registers, S9xDebugGetByte);
+		}
+
+		return;
+	}
+
 	ENSURE_TRACE_OPEN(trace, "trace.log", "a")
 
 	debug_cpu_op_print(msg, Registers.PB, Registers.PCw);
@@ -2411,12 +3034,116 @@ void S9xSA1Trace (void)
 {
 	char	msg[512];
 
+	if (Settings.TraceBinary)
+	{
+		if (!trace2_bin)
+			trace2_bin = debug_open_binary_trace("trace_sa1.bin", 1);
+		if (trace2_bin)
+		{
+			S9xSA1PackStatus();
+			debug_write_trace_record(trace2_bin, SA1Registers, S9xDebugSA1GetByte);
+		}
+
+		return;
+	}
+
 	ENSURE_TRACE_OPEN(trace2, "trace_sa1.log", "a")
 
 	debug_sa1_op_print(msg, SA1Registers.PB, SA1Registers.PCw);
 	fprintf(trace2, "%s\n", msg);
 }
 
+void S9xFlushTrace (void)
+{
+	if (trace_bin)
+		fflush(trace_bin);
+	if (trace2_bin)
+		fflush(trace2_bin);
+}
+
+// Prints a binary trace as the lines trace.log or trace_sa1.log would have
+// had, using the same disassembler. What wasn't recorded, the address an
+// indirect operand points to and the IRQ timer positions, is shown as it is
+// now, which is zero without a game. Returns FALSE if filename isn't a trace.
+bool8 S9xDecodeTrace (const char *filename, FILE *out, const struct STraceFilter *filter)
+{
+	FILE	*fp = fopen(filename, "rb");
+	if (!fp)
+		return (FALSE);
+
+	uint8	header[TRACE_HEADER_SIZE];
+
+	if (fread(header, 1, sizeof(header), fp) != sizeof(header) || memcmp(header, "S9XTRACE", 8) ||
+		READ_WORD(header + 8) != TRACE_VERSION || READ_WORD(header + 10) != TRACE_RECORD_SIZE)
+	{
+		fclose(fp);
+		return (FALSE);
+	}
+
+	bool8	sa1 = header[12] != 0;
+
+	// The disassembler prints the machine's state, which each record stands
+	// in for while it's decoded.
+	struct SRegisters		saved_registers = Registers;
+	struct SSA1Registers	saved_sa1_registers = SA1Registers;
+	struct SCPUState		saved_cpu = CPU;
+	struct SICPU			saved_icpu = ICPU;
+	uint8					saved_sa1_flags[4] = { SA1._Carry, SA1._Zero, SA1._Negative, SA1._Overflow };
+	uint32					saved_frame = IPPU.FrameCount;
+	bool8					saved_htimer = PPU.HTimerEnabled, saved_vtimer = PPU.VTimerEnabled;
+	uint8					saved_4200 = Memory.FillRAM[0x4200], saved_4210 = Memory.FillRAM[0x4210];
+
+	uint8	record[TRACE_RECORD_SIZE];
+	char	line[512];
+
+	while (fread(record, 1, sizeof(record), fp) == sizeof(record))
+	{
+		uint32	pbpc  = READ_3WORD(record);
+		uint32	frame = READ_DWORD(record + 28);
+
+		if (pbpc < filter->From || pbpc > filter->To || frame < filter->FirstFrame || frame > filter->LastFrame)
+			continue;
+
+		trace_opcode = record + 4;
+		trace_pbpc = pbpc;
+
+		if (sa1)
+		{
+			debug_read_trace_record(record, SA1Registers);
+			S9xSA1UnpackStatus();
+			debug_sa1_op_print(line, SA1Registers.PB, SA1Registers.PCw);
+		}
+		else
+		{
+			debug_read_trace_record(record, Registers);
+			S9xUnpackStatus();
+			debug_cpu_op_print(line, Registers.PB, Registers.PCw);
+		}
+
+		fprintf(out, "%s\n", line);
+	}
+
+	trace_opcode = NULL;
+
+	Registers = saved_registers;
+	SA1Registers = saved_sa1_registers;
+	CPU = saved_cpu;
+	ICPU = saved_icpu;
+	SA1._Carry = saved_sa1_flags[0];
+	SA1._Zero = saved_sa1_flags[1];
+	SA1._Negative = saved_sa1_flags[2];
+	SA1._Overflow = saved_sa1_flags[3];
+	IPPU.FrameCount = saved_frame;
+	PPU.HTimerEnabled = saved_htimer;
+	PPU.VTimerEnabled = saved_vtimer;
+	Memory.FillRAM[0x4200] = saved_4200;
+	Memory.FillRAM[0x4210] = saved_4210;
+
+	fclose(fp);
+
+	return (TRUE);
+}
+
 void S9xTraceMessage (const char *s)
 {
 	if (s)
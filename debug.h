@@ -10,12 +10,51 @@
 #define _DEBUG_H_
 
 #include <string>
+#include <vector>
 
+enum
+{
+	BREAK_EXECUTE,
+	BREAK_READ,
+	BREAK_WRITE,
+	BREAK_TYPES
+};
+
+enum
+{
+	BREAK_IF_ALWAYS,
+	BREAK_IF_A,
+	BREAK_IF_X,
+	BREAK_IF_Y,
+	BREAK_IF_S,
+	BREAK_IF_D,
+	BREAK_IF_DB,
+	BREAK_IF_P,
+	BREAK_IF_VALUE		// the byte written
+};
+
+enum
+{
+	BREAK_EQUAL,
+	BREAK_NOT_EQUAL,
+	BREAK_LESS,
+	BREAK_GREATER,
+	BREAK_LESS_EQUAL,
+	BREAK_GREATER_EQUAL
+};
+
+// An S-CPU breakpoint or watchpoint on the 24-bit addresses From to To, as
+// the S-CPU sees them, so a mirror of a location is an address of its own.
+// The condition is only tested when one of them is hit.
 struct SBreakPoint
 {
-	bool8	Enabled;
-	uint8	Bank;
-	uint16	Address;
+	uint8	Type;
+	uint32	From;
+	uint32	To;
+	uint8	Register;
+	uint8	Compare;
+	uint32	Value;
+	bool8	Temporary;
 };
 
 #define ENSURE_TRACE_OPEN(fp, file, mode) \
@@ -26,11 +65,39 @@ struct SBreakPoint
 		fp = fopen(fn.c_str(), mode); \
 	}
 
-extern struct SBreakPoint	S9xBreakpoint[6];
+// Which records of a binary trace S9xDecodeTrace prints: those of
+// instructions at From to To, a 24-bit address range, and in frames
+// FirstFrame to LastFrame.
+struct STraceFilter
+{
+	uint32	From;
+	uint32	To;
+	uint32	FirstFrame;
+	uint32	LastFrame;
+};
+
+extern std::vector<struct SBreakPoint>	S9xBreakpoints;
+
+// A bit for each address for each type of point, in 64KB pages that are made
+// when the first point is set in them, so checking an access is one lookup.
+// S9xUpdateBreakpoints rebuilds them after S9xBreakpoints is changed.
+extern uint8	*S9xBreakMap[BREAK_TYPES][256];
+
+static inline bool8 S9xBreakCheck (int type, uint32 Address)
+{
+	const uint8	*page = S9xBreakMap[type][(Address >> 16) & 0xff];
+
+	return (page && (page[(Address & 0xffff) >> 3] & (1 << (Address & 7))));
+}
+
+void S9xUpdateBreakpoints (void);
+void S9xBreakHit (int, uint32, uint32);
 
 void S9xDoDebug (void);
 void S9xTrace (void);
 void S9xSA1Trace (void);
+void S9xFlushTrace (void);
+bool8 S9xDecodeTrace (const char *, FILE *, const struct STraceFilter *);
 void S9xTraceMessage (const char *);
 void S9xTraceFormattedMessage (const char *, ...);
 void S9xPrintHVPosition (char *);
@@ -8,19 +8,20 @@
 #include "memmap.h"
 #include "dma.h"
 #include "apu/apu.h"
-#include "sdd1emu.h"
+#include "sdd1.h"
 #include "spc7110emu.h"
+#include "tile.h"
 #ifdef DEBUGGER
 #include "missing.h"
 #endif
 
 #define ADD_CYCLES(n)	{ CPU.Cycles += (n); }
 
-extern uint8	*HDMAMemPointers[8];
+extern S9X_INSTANCE uint8	*HDMAMemPointers[8];
 extern int		HDMA_ModeByteCounts[8];
-extern SPC7110	s7emu;
+extern S9X_INSTANCE SPC7110	s7emu;
 
-static uint8	sdd1_decode_buffer[0x10000];
+S9X_INSTANCE_STATIC uint8	sdd1_decode_buffer[0x10000];
 
 static inline bool8 addCyclesInDMA (uint8);
 static inline bool8 HDMAReadLineCount (int);
@@ -137,11 +138,13 @@ bool8 S9xDoDMA (uint8 Channel)
 			// Hacky support for pre-decompressed S-DD1 data
 			inc = !d->AAddressDecrement ? 1 : -1;
 
+			in_sdd1_dma = sdd1_decode_buffer;
+
 			uint8	*in_ptr = S9xGetBasePointer(((d->ABank << 16) | d->AAddress));
 			if (in_ptr)
 			{
 				in_ptr += d->AAddress;
-				SDD1_decompress(sdd1_decode_buffer, in_ptr, d->TransferBytes);
+				in_sdd1_dma = S9xSDD1Decompress(in_ptr, d->TransferBytes);
 			}
 		#ifdef DEBUGGER
 			else
@@ -150,8 +153,6 @@ bool8 S9xDoDMA (uint8 Channel)
 				S9xMessage(S9X_WARNING, S9X_DMA_TRACE, String);
 			}
 		#endif
-
-			in_sdd1_dma = sdd1_decode_buffer;
 		}
 
 		Memory.FillRAM[0x4801] = 0;
@@ -219,98 +220,17 @@ bool8 S9xDoDMA (uint8 Channel)
 				depth, count, bytes_per_char, bytes_per_line, num_chars, char_line_bytes);
 		#endif
 
-			switch (depth)
+			for (int32 i = 0; i < count; i += inc_sa1, base += char_line_bytes, inc_sa1 = char_line_bytes, char_count = num_chars)
 			{
-				case 2:
-					for (int32 i = 0; i < count; i += inc_sa1, base += char_line_bytes, inc_sa1 = char_line_bytes, char_count = num_chars)
-					{
-						uint8	*line = base + (num_chars - char_count) * 2;
-						for (uint32 j = 0; j < char_count && p - buffer < count; j++, line += 2)
-						{
-							uint8	*q = line;
-							for (int32 l = 0; l < 8; l++, q += bytes_per_line)
-							{
-								for (int32 b = 0; b < 2; b++)
-								{
-									uint8	r = *(q + b);
-									*(p + 0) = (*(p + 0) << 1) | ((r >> 0) & 1);
-									*(p + 1) = (*(p + 1) << 1) | ((r >> 1) & 1);
-									*(p + 0) = (*(p + 0) << 1) | ((r >> 2) & 1);
-									*(p + 1) = (*(p + 1) << 1) | ((r >> 3) & 1);
-									*(p + 0) = (*(p + 0) << 1) | ((r >> 4) & 1);
-									*(p + 1) = (*(p + 1) << 1) | ((r >> 5) & 1);
-									*(p + 0) = (*(p + 0) << 1) | ((r >> 6) & 1);
-									*(p + 1) = (*(p + 1) << 1) | ((r >> 7) & 1);
-								}
-
-								p += 2;
-							}
-						}
-					}
-
-					break;
-
-				case 4:
-					for (int32 i = 0; i < count; i += inc_sa1, base += char_line_bytes, inc_sa1 = char_line_bytes, char_count = num_chars)
-					{
-						uint8	*line = base + (num_chars - char_count) * 4;
-						for (uint32 j = 0; j < char_count && p - buffer < count; j++, line += 4)
-						{
-							uint8	*q = line;
-							for (int32 l = 0; l < 8; l++, q += bytes_per_line)
-							{
-								for (int32 b = 0; b < 4; b++)
-								{
-									uint8	r = *(q + b);
-									*(p +  0) = (*(p +  0) << 1) | ((r >> 0) & 1);
-									*(p +  1) = (*(p +  1) << 1) | ((r >> 1) & 1);
-									*(p + 16) = (*(p + 16) << 1) | ((r >> 2) & 1);
-									*(p + 17) = (*(p + 17) << 1) | ((r >> 3) & 1);
-									*(p +  0) = (*(p +  0) << 1) | ((r >> 4) & 1);
-									*(p +  1) = (*(p +  1) << 1) | ((r >> 5) & 1);
-									*(p + 16) = (*(p + 16) << 1) | ((r >> 6) & 1);
-									*(p + 17) = (*(p + 17) << 1) | ((r >> 7) & 1);
-								}
-
-								p += 2;
-							}
-
-							p += 32 - 16;
-						}
-					}
-
-					break;
-
-				case 8:
-					for (int32 i = 0; i < count; i += inc_sa1, base += char_line_bytes, inc_sa1 = char_line_bytes, char_count = num_chars)
-					{
-						uint8	*line = base + (num_chars - char_count) * 8;
-						for (uint32 j = 0; j < char_count && p - buffer < count; j++, line += 8)
-						{
-							uint8	*q = line;
-							for (int32 l = 0; l < 8; l++, q += bytes_per_line)
-							{
-								for (int32 b = 0; b < 8; b++)
-								{
-									uint8	r = *(q + b);
-									*(p +  0) = (*(p +  0) << 1) | ((r >> 0) & 1);
-									*(p +  1) = (*(p +  1) << 1) | ((r >> 1) & 1);
-									*(p + 16) = (*(p + 16) << 1) | ((r >> 2) & 1);
-									*(p + 17) = (*(p + 17) << 1) | ((r >> 3) & 1);
-									*(p + 32) = (*(p + 32) << 1) | ((r >> 4) & 1);
-									*(p + 33) = (*(p + 33) << 1) | ((r >> 5) & 1);
-									*(p + 48) = (*(p + 48) << 1) | ((r >> 6) & 1);
-									*(p + 49) = (*(p + 49) << 1) | ((r >> 7) & 1);
-								}
-
-								p += 2;
-							}
-
-							p += 64 - 16;
-						}
-					}
+				uint8	*line = base + (num_chars - char_count) * depth;
+				for (uint32 j = 0; j < char_count && p - buffer < count; j++, line += depth)
+				{
+					uint8	*q = line;
+					for (int32 l = 0; l < 8; l++, q += bytes_per_line, p += 2)
+						S9xStorePlanarRow(p, S9xPlanarRow(S9xChunkyRow(q, depth)), depth);
 
-					break;
+					p += bytes_per_char - 16;
+				}
 			}
 		}
 	}
@@ -10,8 +10,8 @@
 #include "missing.h"
 #endif
 
-uint8	(*GetDSP) (uint16)        = NULL;
-void	(*SetDSP) (uint8, uint16) = NULL;
+S9X_INSTANCE uint8	(*GetDSP) (uint16)        = NULL;
+S9X_INSTANCE void	(*SetDSP) (uint8, uint16) = NULL;
 
 
 void S9xResetDSP (void)
@@ -7,6 +7,7 @@
 #include "snes9x.h"
 #include "fxinst.h"
 #include "fxemu.h"
+#include "profile.h"
 
 // Set this define if you wish the plot instruction to check for y-pos limits (I don't think it's nessecary)
 #define CHECK_LIMITS
@@ -3967,7 +3968,13 @@ uint32 fx_run (uint32 nInstructions)
 {
 	GSU.vCounter = nInstructions;
 	while (TF(G) && (GSU.vCounter-- > 0))
+	{
+	#ifdef DEBUGGER
+		if (S9xProfile.Targets & (1 << PROFILE_GSU))
+			S9xProfileGSU((USEX8(GSU.vPrgBankReg) << 16) | USEX16(R15 - 1), PIPE);
+	#endif
 		FX_STEP;
+	}
 #if 0
 #ifndef FX_ADDRESS_CHECK
 	GSU.vPipeAdr = USEX16(R15 - 1) | (USEX8(GSU.vPrgBankReg) << 16);
@@ -16,6 +16,7 @@
 #include "seta.h"
 #include "bsx.h"
 #include "msu1.h"
+#include "debug.h"
 
 #define addCyclesInMemoryAccess \
 	if (!CPU.InDMAorHDMA) \
@@ -33,7 +34,7 @@
 			S9xDoHEventProcessing(); \
 	}
 
-extern uint8	OpenBus;
+extern S9X_INSTANCE uint8	OpenBus;
 
 static inline int32 memory_speed (uint32 address)
 {
@@ -61,6 +62,11 @@ inline uint8 S9xGetByte (uint32 Address)
 	int32	speed = memory_speed(Address);
 	uint8	byte;
 
+#ifdef DEBUGGER
+	if (S9xBreakCheck(BREAK_READ, Address))
+		S9xBreakHit(BREAK_READ, Address, 0);
+#endif
+
 	if (GetAddress >= (uint8 *) CMemory::MAP_LAST)
 	{
 		byte = *(GetAddress + (Address & 0xffff));
@@ -186,6 +192,13 @@ inline uint16 S9xGetWord (uint32 Address, enum s9xwrap_t w = WRAP_NONE)
 		}
 	}
 
+#ifdef DEBUGGER
+	if (S9xBreakCheck(BREAK_READ, Address))
+		S9xBreakHit(BREAK_READ, Address, 0);
+	if (S9xBreakCheck(BREAK_READ, Address + 1))
+		S9xBreakHit(BREAK_READ, Address + 1, 0);
+#endif
+
 	int		block = (Address & 0xffffff) >> MEMMAP_SHIFT;
 	uint8	*GetAddress = Memory.Map[block];
 	int32	speed = memory_speed(Address);
@@ -323,6 +336,11 @@ inline void S9xSetByte (uint8 Byte, uint32 Address)
 	uint8	*SetAddress = Memory.WriteMap[block];
 	int32	speed = memory_speed(Address);
 
+#ifdef DEBUGGER
+	if (S9xBreakCheck(BREAK_WRITE, Address))
+		S9xBreakHit(BREAK_WRITE, Address, Byte);
+#endif
+
 	if (SetAddress >= (uint8 *) CMemory::MAP_LAST)
 	{
 		*(SetAddress + (Address & 0xffff)) = Byte;
@@ -459,6 +477,13 @@ inline void S9xSetWord (uint16 Word, uint32 Address, enum s9xwrap_t w = WRAP_NON
 		return;
 	}
 
+#ifdef DEBUGGER
+	if (S9xBreakCheck(BREAK_WRITE, Address))
+		S9xBreakHit(BREAK_WRITE, Address, (uint8) Word);
+	if (S9xBreakCheck(BREAK_WRITE, Address + 1))
+		S9xBreakHit(BREAK_WRITE, Address + 1, Word >> 8);
+#endif
+
 	int		block = (Address & 0xffffff) >> MEMMAP_SHIFT;
 	uint8	*SetAddress = Memory.WriteMap[block];
 	int32	speed = memory_speed(Address);
@@ -14,9 +14,9 @@
 #include "screenshot.h"
 #include "display.h"
 
-extern struct SCheatData		Cheat;
-extern struct SLineData			LineData[240];
-extern struct SLineMatrixData	LineMatrixData[240];
+extern S9X_INSTANCE struct SCheatData		Cheat;
+extern S9X_INSTANCE struct SLineData			LineData[240];
+extern S9X_INSTANCE struct SLineMatrixData	LineMatrixData[240];
 
 void S9xComputeClipWindows (void);
 
@@ -42,32 +42,12 @@ static void S9xDisplayStringType (const char *, int, int, bool, int);
 #define TILE_PLUS(t, x)	(((t) & 0xfc00) | ((t + x) & 0x3ff))
 
 
-bool8 S9xGraphicsInit (void)
-{
-	S9xInitTileRenderer();
-	memset(BlackColourMap, 0, 256 * sizeof(uint16));
-
-	IPPU.OBJChanged = TRUE;
-	Settings.BG_Forced = 0;
-	Settings.ForcedBackdrop = 0;
-	S9xFixColourBrightness();
-	S9xBuildDirectColourMaps();
-
-	GFX.ScreenBuffer.resize(MAX_SNES_WIDTH * (MAX_SNES_HEIGHT + 64));
-	GFX.Screen = &GFX.ScreenBuffer[GFX.RealPPL * 32];
-	GFX.ZERO = (uint16 *) malloc(sizeof(uint16) * 0x10000);
-	GFX.SubScreen  = (uint16 *) malloc(GFX.ScreenSize * sizeof(uint16));
-	GFX.ZBuffer    = (uint8 *)  malloc(GFX.ScreenSize);
-	GFX.SubZBuffer = (uint8 *)  malloc(GFX.ScreenSize);
-
-	if (!GFX.ZERO || !GFX.SubScreen || !GFX.ZBuffer || !GFX.SubZBuffer)
-	{
-		S9xGraphicsDeinit();
-		return (FALSE);
-	}
+// Lookup table for 1/2 color subtraction. It only depends on the pixel
+// format, so all instances share it.
+static uint16	ZeroTable[0x10000];
 
-	// Lookup table for 1/2 color subtraction
-	memset(GFX.ZERO, 0, 0x10000 * sizeof(uint16));
+static bool8 BuildZeroTable (void)
+{
 	for (uint32 r = 0; r <= MAX_RED; r++)
 	{
 		uint32	r2 = r;
@@ -92,8 +72,8 @@ bool8 S9xGraphicsInit (void)
 				else
 					b2 = 0;
 
-				GFX.ZERO[BUILD_PIXEL2(r, g, b)] = BUILD_PIXEL2(r2, g2, b2);
-				GFX.ZERO[BUILD_PIXEL2(r, g, b) & ~ALPHA_BITS_MASK] = BUILD_PIXEL2(r2, g2, b2);
+				ZeroTable[BUILD_PIXEL2(r, g, b)] = BUILD_PIXEL2(r2, g2, b2);
+				ZeroTable[BUILD_PIXEL2(r, g, b) & ~ALPHA_BITS_MASK] = BUILD_PIXEL2(r2, g2, b2);
 			}
 		}
 	}
@@ -101,9 +81,39 @@ bool8 S9xGraphicsInit (void)
 	return (TRUE);
 }
 
+bool8 S9xGraphicsInit (void)
+{
+	static bool8	zero_table_built = BuildZeroTable();
+	(void) zero_table_built;
+
+	S9xInitTileRenderer();
+	memset(BlackColourMap, 0, 256 * sizeof(uint16));
+
+	IPPU.OBJChanged = TRUE;
+	Settings.BG_Forced = 0;
+	Settings.ForcedBackdrop = 0;
+	S9xFixColourBrightness();
+	S9xBuildDirectColourMaps();
+
+	GFX.ScreenBuffer.resize(MAX_SNES_WIDTH * (MAX_SNES_HEIGHT + 64));
+	GFX.Screen = &GFX.ScreenBuffer[GFX.RealPPL * 32];
+	GFX.ZERO = ZeroTable;
+	GFX.SubScreen  = (uint16 *) malloc(GFX.ScreenSize * sizeof(uint16));
+	GFX.ZBuffer    = (uint8 *)  malloc(GFX.ScreenSize);
+	GFX.SubZBuffer = (uint8 *)  malloc(GFX.ScreenSize);
+
+	if (!GFX.SubScreen || !GFX.ZBuffer || !GFX.SubZBuffer)
+	{
+		S9xGraphicsDeinit();
+		return (FALSE);
+	}
+
+	return (TRUE);
+}
+
 void S9xGraphicsDeinit (void)
 {
-	if (GFX.ZERO)       { free(GFX.ZERO);       GFX.ZERO       = NULL; }
+	GFX.ZERO = NULL;
 	if (GFX.SubScreen)  { free(GFX.SubScreen);  GFX.SubScreen  = NULL; }
 	if (GFX.ZBuffer)    { free(GFX.ZBuffer);    GFX.ZBuffer    = NULL; }
 	if (GFX.SubZBuffer) { free(GFX.SubZBuffer); GFX.SubZBuffer = NULL; }
@@ -228,6 +238,7 @@ void S9xEndScreenRefresh (void)
 		S9xControlEOF();
 
 	S9xUpdateCheatsInMemory ();
+	S9xCheatSearchFrame (&Cheat);
 
 #ifdef DEBUGGER
 	if (CPU.Flags & FRAME_ADVANCE_FLAG)
@@ -1901,8 +1912,8 @@ static void DisplayTime (void)
 static void DisplayFrameRate (void)
 {
 	char	string[10];
-	static uint32 lastFrameCount = 0, calcFps = 0;
-	static time_t lastTime = time(NULL);
+	S9X_INSTANCE_STATIC uint32 lastFrameCount = 0, calcFps = 0;
+	S9X_INSTANCE_STATIC time_t lastTime = time(NULL);
 
 	time_t currTime = time(NULL);
 	if (lastTime != currTime) {
@@ -12,6 +12,7 @@
 #include "fxemu.h"
 #include "srtc.h"
 #include "cheats.h"
+#include "statehash.h"
 #ifdef NETPLAY_SUPPORT
 #include "netplay.h"
 #endif
@@ -20,53 +21,67 @@
 #include "missing.h"
 #endif
 
-struct SCPUState		CPU;
-struct SICPU			ICPU;
-struct SRegisters		Registers;
-struct SPPU				PPU;
-struct InternalPPU		IPPU;
-struct SDMA				DMA[8];
-struct STimings			Timings;
-struct SGFX				GFX;
-struct SBG				BG;
-struct SLineData		LineData[240];
-struct SLineMatrixData	LineMatrixData[240];
-struct SDSP0			DSP0;
-struct SDSP1			DSP1;
-struct SDSP2			DSP2;
-struct SDSP3			DSP3;
-struct SDSP4			DSP4;
-struct SSA1				SA1;
-struct SSA1Registers	SA1Registers;
-struct FxRegs_s			GSU;
-struct FxInfo_s			SuperFX;
-struct SST010			ST010;
-struct SST011			ST011;
-struct SST018			ST018;
-struct SOBC1			OBC1;
-struct SSPC7110Snapshot	s7snap;
-struct SSRTCSnapshot	srtcsnap;
-struct SRTCData			RTCData;
-struct SBSX				BSX;
-struct SMSU1			MSU1;
-struct SMulti			Multi;
-struct SSettings		Settings;
-struct SSNESGameFixes	SNESGameFixes;
+S9X_INSTANCE struct SCPUState		CPU;
+S9X_INSTANCE struct SICPU			ICPU;
+S9X_INSTANCE struct SRegisters		Registers;
+S9X_INSTANCE struct SPPU				PPU;
+S9X_INSTANCE struct InternalPPU		IPPU;
+S9X_INSTANCE struct SDMA				DMA[8];
+S9X_INSTANCE struct STimings			Timings;
+S9X_INSTANCE struct SGFX				GFX;
+S9X_INSTANCE struct SBG				BG;
+S9X_INSTANCE struct SLineData		LineData[240];
+S9X_INSTANCE struct SLineMatrixData	LineMatrixData[240];
+S9X_INSTANCE struct SDSP0			DSP0;
+S9X_INSTANCE struct SDSP1			DSP1;
+S9X_INSTANCE struct SDSP2			DSP2;
+S9X_INSTANCE struct SDSP3			DSP3;
+S9X_INSTANCE struct SDSP4			DSP4;
+S9X_INSTANCE struct SSA1				SA1;
+S9X_INSTANCE struct SSA1Registers	SA1Registers;
+S9X_INSTANCE struct FxRegs_s			GSU;
+S9X_INSTANCE struct FxInfo_s			SuperFX;
+S9X_INSTANCE struct SST010			ST010;
+S9X_INSTANCE struct SST011			ST011;
+S9X_INSTANCE struct SST018			ST018;
+S9X_INSTANCE struct SOBC1			OBC1;
+S9X_INSTANCE struct SSPC7110Snapshot	s7snap;
+S9X_INSTANCE struct SSRTCSnapshot	srtcsnap;
+S9X_INSTANCE struct SRTCData			RTCData;
+S9X_INSTANCE struct SBSX				BSX;
+S9X_INSTANCE struct SMSU1			MSU1;
+S9X_INSTANCE struct SMulti			Multi;
+S9X_INSTANCE struct SSettings		Settings;
+S9X_INSTANCE struct SSNESGameFixes	SNESGameFixes;
 #ifdef NETPLAY_SUPPORT
 struct SNetPlay			NetPlay;
 #endif
 #ifdef DEBUGGER
-struct Missing			missing;
+S9X_INSTANCE struct Missing			missing;
 #endif
-struct SCheatData		Cheat;
-struct Watch			watches[16];
-CMemory					Memory;
+S9X_INSTANCE struct SCheatData		Cheat;
+S9X_INSTANCE struct SStateHash		StateHash;
+S9X_INSTANCE struct Watch			watches[16];
+S9X_INSTANCE CMemory					Memory;
 
-char	String[513];
-uint8	OpenBus = 0;
-uint8	*HDMAMemPointers[8];
-uint16	BlackColourMap[256];
-uint16	DirectColourMaps[8][256];
+S9X_INSTANCE char	String[513];
+S9X_INSTANCE uint8	OpenBus = 0;
+S9X_INSTANCE uint8	*HDMAMemPointers[8];
+S9X_INSTANCE uint16	BlackColourMap[256];
+S9X_INSTANCE uint16	DirectColourMaps[8][256];
+
+#ifdef S9X_MULTI_INSTANCE
+// The core is built with -fno-extern-tls-init, so other files use the state
+// above without checking that this thread's copy has been constructed.
+// Naming the objects with constructors here does it.
+void S9xInitInstance (void)
+{
+	(void) &Memory;
+	(void) &GFX;
+	(void) &Cheat;
+	(void) &BSX;
+}
+#endif
 
 SnesModel	M1SNES = { 1, 3, 2 };
 SnesModel	M2SNES = { 2, 4, 3 };
@@ -119,7 +134,7 @@ uint8 mul_brightness[16][32] =
 	  0x10, 0x11, 0x12, 0x13, 0x14, 0x15, 0x16, 0x17, 0x18, 0x19, 0x1a, 0x1b, 0x1c, 0x1d, 0x1e, 0x1f }
 };
 
-uint8 brightness_cap[64];
+S9X_INSTANCE uint8 brightness_cap[64];
 
 uint8 S9xOpLengthsM0X0[256] =
 {
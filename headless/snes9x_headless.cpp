@@ -0,0 +1,368 @@
+/*****************************************************************************\
+     Snes9x - Portable Super Nintendo Entertainment System (TM) emulator.
+                This file is licensed under the Snes9x License.
+   For further information, consult the LICENSE file in the root directory.
+\*****************************************************************************/
+
+#include <vector>
+#include <string>
+
+#include "snes9x.h"
+#include "memmap.h"
+#include "apu/apu.h"
+#include "apu/bapu/snes/snes.hpp"
+#include "gfx.h"
+#include "cheats.h"
+#include "snapshot.h"
+#include "controls.h"
+#include "movie.h"
+#include "display.h"
+#include "conffile.h"
+#include "romscan.h"
+#include "snes9x_headless.h"
+
+S9X_INSTANCE_STATIC bool8				rom_loaded = FALSE;
+S9X_INSTANCE_STATIC bool8				render = TRUE;
+S9X_INSTANCE_STATIC bool8				audio = TRUE;
+S9X_INSTANCE_STATIC int					screen_width = SNES_WIDTH;
+S9X_INSTANCE_STATIC int					screen_height = SNES_HEIGHT;
+S9X_INSTANCE_STATIC std::vector<int16>	audio_buffer;
+S9X_INSTANCE_STATIC void				(*message_callback) (int, const char *) = NULL;
+
+int snes9x_init (void)
+{
+	S9xInitInstance();
+
+	memset(&Settings, 0, sizeof(Settings));
+	Settings.MouseMaster = TRUE;
+	Settings.SuperScopeMaster = TRUE;
+	Settings.JustifierMaster = TRUE;
+	Settings.MultiPlayer5Master = TRUE;
+	Settings.MacsRifleMaster = TRUE;
+	Settings.FrameTimePAL = 20000;
+	Settings.FrameTimeNTSC = 16667;
+	Settings.SixteenBitSound = TRUE;
+	Settings.Stereo = TRUE;
+	Settings.SoundPlaybackRate = 32040;
+	Settings.SoundInputRate = 32040;
+	Settings.Transparency = TRUE;
+	Settings.HDMATimingHack = 100;
+	Settings.BlockInvalidVRAMAccessMaster = TRUE;
+	Settings.MaxSpriteTilesPerLine = 34;
+	Settings.SuperFXClockMultiplier = 100;
+	Settings.InterpolationMethod = DSP_INTERPOLATION_GAUSSIAN;
+	Settings.DontSaveOopsSnapshot = TRUE;
+	// Nothing is drawn over the game; messages go to the callback.
+	Settings.AutoDisplayMessages = FALSE;
+	// Loading a snapshot doesn't clear buffers it is about to overwrite.
+	Settings.FastSavestates = TRUE;
+
+	CPU.Flags = 0;
+
+	if (!Memory.Init() || !S9xInitAPU())
+	{
+		Memory.Deinit();
+		S9xDeinitAPU();
+		return (0);
+	}
+
+	S9xInitSound(32);
+	S9xSetSoundMute(FALSE);
+	S9xSetSamplesAvailableCallback(NULL, NULL);
+
+	if (!S9xGraphicsInit())
+	{
+		Memory.Deinit();
+		S9xDeinitAPU();
+		return (0);
+	}
+
+	S9xUnmapAllControls();
+	S9xSetController(0, CTL_JOYPAD, 0, 0, 0, 0);
+	S9xSetController(1, CTL_JOYPAD, 1, 0, 0, 0);
+	S9xVerifyControllers();
+
+	render = TRUE;
+	audio = TRUE;
+	rom_loaded = FALSE;
+
+	return (1);
+}
+
+void snes9x_deinit (void)
+{
+	S9xDeinitAPU();
+	Memory.Deinit();
+	S9xGraphicsDeinit();
+	S9xUnmapAllControls();
+
+	std::vector<int16>().swap(audio_buffer);
+	rom_loaded = FALSE;
+}
+
+void snes9x_set_message_callback (void (*callback) (int, const char *))
+{
+	message_callback = callback;
+}
+
+int snes9x_load_rom (const void *data, size_t size, const char *name)
+{
+	if (size > CMemory::MAX_ROM_SIZE)
+		return (0);
+
+	rom_loaded = Memory.LoadROMMem((const uint8 *) data, (uint32) size, name);
+	return (rom_loaded);
+}
+
+int snes9x_load_rom_file (const char *filename)
+{
+	rom_loaded = Memory.LoadROM(filename);
+	return (rom_loaded);
+}
+
+void snes9x_reset (void)
+{
+	if (rom_loaded)
+		S9xReset();
+}
+
+void snes9x_set_render (int enable)
+{
+	render = enable != 0;
+}
+
+void snes9x_set_audio (int enable)
+{
+	// Samples still have to be produced to keep the APU in step, but they go
+	// to a scratch buffer that is never mixed.
+	audio = enable != 0;
+	S9xSetSoundDiscard(!audio);
+	if (!audio)
+		S9xClearSamples();
+}
+
+void snes9x_set_map_rom_file (int enable)
+{
+	Settings.MapROMFile = enable != 0;
+}
+
+void snes9x_set_multitap (int enable)
+{
+	if (enable)
+		S9xSetController(1, CTL_MP5, 1, 2, 3, 4);
+	else
+		S9xSetController(1, CTL_JOYPAD, 1, 0, 0, 0);
+
+	S9xVerifyControllers();
+}
+
+void snes9x_run (int frames, const uint16_t *input, int num_pads)
+{
+	audio_buffer.clear();
+
+	if (!rom_loaded)
+		return;
+
+	if (num_pads > SNES9X_MAX_PADS)
+		num_pads = SNES9X_MAX_PADS;
+
+	for (int i = 0; i < SNES9X_MAX_PADS; i++)
+		MovieSetJoypad(i, (input && i < num_pads) ? input[i] : 0);
+
+	for (int f = 0; f < frames; f++)
+	{
+		IPPU.RenderThisFrame = render;
+		S9xMainLoop();
+	}
+}
+
+const uint16_t * snes9x_framebuffer (int *width, int *height, int *pitch)
+{
+	if (width)
+		*width = screen_width;
+	if (height)
+		*height = screen_height;
+	if (pitch)
+		*pitch = GFX.Pitch;
+
+	return (GFX.Screen);
+}
+
+const int16_t * snes9x_audio (size_t *frames)
+{
+	if (frames)
+		*frames = audio_buffer.size() >> 1;
+
+	return (audio_buffer.empty() ? NULL : &audio_buffer[0]);
+}
+
+uint8_t * snes9x_memory (enum snes9x_memory type, size_t *size)
+{
+	uint8	*data = NULL;
+	size_t	len = 0;
+
+	switch (type)
+	{
+		case SNES9X_MEMORY_WRAM:
+			data = Memory.RAM;
+			len = sizeof(Memory.RAM);
+			break;
+
+		case SNES9X_MEMORY_VRAM:
+			data = Memory.VRAM;
+			len = sizeof(Memory.VRAM);
+			break;
+
+		case SNES9X_MEMORY_OAM:
+			data = PPU.OAMData;
+			len = sizeof(PPU.OAMData);
+			break;
+
+		case SNES9X_MEMORY_CGRAM:
+			data = (uint8 *) PPU.CGDATA;
+			len = sizeof(PPU.CGDATA);
+			break;
+
+		case SNES9X_MEMORY_SRAM:
+			data = Memory.SRAM;
+			len = Memory.SRAMSize ? (1 << (Memory.SRAMSize + 3)) * 128 : 0;
+			if (len > Memory.SRAM_SIZE)
+				len = Memory.SRAM_SIZE;
+			break;
+
+		case SNES9X_MEMORY_ARAM:
+			data = SNES::smp.apuram;
+			len = 0x10000;
+			break;
+
+		case SNES9X_MEMORY_ROM:
+			data = Memory.ROM;
+			len = rom_loaded ? Memory.CalculatedSize : 0;
+			break;
+	}
+
+	if (size)
+		*size = len;
+
+	return (data);
+}
+
+int snes9x_frame_rate (void)
+{
+	return (Settings.PAL ? 50 : 60);
+}
+
+size_t snes9x_state_size (void)
+{
+	return (rom_loaded ? S9xFreezeSize() : 0);
+}
+
+int snes9x_save_state (void *buffer, size_t size)
+{
+	if (!rom_loaded || size < S9xFreezeSize())
+		return (0);
+
+	return (S9xFreezeGameMem((uint8 *) buffer, (uint32) size));
+}
+
+int snes9x_load_state (const void *buffer, size_t size)
+{
+	if (!rom_loaded)
+		return (0);
+
+	return (S9xUnfreezeGameMem((const uint8 *) buffer, (uint32) size) == SUCCESS);
+}
+
+size_t snes9x_resident_bytes (void)
+{
+	// The rest of the machine is small and always in use.
+	return (Memory.ResidentBytes() +
+			S9xResidentBytes(GFX.ScreenBuffer.data(), GFX.ScreenBuffer.size() * sizeof(uint16)) +
+			S9xResidentBytes(GFX.SubScreen, GFX.ScreenSize * sizeof(uint16)) +
+			S9xResidentBytes(GFX.ZBuffer, GFX.ScreenSize) +
+			S9xResidentBytes(GFX.SubZBuffer, GFX.ScreenSize) +
+			S9xResidentBytes(&Cheat, sizeof(Cheat)));
+}
+
+int snes9x_scan_roms (const char *dir, const char *catalog, int threads)
+{
+	return (S9xScanROMs(dir, catalog, threads));
+}
+
+// Port interface
+
+void S9xSyncSpeed (void)
+{
+	if (!audio)
+		return;
+
+	size_t	start = audio_buffer.size();
+	int		avail = S9xGetSampleCount();
+
+	audio_buffer.resize(start + avail);
+	S9xMixSamples((uint8 *) &audio_buffer[start], avail);
+}
+
+bool8 S9xInitUpdate (void)
+{
+	return (TRUE);
+}
+
+bool8 S9xDeinitUpdate (int width, int height)
+{
+	screen_width = width;
+	screen_height = height;
+	return (TRUE);
+}
+
+bool8 S9xContinueUpdate (int width, int height)
+{
+	return (S9xDeinitUpdate(width, height));
+}
+
+void S9xMessage (int type, int, const char *message)
+{
+	if (message_callback)
+		message_callback(type, message);
+}
+
+std::string S9xGetDirectory (enum s9x_getdirtype)
+{
+	return (".");
+}
+
+std::string S9xGetFilenameInc (std::string, enum s9x_getdirtype)
+{
+	return ("");
+}
+
+bool8 S9xOpenSnapshotFile (const char *filename, bool8 read_only, STREAM *file)
+{
+	if ((*file = OPEN_STREAM(filename, read_only ? "rb" : "wb")))
+		return (TRUE);
+
+	return (FALSE);
+}
+
+void S9xCloseSnapshotFile (STREAM file)
+{
+	CLOSE_STREAM(file);
+}
+
+const char * S9xStringInput (const char *s)
+{
+	return (s);
+}
+
+void S9xParsePortConfig (ConfigFile &, int) { }
+void S9xInitInputDevices (void) { }
+void S9xHandlePortCommand (s9xcommand_t, int16, int16) { }
+bool S9xPollButton (uint32, bool *) { return (false); }
+bool S9xPollAxis (uint32, int16 *) { return (false); }
+bool S9xPollPointer (uint32, int16 *, int16 *) { return (false); }
+void S9xToggleSoundChannel (int) { }
+bool8 S9xOpenSoundDevice (void) { return (TRUE); }
+void S9xAutoSaveSRAM (void) { }
+void S9xExtraUsage (void) { }
+void S9xParseArg (char **, int &, int) { }
+void S9xExit (void) { }
@@ -0,0 +1,150 @@
+/*****************************************************************************\
+     Snes9x - Portable Super Nintendo Entertainment System (TM) emulator.
+                This file is licensed under the Snes9x License.
+   For further information, consult the LICENSE file in the root directory.
+\*****************************************************************************/
+
+#ifndef _SNES9X_HEADLESS_H_
+#define _SNES9X_HEADLESS_H_
+
+/*
+ * Snes9x as a plain library, for programs that drive the emulator
+ * themselves: batch tools, test harnesses and reinforcement learning
+ * environments that run many short rollouts.
+ *
+ * There are no callbacks. The caller loads a ROM, runs frames with the
+ * input it wants, and then reads what it needs through the pointers
+ * returned below. Those pointers point into the emulator itself and stay
+ * valid until snes9x_deinit().
+ *
+ * There is no emulator object or handle. Every thread has an emulator of its
+ * own: snes9x_init() sets up the one belonging to the calling thread, and
+ * all the other functions act on it. Running several games at once is a
+ * matter of running them on different threads, each of which must call
+ * snes9x_deinit() before it exits. The emulators share nothing, so no
+ * locking is needed, but the pointers below are only valid on the thread
+ * that obtained them.
+ *
+ * So an emulator is bound to the thread that created it for its whole life.
+ * It can't be handed to another thread, and one thread can't switch between
+ * several: a call made from elsewhere acts on a different emulator, or on
+ * none. A thread pool can't schedule emulators as tasks; each game needs a
+ * thread of its own, and pools or coroutines that may resume a task on
+ * another thread are not supported.
+ *
+ * The state of a machine is kept in thread-local storage, about 1.6MB of
+ * it, which the system reserves for every thread in the process. Threads
+ * created with very small stacks may fail to start. Reaching it costs more
+ * from the shared library than from the static one, which is the faster of
+ * the two.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(_WIN32)
+#define SNES9X_API __declspec(dllexport)
+#elif defined(__GNUC__)
+#define SNES9X_API __attribute__((visibility("default")))
+#else
+#define SNES9X_API
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Joypad buttons, as they appear in the input vector passed to snes9x_run. */
+#define SNES9X_BUTTON_R			(1 <<  4)
+#define SNES9X_BUTTON_L			(1 <<  5)
+#define SNES9X_BUTTON_X			(1 <<  6)
+#define SNES9X_BUTTON_A			(1 <<  7)
+#define SNES9X_BUTTON_RIGHT		(1 <<  8)
+#define SNES9X_BUTTON_LEFT		(1 <<  9)
+#define SNES9X_BUTTON_DOWN		(1 << 10)
+#define SNES9X_BUTTON_UP		(1 << 11)
+#define SNES9X_BUTTON_START		(1 << 12)
+#define SNES9X_BUTTON_SELECT	(1 << 13)
+#define SNES9X_BUTTON_Y			(1 << 14)
+#define SNES9X_BUTTON_B			(1 << 15)
+
+#define SNES9X_MAX_PADS			8
+
+enum snes9x_memory
+{
+	SNES9X_MEMORY_WRAM,		/* 128KB work RAM */
+	SNES9X_MEMORY_VRAM,		/* 64KB video RAM */
+	SNES9X_MEMORY_OAM,		/* 544 bytes of sprite attributes */
+	SNES9X_MEMORY_CGRAM,	/* 256 colours, one host-endian uint16 each */
+	SNES9X_MEMORY_SRAM,		/* cartridge RAM, if the cartridge has any */
+	SNES9X_MEMORY_ARAM,		/* 64KB audio RAM */
+	SNES9X_MEMORY_ROM
+};
+
+/* Returns 0 if the emulator could not allocate its memory. */
+SNES9X_API int snes9x_init (void);
+SNES9X_API void snes9x_deinit (void);
+
+/* Messages the emulator would show on screen or print; NULL to drop them. */
+SNES9X_API void snes9x_set_message_callback (void (*callback) (int type, const char *message));
+
+/* name is optional and only used for messages. Returns 0 on failure. */
+SNES9X_API int snes9x_load_rom (const void *data, size_t size, const char *name);
+/* Same from a file. */
+SNES9X_API int snes9x_load_rom_file (const char *filename);
+/* Off by default. When on, and where the system allows it, a ROM file
+ * without a copier header is mapped rather than read, so that instances
+ * running the same game share its memory. The file must then not be changed
+ * while it is in use. Applies to ROMs loaded afterwards. */
+SNES9X_API void snes9x_set_map_rom_file (int enable);
+SNES9X_API void snes9x_reset (void);
+
+/* Rendering and sound output are on by default. Turning them off skips the
+ * work without changing emulation: the game runs exactly the same. */
+SNES9X_API void snes9x_set_render (int enable);
+SNES9X_API void snes9x_set_audio (int enable);
+
+/* Plugs a multitap into the second port, making pads 2 to 5 available. */
+SNES9X_API void snes9x_set_multitap (int enable);
+
+/* Runs the given number of frames, holding the buttons in input[pad] for
+ * all of them; input may be NULL for no buttons. The number of entries
+ * read is num_pads, at most SNES9X_MAX_PADS. */
+SNES9X_API void snes9x_run (int frames, const uint16_t *input, int num_pads);
+
+/* The last rendered frame, RGB565. pitch is in bytes. */
+SNES9X_API const uint16_t * snes9x_framebuffer (int *width, int *height, int *pitch);
+
+/* Interleaved 16-bit stereo samples produced by the last snes9x_run call;
+ * *frames is set to the number of sample pairs. */
+SNES9X_API const int16_t * snes9x_audio (size_t *frames);
+
+SNES9X_API uint8_t * snes9x_memory (enum snes9x_memory type, size_t *size);
+
+SNES9X_API int snes9x_frame_rate (void);	/* 60 or 50 */
+
+/* Snapshots in memory. snes9x_state_size is fixed for a loaded ROM, so one
+ * buffer can be reused; both calls return 0 on failure. */
+SNES9X_API size_t snes9x_state_size (void);
+SNES9X_API int snes9x_save_state (void *buffer, size_t size);
+SNES9X_API int snes9x_load_state (const void *buffer, size_t size);
+
+/* Memory the calling thread's emulator actually occupies, in bytes. Buffers
+ * are sized for the largest cartridge but only take memory as the game uses
+ * them, so this depends on the game and grows a little as it runs. Where the
+ * system can't tell, whole buffers are counted. A mapped ROM file is counted
+ * in full although its pages are shared. */
+SNES9X_API size_t snes9x_resident_bytes (void);
+
+/* Catalogs every ROM under dir into the file catalog, with its hashes and
+ * what its header says, in the BML layout of the cheat database. The work is
+ * spread over the given number of threads, or one per core if that is 0.
+ * This needs no emulator and leaves the calling thread's one alone. Returns
+ * the number of ROMs found, or -1 if the catalog could not be written. */
+SNES9X_API int snes9x_scan_roms (const char *dir, const char *catalog, int threads);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,309 @@
+/*****************************************************************************\
+     Snes9x - Portable Super Nintendo Entertainment System (TM) emulator.
+                This file is licensed under the Snes9x License.
+   For further information, consult the LICENSE file in the root directory.
+\*****************************************************************************/
+
+// Records the emulation so the debugger can step and continue backwards.
+// While recording, S-CPU instructions are counted, so a point in the past is
+// named by how many had run, a snapshot is taken at the start of the main
+// loop every few frames, and the joypads are logged whenever they change.
+// Going back restores the last snapshot before the point and runs forward
+// again, with no sound or rendering and the logged joypads fed back in,
+// until the count is reached. Searching back for a breakpoint hit runs the
+// stretches between snapshots the same way, newest first, noting where
+// points are hit.
+//
+// That relies on the emulation being repeatable from a snapshot and the
+// joypads, so anything read from the host clock, like the S-RTC, may stray.
+
+#ifdef DEBUGGER
+
+#include <deque>
+#include <vector>
+#include "snes9x.h"
+#include "memmap.h"
+#include "sa1.h"
+#include "apu/apu.h"
+#include "snapshot.h"
+#include "movie.h"
+#include "debug.h"
+#include "profile.h"
+#include "history.h"
+
+#define HISTORY_PADS		8
+#define HISTORY_NO_HIT		(~(uint64) 0)
+
+struct history_checkpoint
+{
+	uint64				instructions;
+	size_t				input;					// first input logged after it
+	uint16				pads[HISTORY_PADS];
+	std::vector<uint8>	state;
+};
+
+struct history_input
+{
+	uint64	instructions;
+	uint16	pads[HISTORY_PADS];
+};
+
+struct SHistory	S9xHistory = { FALSE, FALSE, FALSE, 0 };
+
+static std::deque<history_checkpoint>	checkpoints;
+static std::vector<history_input>		inputs;
+
+static uint16	pads[HISTORY_PADS];		// as last logged
+static uint32	interval = 60;			// frames between snapshots
+static uint32	max_count = 60;			// snapshots kept
+static uint32	last_frame;
+static uint32	frames;
+static size_t	next_input;
+static uint64	target;
+static uint64	hit;
+static uint64	search_end;
+
+static void history_read_pads (uint16 *);
+static void history_checkpoint_take (void);
+static bool8 history_run (const history_checkpoint &, uint64);
+static void history_truncate (void);
+
+
+static void history_read_pads (uint16 *p)
+{
+	for (int i = 0; i < HISTORY_PADS; i++)
+		p[i] = MovieGetJoypad(i);
+}
+
+static void history_checkpoint_take (void)
+{
+	history_checkpoint	cp;
+
+	if (checkpoints.size() >= max_count)
+	{
+		size_t	drop;
+
+		// The oldest snapshot's buffer is reused for the new one.
+		cp.state.swap(checkpoints.front().state);
+		checkpoints.pop_front();
+
+		drop = checkpoints.empty() ? inputs.size() : checkpoints.front().input;
+		inputs.erase(inputs.begin(), inputs.begin() + drop);
+
+		for (size_t i = 0; i < checkpoints.size(); i++)
+			checkpoints[i].input -= drop;
+	}
+
+	cp.instructions = S9xHistory.Instructions;
+	cp.input = inputs.size();
+	memcpy(cp.pads, pads, sizeof(pads));
+	cp.state.resize(S9xFreezeSize());
+	S9xFreezeGameMem(&cp.state[0], cp.state.size());
+
+	checkpoints.push_back(cp);
+	frames = 0;
+}
+
+// Runs from cp until count instructions have run, as the debugger left them.
+static bool8 history_run (const history_checkpoint &cp, uint64 count)
+{
+	bool8	render = IPPU.RenderThisFrame;
+	uint32	trace = CPU.Flags & TRACE_FLAG;
+	uint32	sa1_trace = SA1.Flags & TRACE_FLAG;
+	uint8	profile = S9xProfile.Targets;
+
+	S9xHistory.Replaying = TRUE;
+	S9xUnfreezeGameMem(&cp.state[0], cp.state.size());
+
+	for (int i = 0; i < HISTORY_PADS; i++)
+		MovieSetJoypad(i, cp.pads[i]);
+
+	S9xHistory.Instructions = cp.instructions;
+	next_input = cp.input;
+	target = count;
+
+	CPU.Flags &= ~(DEBUG_MODE_FLAG | TRACE_FLAG | SINGLE_STEP_FLAG | FRAME_ADVANCE_FLAG);
+	SA1.Flags &= ~TRACE_FLAG;
+	S9xProfile.Targets = 0;
+	S9xUpdateBreakpoints();
+	S9xSetSoundDiscard(TRUE);
+
+	// A stretch is at most interval frames, so don't run on for ever if
+	// the count isn't met.
+	for (uint32 i = 0; i <= interval + 1 && !(CPU.Flags & DEBUG_MODE_FLAG); i++)
+	{
+		IPPU.RenderThisFrame = FALSE;
+		S9xMainLoop();
+	}
+
+	S9xSetSoundDiscard(FALSE);
+	IPPU.RenderThisFrame = render;
+	S9xProfile.Targets = profile;
+	SA1.Flags |= sa1_trace;
+	CPU.Flags |= trace | DEBUG_MODE_FLAG;
+	S9xHistory.Replaying = FALSE;
+
+	return (S9xHistory.Instructions == count);
+}
+
+// Forgets what came after the present, which may now go differently.
+static void history_truncate (void)
+{
+	while (!checkpoints.empty() && checkpoints.back().instructions > S9xHistory.Instructions)
+		checkpoints.pop_back();
+
+	while (!inputs.empty() && inputs.back().instructions > S9xHistory.Instructions)
+		inputs.pop_back();
+
+	history_read_pads(pads);
+	last_frame = IPPU.TotalEmulatedFrames;
+	frames = 0;
+}
+
+void S9xHistoryStart (uint32 frame_interval, uint32 count)
+{
+	S9xHistoryStop();
+
+	interval = frame_interval ? frame_interval : 60;
+	max_count = count ? count : 60;
+
+	S9xHistory.Recording = TRUE;
+	S9xHistory.Instructions = 0;
+}
+
+void S9xHistoryStop (void)
+{
+	checkpoints.clear();
+	inputs.clear();
+	S9xHistory.Recording = FALSE;
+}
+
+// Called when the game is reset or a snapshot is loaded, other than by
+// going back. The next snapshot is taken when the main loop is next entered.
+void S9xHistoryReset (void)
+{
+	if (S9xHistory.Replaying)
+		return;
+
+	checkpoints.clear();
+	inputs.clear();
+}
+
+// Called on entering S9xMainLoop while recording.
+void S9xHistoryRecord (void)
+{
+	uint16	now[HISTORY_PADS];
+
+	history_read_pads(now);
+
+	if (memcmp(now, pads, sizeof(pads)) != 0)
+	{
+		history_input	in;
+
+		memcpy(pads, now, sizeof(pads));
+
+		if (!checkpoints.empty())
+		{
+			in.instructions = S9xHistory.Instructions;
+			memcpy(in.pads, now, sizeof(now));
+			inputs.push_back(in);
+		}
+	}
+
+	if (IPPU.TotalEmulatedFrames != last_frame)
+	{
+		last_frame = IPPU.TotalEmulatedFrames;
+		frames++;
+	}
+
+	if (checkpoints.empty() || frames >= interval)
+		history_checkpoint_take();
+}
+
+// Called before each S-CPU instruction while replaying.
+void S9xHistoryReplay (void)
+{
+	for (; next_input < inputs.size() && inputs[next_input].instructions <= S9xHistory.Instructions; next_input++)
+	{
+		for (int i = 0; i < HISTORY_PADS; i++)
+			MovieSetJoypad(i, inputs[next_input].pads[i]);
+	}
+
+	if (S9xHistory.Instructions >= target)
+		CPU.Flags |= DEBUG_MODE_FLAG;
+}
+
+// Called from S9xBreakHit while searching.
+void S9xHistoryHit (void)
+{
+	if (S9xHistory.Instructions < search_end)
+		hit = S9xHistory.Instructions;
+}
+
+uint64 S9xHistoryOldest (void)
+{
+	return (checkpoints.empty() ? S9xHistory.Instructions : checkpoints.front().instructions);
+}
+
+bool8 S9xHistorySeek (uint64 count)
+{
+	if (checkpoints.empty())
+		return (FALSE);
+
+	size_t	k = checkpoints.size() - 1;
+
+	while (k > 0 && checkpoints[k].instructions > count)
+		k--;
+
+	if (count < checkpoints[k].instructions)
+		count = checkpoints[k].instructions;
+
+	bool8	reached = history_run(checkpoints[k], count);
+
+	history_truncate();
+
+	return (reached);
+}
+
+// Goes back to the last time a breakpoint or watchpoint was hit, or stays
+// put if none was.
+bool8 S9xHistorySearch (void)
+{
+	uint64				now = S9xHistory.Instructions;
+	uint16				now_pads[HISTORY_PADS];
+	std::vector<uint8>	state(S9xFreezeSize());
+
+	history_read_pads(now_pads);
+	S9xFreezeGameMem(&state[0], state.size());
+
+	hit = HISTORY_NO_HIT;
+	search_end = now;
+	S9xHistory.Searching = TRUE;
+
+	for (size_t k = checkpoints.size(); k-- > 0 && hit == HISTORY_NO_HIT; )
+	{
+		if (checkpoints[k].instructions >= now)
+			continue;
+
+		history_run(checkpoints[k], k + 1 < checkpoints.size() ? checkpoints[k + 1].instructions : now);
+	}
+
+	S9xHistory.Searching = FALSE;
+
+	if (hit != HISTORY_NO_HIT)
+		return (S9xHistorySeek(hit));
+
+	S9xHistory.Replaying = TRUE;
+	S9xUnfreezeGameMem(&state[0], state.size());
+	S9xHistory.Replaying = FALSE;
+
+	for (int i = 0; i < HISTORY_PADS; i++)
+		MovieSetJoypad(i, now_pads[i]);
+
+	S9xHistory.Instructions = now;
+	S9xUpdateBreakpoints();
+
+	return (FALSE);
+}
+
+#endif
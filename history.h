@@ -0,0 +1,34 @@
+/*****************************************************************************\
+     Snes9x - Portable Super Nintendo Entertainment System (TM) emulator.
+                This file is licensed under the Snes9x License.
+   For further information, consult the LICENSE file in the root directory.
+\*****************************************************************************/
+
+#ifdef DEBUGGER
+
+#ifndef _HISTORY_H_
+#define _HISTORY_H_
+
+struct SHistory
+{
+	bool8	Recording;
+	bool8	Replaying;			// running again over recorded history
+	bool8	Searching;			// replaying to find breakpoint hits
+	uint64	Instructions;		// S-CPU instructions run while recording
+};
+
+extern struct SHistory	S9xHistory;
+
+void S9xHistoryStart (uint32, uint32);
+void S9xHistoryStop (void);
+void S9xHistoryReset (void);
+void S9xHistoryRecord (void);
+void S9xHistoryReplay (void);
+void S9xHistoryHit (void);
+uint64 S9xHistoryOldest (void);
+bool8 S9xHistorySeek (uint64);
+bool8 S9xHistorySearch (void);
+
+#endif
+
+#endif
@@ -65,8 +65,12 @@ public:
     BYTE *p = m_Buffer + m_Pos;
     aDistance++;
    BYTE *p2 = p - aDistance;
-    for(UINT32 i = 0; i < aLen; i++)
-      p[i] = p2[i];
+    // A match further back than its length doesn't overlap itself
+    if (aDistance >= aLen)
+      memcpy(p, p2, aLen);
+    else
+      for(UINT32 i = 0; i < aLen; i++)
+        p[i] = p2[i];
     m_Pos += aLen;
   }
 
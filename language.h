@@ -17,6 +17,7 @@
 #define MOVIE_INFO_STOP					"Movie stop"
 #define MOVIE_INFO_END					"Movie end"
 #define MOVIE_INFO_SNAPSHOT				"Movie snapshot"
+#define MOVIE_INFO_DESYNC				"Movie desync detected at frame %u"
 #define MOVIE_ERR_SNAPSHOT_INCONSISTENT	"Snapshot inconsistent with movie"
 
 // Snapshot Messages
@@ -17,7 +17,7 @@
 #include "memmap.h"
 
 
-bool8 LoadZip (const char *zipname, uint32 *TotalFileSize, uint8 *buffer)
+bool8 LoadZip (const char *zipname, uint32 *TotalFileSize, uint8 *buffer, CMemory &mem)
 {
 	*TotalFileSize = 0;
 
@@ -101,6 +101,18 @@ bool8 LoadZip (const char *zipname, uint32 *TotalFileSize, uint8 *buffer)
 		assert(info.uncompressed_size <= CMemory::MAX_ROM_SIZE + 512);
 
 		uint32 FileSize = info.uncompressed_size;
+		uint32	HeaderSize = mem.HeaderSize(FileSize);
+		uint8	header[512];
+		int		h = 0;
+
+		// Inflate a copier header on its own, so that the ROM itself goes
+		// straight where it belongs and needn't be moved down afterwards.
+		if (HeaderSize)
+		{
+			h = unzReadCurrentFile(file, header, HeaderSize);
+			FileSize -= HeaderSize;
+		}
+
 		int	l = unzReadCurrentFile(file, ptr, FileSize);
 
 		if (unzCloseCurrentFile(file) == UNZ_CRCERROR)
@@ -109,25 +121,27 @@ bool8 LoadZip (const char *zipname, uint32 *TotalFileSize, uint8 *buffer)
 			return (FALSE);
 		}
 
-		if (l <= 0 || l != (int) FileSize)
+		if (l <= 0 || l != (int) FileSize || h != (int) HeaderSize)
 		{
 			unzClose(file);
 			return (FALSE);
 		}
 
-		FileSize = Memory.HeaderRemove(FileSize, ptr);
+		if (HeaderSize)
+			mem.HeaderSkip(header);
+
 		ptr += FileSize;
 		*TotalFileSize += FileSize;
 
 		int	len;
 
-		if (ptr - Memory.ROM < CMemory::MAX_ROM_SIZE + 512 && (isdigit(ext[0]) && ext[1] == 0 && ext[0] < '9'))
+		if (ptr - buffer < CMemory::MAX_ROM_SIZE + 512 && (isdigit(ext[0]) && ext[1] == 0 && ext[0] < '9'))
 		{
 			more = TRUE;
 			ext[0]++;
 		}
 		else
-		if (ptr - Memory.ROM < CMemory::MAX_ROM_SIZE + 512)
+		if (ptr - buffer < CMemory::MAX_ROM_SIZE + 512)
 		{
 			if (ext == tmp)
 				len = strlen(filename);
@@ -26,6 +26,13 @@
 #include <ctype.h>
 #include <sys/stat.h>
 
+#if defined(__linux__) || defined(__APPLE__) || defined(__FreeBSD__) || defined(__OpenBSD__) || defined(__NetBSD__)
+#define LAZY_MMAP
+#include <sys/mman.h>
+#include <unistd.h>
+#include <fcntl.h>
+#endif
+
 #include "memmap.h"
 #include "apu/apu.h"
 #include "fxemu.h"
@@ -36,6 +43,7 @@
 #include "movie.h"
 #include "display.h"
 #include "sha256.h"
+#include "checksum.h"
 #include "snapshot.h"
 
 #ifndef SET_UI_COLOR
@@ -50,7 +58,7 @@
 #define min(a, b) (((a) < (b)) ? (a) : (b))
 #endif
 
-static bool8	stopMovie = TRUE;
+S9X_INSTANCE_STATIC bool8	stopMovie = TRUE;
 
 // from NSRT
 static const char	*nintendo_licensees[] =
@@ -723,65 +731,17 @@ static const char	*nintendo_licensees[] =
 	"Yojigen"
 };
 
-static const uint32	crc32Table[256] =
-{
-	0x00000000, 0x77073096, 0xee0e612c, 0x990951ba, 0x076dc419, 0x706af48f,
-	0xe963a535, 0x9e6495a3, 0x0edb8832, 0x79dcb8a4, 0xe0d5e91e, 0x97d2d988,
-	0x09b64c2b, 0x7eb17cbd, 0xe7b82d07, 0x90bf1d91, 0x1db71064, 0x6ab020f2,
-	0xf3b97148, 0x84be41de, 0x1adad47d, 0x6ddde4eb, 0xf4d4b551, 0x83d385c7,
-	0x136c9856, 0x646ba8c0, 0xfd62f97a, 0x8a65c9ec, 0x14015c4f, 0x63066cd9,
-	0xfa0f3d63, 0x8d080df5, 0x3b6e20c8, 0x4c69105e, 0xd56041e4, 0xa2677172,
-	0x3c03e4d1, 0x4b04d447, 0xd20d85fd, 0xa50ab56b, 0x35b5a8fa, 0x42b2986c,
-	0xdbbbc9d6, 0xacbcf940, 0x32d86ce3, 0x45df5c75, 0xdcd60dcf, 0xabd13d59,
-	0x26d930ac, 0x51de003a, 0xc8d75180, 0xbfd06116, 0x21b4f4b5, 0x56b3c423,
-	0xcfba9599, 0xb8bda50f, 0x2802b89e, 0x5f058808, 0xc60cd9b2, 0xb10be924,
-	0x2f6f7c87, 0x58684c11, 0xc1611dab, 0xb6662d3d, 0x76dc4190, 0x01db7106,
-	0x98d220bc, 0xefd5102a, 0x71b18589, 0x06b6b51f, 0x9fbfe4a5, 0xe8b8d433,
-	0x7807c9a2, 0x0f00f934, 0x9609a88e, 0xe10e9818, 0x7f6a0dbb, 0x086d3d2d,
-	0x91646c97, 0xe6635c01, 0x6b6b51f4, 0x1c6c6162, 0x856530d8, 0xf262004e,
-	0x6c0695ed, 0x1b01a57b, 0x8208f4c1, 0xf50fc457, 0x65b0d9c6, 0x12b7e950,
-	0x8bbeb8ea, 0xfcb9887c, 0x62dd1ddf, 0x15da2d49, 0x8cd37cf3, 0xfbd44c65,
-	0x4db26158, 0x3ab551ce, 0xa3bc0074, 0xd4bb30e2, 0x4adfa541, 0x3dd895d7,
-	0xa4d1c46d, 0xd3d6f4fb, 0x4369e96a, 0x346ed9fc, 0xad678846, 0xda60b8d0,
-	0x44042d73, 0x33031de5, 0xaa0a4c5f, 0xdd0d7cc9, 0x5005713c, 0x270241aa,
-	0xbe0b1010, 0xc90c2086, 0x5768b525, 0x206f85b3, 0xb966d409, 0xce61e49f,
-	0x5edef90e, 0x29d9c998, 0xb0d09822, 0xc7d7a8b4, 0x59b33d17, 0x2eb40d81,
-	0xb7bd5c3b, 0xc0ba6cad, 0xedb88320, 0x9abfb3b6, 0x03b6e20c, 0x74b1d29a,
-	0xead54739, 0x9dd277af, 0x04db2615, 0x73dc1683, 0xe3630b12, 0x94643b84,
-	0x0d6d6a3e, 0x7a6a5aa8, 0xe40ecf0b, 0x9309ff9d, 0x0a00ae27, 0x7d079eb1,
-	0xf00f9344, 0x8708a3d2, 0x1e01f268, 0x6906c2fe, 0xf762575d, 0x806567cb,
-	0x196c3671, 0x6e6b06e7, 0xfed41b76, 0x89d32be0, 0x10da7a5a, 0x67dd4acc,
-	0xf9b9df6f, 0x8ebeeff9, 0x17b7be43, 0x60b08ed5, 0xd6d6a3e8, 0xa1d1937e,
-	0x38d8c2c4, 0x4fdff252, 0xd1bb67f1, 0xa6bc5767, 0x3fb506dd, 0x48b2364b,
-	0xd80d2bda, 0xaf0a1b4c, 0x36034af6, 0x41047a60, 0xdf60efc3, 0xa867df55,
-	0x316e8eef, 0x4669be79, 0xcb61b38c, 0xbc66831a, 0x256fd2a0, 0x5268e236,
-	0xcc0c7795, 0xbb0b4703, 0x220216b9, 0x5505262f, 0xc5ba3bbe, 0xb2bd0b28,
-	0x2bb45a92, 0x5cb36a04, 0xc2d7ffa7, 0xb5d0cf31, 0x2cd99e8b, 0x5bdeae1d,
-	0x9b64c2b0, 0xec63f226, 0x756aa39c, 0x026d930a, 0x9c0906a9, 0xeb0e363f,
-	0x72076785, 0x05005713, 0x95bf4a82, 0xe2b87a14, 0x7bb12bae, 0x0cb61b38,
-	0x92d28e9b, 0xe5d5be0d, 0x7cdcefb7, 0x0bdbdf21, 0x86d3d2d4, 0xf1d4e242,
-	0x68ddb3f8, 0x1fda836e, 0x81be16cd, 0xf6b9265b, 0x6fb077e1, 0x18b74777,
-	0x88085ae6, 0xff0f6a70, 0x66063bca, 0x11010b5c, 0x8f659eff, 0xf862ae69,
-	0x616bffd3, 0x166ccf45, 0xa00ae278, 0xd70dd2ee, 0x4e048354, 0x3903b3c2,
-	0xa7672661, 0xd06016f7, 0x4969474d, 0x3e6e77db, 0xaed16a4a, 0xd9d65adc,
-	0x40df0b66, 0x37d83bf0, 0xa9bcae53, 0xdebb9ec5, 0x47b2cf7f, 0x30b5ffe9,
-	0xbdbdf21c, 0xcabac28a, 0x53b39330, 0x24b4a3a6, 0xbad03605, 0xcdd70693,
-	0x54de5729, 0x23d967bf, 0xb3667a2e, 0xc4614ab8, 0x5d681b02, 0x2a6f2b94,
-	0xb40bbe37, 0xc30c8ea1, 0x5a05df1b, 0x2d02ef8d
-};
-
 static void S9xDeinterleaveType1 (int, uint8 *);
 static void S9xDeinterleaveType2 (int, uint8 *);
 static void S9xDeinterleaveGD24 (int, uint8 *);
 static bool8 allASCII (uint8 *, int);
 static bool8 is_SufamiTurbo_BIOS (const uint8 *, uint32);
 static bool8 is_SufamiTurbo_Cart (const uint8 *, uint32);
-static bool8 is_BSCart_BIOS (const uint8 *, uint32);
+static bool8 is_BSCart_BIOS (const uint8 *, uint32, CMemory &mem = Memory);
 static bool8 is_BSCartSA1_BIOS(const uint8 *, uint32);
 static bool8 is_GNEXT_Add_On (const uint8 *, uint32);
-static uint32 caCRC32 (uint8 *, uint32, uint32 crc32 = 0xffffffff);
 static bool8 ReadUPSPatch (Stream *, long, int32 &);
-static long ReadInt (Stream *, unsigned);
+static long ReadInt (const uint8 *&, const uint8 *, unsigned);
 static bool8 ReadIPSPatch (Stream *, long, int32 &);
 #ifdef UNZIP_SUPPORT
 static int unzFindExtension (unzFile &, const char *, bool restart = TRUE, bool print = TRUE, bool allowExact = FALSE);
@@ -893,15 +853,114 @@ static void S9xDeinterleaveGD24 (int size, uint8 *base)
 
 // allocation and deallocation
 
+// The big buffers are reserved in full but only take memory once they are
+// written to, so that an instance costs what its game actually uses rather
+// than what the largest cartridge could. They read as zeroes until then.
+
+uint8 * S9xAllocLazy (size_t size)
+{
+#if defined(LAZY_MMAP)
+	void	*p = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANON, -1, 0);
+	return (p == MAP_FAILED ? NULL : (uint8 *) p);
+#elif defined(__WIN32__)
+	return ((uint8 *) VirtualAlloc(NULL, size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE));
+#else
+	return ((uint8 *) calloc(size, 1));
+#endif
+}
+
+void S9xFreeLazy (uint8 *p, size_t size)
+{
+	if (!p)
+		return;
+
+#if defined(LAZY_MMAP)
+	munmap(p, size);
+#elif defined(__WIN32__)
+	VirtualFree(p, 0, MEM_RELEASE);
+#else
+	free(p);
+#endif
+}
+
+// Zeroes a part of a buffer from S9xAllocLazy, handing the whole pages in it
+// back to the system.
+void S9xClearLazy (uint8 *p, size_t size)
+{
+#if defined(LAZY_MMAP)
+	size_t	page  = (size_t) sysconf(_SC_PAGESIZE);
+	uint8	*start = (uint8 *) (((uintptr_t) p + page - 1) & ~(uintptr_t) (page - 1));
+	uint8	*end   = (uint8 *) (((uintptr_t) p + size) & ~(uintptr_t) (page - 1));
+
+	if (start < end &&
+		mmap(start, end - start, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANON | MAP_FIXED, -1, 0) != MAP_FAILED)
+	{
+		memset(p, 0, start - p);
+		memset(end, 0, p + size - end);
+		return;
+	}
+#endif
+
+	memset(p, 0, size);
+}
+
+// How much of a buffer is currently backed by memory.
+size_t S9xResidentBytes (const void *p, size_t size)
+{
+	if (!p)
+		return (0);
+
+#if defined(__linux__)
+	size_t	page  = (size_t) sysconf(_SC_PAGESIZE);
+	uint8	*start = (uint8 *) ((uintptr_t) p & ~(uintptr_t) (page - 1));
+	size_t	pages = ((uint8 *) p + size - start + page - 1) / page;
+	size_t	resident = 0;
+	unsigned char	vec[256];
+
+	for (size_t i = 0; i < pages; i += sizeof(vec))
+	{
+		size_t	n = min(pages - i, sizeof(vec));
+
+		if (mincore(start + i * page, n * page, vec) != 0)
+			return (size);
+
+		for (size_t j = 0; j < n; j++)
+			resident += vec[j] & 1;
+	}
+
+	return (min(resident * page, size));
+#else
+	return (size);
+#endif
+}
+
+static size_t TileCacheSize (int depth)
+{
+	switch (depth)
+	{
+		case TILE_8BIT:
+			return (MAX_8BIT_TILES);
+
+		case TILE_4BIT:
+		case TILE_4BIT_EVEN:
+		case TILE_4BIT_ODD:
+			return (MAX_4BIT_TILES);
+
+		default:
+			return (MAX_2BIT_TILES);
+	}
+}
+
 bool8 CMemory::Init (void)
 {
-	IPPU.TileCache[TILE_2BIT]       = (uint8 *) malloc(MAX_2BIT_TILES * 64);
-	IPPU.TileCache[TILE_4BIT]       = (uint8 *) malloc(MAX_4BIT_TILES * 64);
-	IPPU.TileCache[TILE_8BIT]       = (uint8 *) malloc(MAX_8BIT_TILES * 64);
-	IPPU.TileCache[TILE_2BIT_EVEN]  = (uint8 *) malloc(MAX_2BIT_TILES * 64);
-	IPPU.TileCache[TILE_2BIT_ODD]   = (uint8 *) malloc(MAX_2BIT_TILES * 64);
-	IPPU.TileCache[TILE_4BIT_EVEN]  = (uint8 *) malloc(MAX_4BIT_TILES * 64);
-	IPPU.TileCache[TILE_4BIT_ODD]   = (uint8 *) malloc(MAX_4BIT_TILES * 64);
+	// Most games never use some of the depths, whose caches then cost nothing.
+	IPPU.TileCache[TILE_2BIT]       = S9xAllocLazy(MAX_2BIT_TILES * 64);
+	IPPU.TileCache[TILE_4BIT]       = S9xAllocLazy(MAX_4BIT_TILES * 64);
+	IPPU.TileCache[TILE_8BIT]       = S9xAllocLazy(MAX_8BIT_TILES * 64);
+	IPPU.TileCache[TILE_2BIT_EVEN]  = S9xAllocLazy(MAX_2BIT_TILES * 64);
+	IPPU.TileCache[TILE_2BIT_ODD]   = S9xAllocLazy(MAX_2BIT_TILES * 64);
+	IPPU.TileCache[TILE_4BIT_EVEN]  = S9xAllocLazy(MAX_4BIT_TILES * 64);
+	IPPU.TileCache[TILE_4BIT_ODD]   = S9xAllocLazy(MAX_4BIT_TILES * 64);
 
 	IPPU.TileCached[TILE_2BIT]      = (uint8 *) malloc(MAX_2BIT_TILES);
 	IPPU.TileCached[TILE_4BIT]      = (uint8 *) malloc(MAX_4BIT_TILES);
@@ -930,22 +989,20 @@ bool8 CMemory::Init (void)
 		return (FALSE);
     }
 
-	ROMStorage.resize(MAX_ROM_SIZE + 0x200 + 0x8000);
-	std::fill(ROMStorage.begin(), ROMStorage.end(), 0);
-	SRAMStorage.resize(SRAM_SIZE);
-	std::fill(SRAMStorage.begin(), SRAMStorage.end(), 0);
-	SRAM = &SRAMStorage[0];
+	ROMStorage  = S9xAllocLazy(ROM_STORAGE_SIZE);
+	SRAMStorage = S9xAllocLazy(SRAM_SIZE);
+
+	if (!ROMStorage || !SRAMStorage)
+	{
+		Deinit();
+		return (FALSE);
+	}
+
+	SRAM = SRAMStorage;
+	SRAMExtent = SRAM_SIZE;
 	memset(RAM, 0,  sizeof(RAM));
 	memset(VRAM, 0, sizeof(VRAM));
 
-	memset(IPPU.TileCache[TILE_2BIT], 0,       MAX_2BIT_TILES * 64);
-	memset(IPPU.TileCache[TILE_4BIT], 0,       MAX_4BIT_TILES * 64);
-	memset(IPPU.TileCache[TILE_8BIT], 0,       MAX_8BIT_TILES * 64);
-	memset(IPPU.TileCache[TILE_2BIT_EVEN], 0,  MAX_2BIT_TILES * 64);
-	memset(IPPU.TileCache[TILE_2BIT_ODD], 0,   MAX_2BIT_TILES * 64);
-	memset(IPPU.TileCache[TILE_4BIT_EVEN], 0,  MAX_4BIT_TILES * 64);
-	memset(IPPU.TileCache[TILE_4BIT_ODD], 0,   MAX_4BIT_TILES * 64);
-
 	memset(IPPU.TileCached[TILE_2BIT], 0,      MAX_2BIT_TILES);
 	memset(IPPU.TileCached[TILE_4BIT], 0,      MAX_4BIT_TILES);
 	memset(IPPU.TileCached[TILE_8BIT], 0,      MAX_8BIT_TILES);
@@ -957,12 +1014,12 @@ bool8 CMemory::Init (void)
 	// FillRAM uses first 32K of ROM image area, otherwise space just
 	// wasted. Might be read by the SuperFX code.
 
-	FillRAM = &ROMStorage[0];
+	FillRAM = ROMStorage;
 
 	// Add 0x8000 to ROM image pointer to stop SuperFX code accessing
 	// unallocated memory (can cause crash on some ports).
 
-	ROM = &ROMStorage[0x8000];
+	ROM = ROMStorage + 0x8000;
 
 	C4RAM   = ROM + 0x400000 + 8192 * 8; // C4
 	OBC1RAM = ROM + 0x400000; // OBC1
@@ -988,7 +1045,7 @@ void CMemory::Deinit (void)
 	{
 		if (IPPU.TileCache[t])
 		{
-			free(IPPU.TileCache[t]);
+			S9xFreeLazy(IPPU.TileCache[t], TileCacheSize(t) * 64);
 			IPPU.TileCache[t] = NULL;
 		}
 
@@ -999,12 +1056,29 @@ void CMemory::Deinit (void)
 		}
 	}
 
-    ROMStorage.clear();
-    ROMStorage.shrink_to_fit();
-    SRAMStorage.clear();
-    SRAMStorage.shrink_to_fit();
-    ROM = NULL;
-    SRAM = NULL;
+	S9xFreeLazy(ROMStorage, ROM_STORAGE_SIZE);
+	S9xFreeLazy(SRAMStorage, SRAM_SIZE);
+	ROMStorage = NULL;
+	SRAMStorage = NULL;
+	FillRAM = NULL;
+	ROM = NULL;
+	SRAM = NULL;
+}
+
+size_t CMemory::ResidentBytes (void)
+{
+	size_t	bytes = sizeof(CMemory);
+
+	if (ROMStorage)
+		bytes += S9xResidentBytes(ROMStorage, ROM_STORAGE_SIZE) + S9xResidentBytes(SRAMStorage, SRAM_SIZE);
+
+	for (int t = 0; t < 7; t++)
+	{
+		if (IPPU.TileCache[t])
+			bytes += S9xResidentBytes(IPPU.TileCache[t], TileCacheSize(t) * 64) + TileCacheSize(t);
+	}
+
+	return (bytes);
 }
 
 // file management and ROM detection
@@ -1038,19 +1112,19 @@ static bool8 is_SufamiTurbo_Cart (const uint8 *data, uint32 size)
 		return (FALSE);
 }
 
-static bool8 is_BSCart_BIOS(const uint8 *data, uint32 size)
+static bool8 is_BSCart_BIOS(const uint8 *data, uint32 size, CMemory &mem)
 {
 	if ((data[0x7FB2] == 0x5A) && (data[0x7FB5] != 0x20) && (data[0x7FDA] == 0x33))
 	{
-		Memory.LoROM = TRUE;
-		Memory.HiROM = FALSE;
+		mem.LoROM = TRUE;
+		mem.HiROM = FALSE;
 
 		return (TRUE);
 	}
 	else if ((data[0xFFB2] == 0x5A) && (data[0xFFB5] != 0x20) && (data[0xFFDA] == 0x33))
 	{
-		Memory.LoROM = FALSE;
-		Memory.HiROM = TRUE;
+		mem.LoROM = FALSE;
+		mem.HiROM = TRUE;
 
 		return (TRUE);
 	}
@@ -1193,34 +1267,89 @@ int CMemory::First512BytesCountZeroes() const
 	return zeroCount;
 }
 
-uint32 CMemory::HeaderRemove (uint32 size, uint8 *buf)
+// Size of the copier header a file of this size has, if any.
+uint32 CMemory::HeaderSize (uint32 size)
 {
-	uint32	calc_size = (size / 0x2000) * 0x2000;
+	if (size < 512)
+		return (0);
 
-	if ((size - calc_size == 512 && !Settings.ForceNoHeader) || Settings.ForceHeader)
-	{
-		uint8	*NSRTHead = buf + 0x1D0; // NSRT Header Location
+	if ((size % 0x2000 == 512 && !Settings.ForceNoHeader) || Settings.ForceHeader)
+		return (512);
 
-		// detect NSRT header
-		if (!strncmp("NSRT", (char *) &NSRTHead[24], 4))
+	return (0);
+}
+
+// Keeps what is useful of a copier header the caller is dropping.
+void CMemory::HeaderSkip (const uint8 *header)
+{
+	const uint8	*NSRTHead = header + 0x1D0; // NSRT Header Location
+
+	// detect NSRT header
+	if (!strncmp("NSRT", (const char *) &NSRTHead[24], 4))
+	{
+		if (NSRTHead[28] == 22)
 		{
-			if (NSRTHead[28] == 22)
-			{
-				if (((std::accumulate(NSRTHead, NSRTHead + sizeof(NSRTHeader), 0) & 0xFF) == NSRTHead[30]) &&
-					(NSRTHead[30] + NSRTHead[31] == 255) && ((NSRTHead[0] & 0x0F) <= 13) &&
-					(((NSRTHead[0] & 0xF0) >> 4) <= 3) && ((NSRTHead[0] & 0xF0) >> 4))
-					memcpy(NSRTHeader, NSRTHead, sizeof(NSRTHeader));
-			}
+			if (((std::accumulate(NSRTHead, NSRTHead + sizeof(NSRTHeader), 0) & 0xFF) == NSRTHead[30]) &&
+				(NSRTHead[30] + NSRTHead[31] == 255) && ((NSRTHead[0] & 0x0F) <= 13) &&
+				(((NSRTHead[0] & 0xF0) >> 4) <= 3) && ((NSRTHead[0] & 0xF0) >> 4))
+				memcpy(NSRTHeader, NSRTHead, sizeof(NSRTHeader));
 		}
+	}
 
-		memmove(buf, buf + 512, calc_size);
-		HeaderCount++;
+	HeaderCount++;
+}
+
+uint32 CMemory::HeaderRemove (uint32 size, uint8 *buf)
+{
+	if (HeaderSize(size))
+	{
+		HeaderSkip(buf);
+		memmove(buf, buf + 512, (size / 0x2000) * 0x2000);
 		size -= 512;
 	}
 
 	return (size);
 }
 
+#ifdef LAZY_MMAP
+// Maps a plain ROM file, one that is neither compressed nor headered, over
+// the page-aligned buffer instead of reading it. The mapping is private:
+// pages that are never written stay shared with the page cache, and so with
+// every other instance running the same game, while deinterleaving, patches
+// and ROM fixes only copy the pages they touch. Returns 0 if the file has to
+// be read the usual way.
+static uint32 MapROMFile (uint8 *buffer, const char *filename, uint32 maxsize)
+{
+	size_t		page = (size_t) sysconf(_SC_PAGESIZE);
+	struct stat	st;
+	uint8		magic[2];
+	uint32		size = 0;
+
+	if ((uintptr_t) buffer & (page - 1))
+		return (0);
+
+	int	fd = open(filename, O_RDONLY);
+	if (fd < 0)
+		return (0);
+
+	if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0 && st.st_size <= (off_t) maxsize &&
+		!((st.st_size % 0x2000 == 512 && !Settings.ForceNoHeader) || Settings.ForceHeader) &&
+		pread(fd, magic, 2, 0) == 2 && !(magic[0] == 0x1f && magic[1] == 0x8b)) // gzip
+	{
+		size_t	len = ((size_t) st.st_size + page - 1) & ~(page - 1);
+
+		if (mmap(buffer, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED, fd, 0) != MAP_FAILED)
+			size = (uint32) st.st_size;
+		else
+			S9xClearLazy(buffer, len); // a failed MAP_FIXED may have unmapped it
+	}
+
+	close(fd);
+
+	return (size);
+}
+#endif
+
 uint32 CMemory::FileLoader (uint8 *buffer, const char *filename, uint32 maxsize)
 {
 	// <- ROM size without header
@@ -1244,7 +1373,7 @@ uint32 CMemory::FileLoader (uint8 *buffer, const char *filename, uint32 maxsize)
 		case FILE_ZIP:
 		{
 		#ifdef UNZIP_SUPPORT
-			if (!LoadZip(filename, &totalSize, buffer))
+			if (!LoadZip(filename, &totalSize, buffer, *this))
 			{
 			 	S9xMessage(S9X_ERROR, S9X_ROM_INFO, "Invalid Zip archive.");
 				return (0);
@@ -1281,6 +1410,17 @@ uint32 CMemory::FileLoader (uint8 *buffer, const char *filename, uint32 maxsize)
 		case FILE_DEFAULT:
 		default:
 		{
+		#ifdef LAZY_MMAP
+			// Only when asked for, as the game then breaks if the file is
+			// changed while it runs. With cartridge B already loaded, what
+			// lies past the end of this file has to stay as it is.
+			if (Settings.MapROMFile && buffer == ROM && !Multi.cartSizeB && (totalSize = MapROMFile(buffer, filename, maxsize)))
+			{
+				ROMFilename = filename;
+				break;
+			}
+		#endif
+
 			STREAM	fp = OPEN_STREAM(filename, "rb");
 			if (!fp)
 				return (0);
@@ -1320,7 +1460,7 @@ bool8 CMemory::LoadROMMem (const uint8 *source, uint32 sourceSize, const char* o
 
     do
     {
-        memset(ROM,0, MAX_ROM_SIZE);
+        S9xClearLazy(ROM, MAX_ROM_SIZE);
         memset(&Multi, 0,sizeof(Multi));
         memcpy(ROM,source,sourceSize);
     }
@@ -1340,7 +1480,7 @@ bool8 CMemory::LoadROM (const char *filename)
 
     do
     {
-        memset(ROM,0, MAX_ROM_SIZE);
+        S9xClearLazy(ROM, MAX_ROM_SIZE);
         memset(&Multi, 0,sizeof(Multi));
         totalFileSize = FileLoader(ROM, filename, MAX_ROM_SIZE);
 
@@ -1354,15 +1494,17 @@ bool8 CMemory::LoadROM (const char *filename)
     return TRUE;
 }
 
-bool8 CMemory::LoadROMInt (int32 ROMfillSize)
+// Finds the game's header, the part of working out its layout that
+// LoadROMInt and IdentifyROM share. A copier header the scores point to is
+// dropped from ROM and ROMfillSize, CalculatedSize and ExtendedFormat are
+// set, and hi_score and lo_score are left for the header that is returned.
+// When loading, a type 1 interleaved LoROM is also put in order first;
+// IdentifyROM leaves the image as it is.
+uint8 * CMemory::FindROMHeader (int32 &ROMfillSize, int &hi_score, int &lo_score, bool8 loading)
 {
-	Settings.DisplayColor = BUILD_PIXEL(31, 31, 31);
-	SET_UI_COLOR(255, 255, 255);
-
 	CalculatedSize = 0;
 	ExtendedFormat = NOPE;
 
-	int	hi_score, lo_score;
 	int score_headered;
 	int score_nonheadered;
 
@@ -1381,10 +1523,8 @@ bool8 CMemory::LoadROMInt (int32 ROMfillSize)
 	{
 		memmove(ROM, ROM + 512, ROMfillSize - 512);
 		ROMfillSize -= 512;
-		S9xMessage(S9X_INFO, S9X_HEADER_WARNING, "Try 'force no-header' option if the game doesn't work");
-		// modifying ROM, so we need to rescore
-		hi_score = ScoreHiROM(FALSE);
-		lo_score = ScoreLoROM(FALSE);
+		if (loading)
+			S9xMessage(S9X_INFO, S9X_HEADER_WARNING, "Try 'force no-header' option if the game doesn't work");
 	}
 
 	CalculatedSize = ((ROMfillSize + 0x1fff) / 0x2000) * 0x2000;
@@ -1403,7 +1543,7 @@ bool8 CMemory::LoadROMInt (int32 ROMfillSize)
 		ExtendedFormat = YEAH;
 
 	// if both vectors are invalid, it's type 1 interleaved LoROM
-	if (ExtendedFormat == NOPE &&
+	if (loading && ExtendedFormat == NOPE &&
 		((ROM[0x7ffc] + (ROM[0x7ffd] << 8)) < 0x8000) &&
 		((ROM[0xfffc] + (ROM[0xfffd] << 8)) < 0x8000))
 	{
@@ -1436,10 +1576,13 @@ bool8 CMemory::LoadROMInt (int32 ROMfillSize)
 			ExtendedFormat = SMALLFIRST;
 	}
 
-	bool8	interleaved, tales = FALSE;
-
-    interleaved = Settings.ForceInterleaved || Settings.ForceInterleaved2 || Settings.ForceInterleaveGD24;
+	return (RomHeader);
+}
 
+// Picks LoROM or HiROM from the scores and the settings. The map type byte
+// in the header also tells whether the image is interleaved.
+void CMemory::ChooseROMMap (uint8 *RomHeader, int hi_score, int lo_score, bool8 &interleaved, bool8 &tales)
+{
 	if (Settings.ForceLoROM || (!Settings.ForceHiROM && lo_score >= hi_score))
 	{
 		LoROM = TRUE;
@@ -1490,6 +1633,21 @@ bool8 CMemory::LoadROMInt (int32 ROMfillSize)
 			tales = FALSE;
 		}
 	}
+}
+
+bool8 CMemory::LoadROMInt (int32 ROMfillSize)
+{
+	Settings.DisplayColor = BUILD_PIXEL(31, 31, 31);
+	SET_UI_COLOR(255, 255, 255);
+
+	int		hi_score, lo_score;
+	uint8	*RomHeader = FindROMHeader(ROMfillSize, hi_score, lo_score, TRUE);
+
+	bool8	interleaved, tales = FALSE;
+
+    interleaved = Settings.ForceInterleaved || Settings.ForceInterleaved2 || Settings.ForceInterleaveGD24;
+
+	ChooseROMMap(RomHeader, hi_score, lo_score, interleaved, tales);
 
 	if (!Settings.ForceNotInterleaved && interleaved)
 	{
@@ -1570,12 +1728,65 @@ bool8 CMemory::LoadROMInt (int32 ROMfillSize)
     return (TRUE);
 }
 
+// Works out what the image in ROM is, the way LoadROMInt would, without
+// loading it: the header is found and parsed but nothing is deinterleaved,
+// mapped or reset, and neither Settings nor the running game are touched.
+// This lets the ROM scanner examine many images at once, each on a CMemory
+// of its own. ROMfillSize is the size once any copier header is removed.
+// Returns what kind of cartridge this is.
+const char * CMemory::IdentifyROM (uint32 ROMfillSize)
+{
+	CalculatedSize = 0;
+	ExtendedFormat = NOPE;
+	CompanyId = -1;
+	memset(ROMId, 0, 5);
+
+	if (is_SufamiTurbo_BIOS(ROM, ROMfillSize) || is_SufamiTurbo_Cart(ROM, ROMfillSize))
+	{
+		CalculatedSize = ROMfillSize;
+		LoROM = TRUE;
+		HiROM = FALSE;
+		memset(ROMName, 0, ROM_NAME_LEN);
+		strncpy(ROMName, (char *) ROM, 14);
+		return (is_SufamiTurbo_BIOS(ROM, ROMfillSize) ? "Sufami Turbo BIOS" : "Sufami Turbo");
+	}
+
+	int32	size = ROMfillSize;
+	int		hi_score, lo_score;
+	bool8	interleaved = FALSE, tales = FALSE;
+	uint8	*RomHeader = FindROMHeader(size, hi_score, lo_score, FALSE);
+
+	if ((uint32) size != ROMfillSize)
+	{
+		ROMfillSize = size;
+		HeaderCount++;
+	}
+
+	ChooseROMMap(RomHeader, hi_score, lo_score, interleaved, tales);
+
+	const char	*kind = "Game";
+	if (is_BSCart_BIOS(ROM, ROMfillSize, *this))
+		kind = "BS-X slotted";
+
+	memset(ROMName, 0, ROM_NAME_LEN);
+	ParseSNESHeader(RomHeader + (HiROM ? 0xFFB0 : 0x7FB0), FALSE);
+
+	char	*p = ROMName + strlen(ROMName);
+	if (p > ROMName + 21 && ROMName[20] == ' ')
+		p = ROMName + 21;
+	while (p > ROMName && *(p - 1) == ' ')
+		p--;
+	*p = 0;
+
+	return (kind);
+}
+
 bool8 CMemory::LoadMultiCartMem (const uint8 *sourceA, uint32 sourceASize,
                                  const uint8 *sourceB, uint32 sourceBSize,
                                  const uint8 *bios, uint32 biosSize)
 {
     uint32 offset = 0;
-    memset(ROM, 0, MAX_ROM_SIZE);
+    S9xClearLazy(ROM, MAX_ROM_SIZE);
 	memset(&Multi, 0, sizeof(Multi));
 
     if(bios) {
@@ -1609,7 +1820,7 @@ bool8 CMemory::LoadMultiCart (const char *cartA, const char *cartB)
 {
     S9xResetSaveTimer(FALSE); // reset oops timer here so that .oops file has rom name of previous rom
 
-    memset(ROM, 0, MAX_ROM_SIZE);
+    S9xClearLazy(ROM, MAX_ROM_SIZE);
 	memset(&Multi, 0, sizeof(Multi));
 
 	Settings.DisplayColor = BUILD_PIXEL(31, 31, 31);
@@ -1849,8 +2060,9 @@ void CMemory::ClearSRAM (bool8 onlyNonSavedSRAM)
 	if (onlyNonSavedSRAM)
 		if (!(Settings.SuperFX && ROMType < 0x15) && !(Settings.SA1 && ROMType == 0x34)) // can have SRAM
 			return;
-	// TODO: If SRAM size changes change this value as well
-	memset(SRAM, SNESGameFixes.SRAMInitialValue, 0x80000);
+	// The part the cartridge can't reach is given back rather than filled.
+	memset(SRAM, SNESGameFixes.SRAMInitialValue, SRAMExtent);
+	S9xClearLazy(SRAM + SRAMExtent, SRAM_SIZE - SRAMExtent);
 }
 
 bool8 CMemory::LoadSRAM (const char *filename)
@@ -2001,18 +2213,13 @@ bool8 CMemory::SaveMPAK (const char *filename)
 
 // initialization
 
-static uint32 caCRC32 (uint8 *array, uint32 size, uint32 crc32)
+void CMemory::ParseSNESHeader (uint8 *RomHeader)
 {
-	for (uint32 i = 0; i < size; i++)
-		crc32 = ((crc32 >> 8) & 0x00FFFFFF) ^ crc32Table[(crc32 ^ array[i]) & 0xFF];
-
-	return (~crc32);
+	ParseSNESHeader(RomHeader, Settings.BS & !Settings.BSXItself);
 }
 
-void CMemory::ParseSNESHeader (uint8 *RomHeader)
+void CMemory::ParseSNESHeader (uint8 *RomHeader, bool8 bs)
 {
-	bool8	bs = Settings.BS & !Settings.BSXItself;
-
 	strncpy(ROMName, (char *) &RomHeader[0x10], ROM_NAME_LEN - 1);
 	if (bs)
 		memset(ROMName + 16, 0x20, ROM_NAME_LEN - 17);
@@ -2384,6 +2591,8 @@ void CMemory::InitROM (void)
 
 	// SRAM size
 	SRAMMask = SRAMSize ? ((1 << (SRAMSize + 3)) * 128) - 1 : 0;
+	if (!SRAMExtent)
+		SRAMExtent = min(SRAMMask + 1, (uint32) SRAM_SIZE);
 
 	// checksum
 	if (!isChecksumOK || ((uint32) CalculatedSize > (uint32) (((1 << (ROMSize - 7)) * 128) * 1024)))
@@ -2719,6 +2928,8 @@ void CMemory::map_WriteProtectROM (void)
 
 void CMemory::Map_Initialize (void)
 {
+	SRAMExtent = SRAM_SIZE;
+
 	for (int c = 0; c < 0x1000; c++)
 	{
 		Map[c]      = (uint8 *) MAP_NONE;
@@ -2751,6 +2962,9 @@ void CMemory::Map_LoROMMap (void)
 		map_SetaRISC();
 
     map_LoROMSRAM();
+	// reached only through SRAMMask, unless the ST018 writes to it
+	if (Settings.SETA != ST_018)
+		SRAMExtent = 0;
 	map_WRAM();
 
 	map_WriteProtectROM();
@@ -3091,6 +3305,7 @@ void CMemory::Map_HiROMMap (void)
 		map_DSP();
 
 	map_HiROMSRAM();
+	SRAMExtent = 0; // reached only through SRAMMask
 	map_WRAM();
 
 	map_WriteProtectROM();
@@ -3271,7 +3486,7 @@ const char * CMemory::MapType (void)
 
 const char * CMemory::StaticRAMSize (void)
 {
-	static char	str[20];
+	S9X_INSTANCE_STATIC char	str[20];
 
 	if (SRAMSize > 16)
 		strcpy(str, "Corrupt");
@@ -3283,7 +3498,7 @@ const char * CMemory::StaticRAMSize (void)
 
 const char * CMemory::Size (void)
 {
-	static char	str[20];
+	S9X_INSTANCE_STATIC char	str[20];
 
 	if (Multi.cartType == 4)
 		strcpy(str, "N/A");
@@ -3297,7 +3512,7 @@ const char * CMemory::Size (void)
 
 const char * CMemory::Revision (void)
 {
-	static char	str[20];
+	S9X_INSTANCE_STATIC char	str[20];
 
 	sprintf(str, "1.%d", HiROM ? ((ExtendedFormat != NOPE) ? ROM[0x40ffdb] : ROM[0xffdb]) : ROM[0x7fdb]);
 
@@ -3306,8 +3521,8 @@ const char * CMemory::Revision (void)
 
 const char * CMemory::KartContents (void)
 {
-	static char			str[64];
-	static const char	*contents[3] = { "ROM", "ROM+RAM", "ROM+RAM+BAT" };
+	S9X_INSTANCE_STATIC char	str[64];
+	static const char			*contents[3] = { "ROM", "ROM+RAM", "ROM+RAM+BAT" };
 
 	char	chip[20];
 
@@ -3580,30 +3795,25 @@ static uint32 XPSdecode (const uint8 *data, unsigned &addr, unsigned size)
 	return offset;
 }
 
+// Patches are small next to the ROM, so they are read whole, in large blocks,
+// and applied from memory. Not every stream knows its size, so this reads
+// until there is nothing left.
 static std::vector<uint8_t> ReadStreamUntilEOF(Stream *r)
 {
-    const size_t max_buffer_size = 4096;
+    const size_t block_size = 0x10000;
     std::vector<uint8_t> data;
-    uint8_t buffer[max_buffer_size];
     size_t total_size = 0;
-    size_t buffer_size = 0;
 
-    int value = 0;
-    while (value != EOF)
+    for (;;)
     {
-        value = r->get_char();
-        if (value != EOF)
-            buffer[buffer_size++] = value;
-
-        if (buffer_size == max_buffer_size || (value == EOF && buffer_size > 0))
-        {
-            data.resize(data.size() + buffer_size);
-            memcpy(&data[total_size], buffer, buffer_size);
-            total_size += buffer_size;
-            buffer_size = 0;
-        }
+        data.resize(total_size + block_size);
+        size_t bytes = r->read(&data[total_size], block_size);
+        if (bytes == 0)
+            break;
+        total_size += bytes;
     }
 
+    data.resize(total_size);
     return data;
 }
 
@@ -3620,7 +3830,7 @@ static bool8 ReadUPSPatch (Stream *r, long, int32 &rom_size)
 {
 	//Reader lacks size() and rewind(), so we need to read in the file to get its size
 	auto data_vector = ReadStreamUntilEOF(r);
-	uint8 *data = &data_vector[0];
+	uint8 *data = data_vector.data();
 	uint32 size = data_vector.size();
 
 	//4-byte header + 1-byte input size + 1-byte output size + 4-byte patch CRC32 + 4-byte unpatched CRC32 + 4-byte patched CRC32
@@ -3644,18 +3854,22 @@ static bool8 ReadUPSPatch (Stream *r, long, int32 &rom_size)
 
 	//fill expanded area with 0x00s; so that XORing works as expected below.
 	//note that this is needed (and works) whether output ROM is larger or smaller than pre-patched ROM
-	for(unsigned i = min((uint32) rom_size, out_size); i < max((uint32) rom_size, out_size); i++) {
-		Memory.ROM[i] = 0x00;
-	}
+	uint32 low = min((uint32) rom_size, out_size), high = max((uint32) rom_size, out_size);
+	memset(Memory.ROM + low, 0, high - low);
 
+	//each hunk is a skip followed by bytes to XOR, up to and including a 0x00
 	uint32 relative = 0;
 	while(addr < size - 12) {
 		relative += XPSdecode(data, addr, size);
-		while(addr < size - 12) {
-			uint8 x = data[addr++];
-			Memory.ROM[relative++] ^= x;
-			if(!x) break;
-		}
+		if(addr > size - 12) return false;  //hunk runs into the checksums
+		uint8 *end = (uint8 *) memchr(data + addr, 0, size - 12 - addr);
+		uint32 length = end ? end - (data + addr) + 1 : size - 12 - addr;
+		if(relative > CMemory::MAX_ROM_SIZE || length > CMemory::MAX_ROM_SIZE - relative) return false;  //hunk runs off the end of Memory.ROM
+		uint8 *rom = Memory.ROM + relative;
+		for(uint32 i = 0; i < length; i++)
+			rom[i] ^= data[addr + i];
+		addr += length;
+		relative += length;
 	}
 
 	rom_size = out_size;
@@ -3690,7 +3904,7 @@ static bool8 ReadUPSPatch (Stream *r, long, int32 &rom_size)
 static bool8 ReadBPSPatch (Stream *r, long, int32 &rom_size)
 {
 	auto data_vector = ReadStreamUntilEOF(r);
-	uint8 *data = &data_vector[0];
+	uint8 *data = data_vector.data();
 	uint32 size = data_vector.size();
 
 	/* 4-byte header + 1-byte input size + 1-byte output size + 1-byte metadata size
@@ -3711,6 +3925,7 @@ static bool8 ReadBPSPatch (Stream *r, long, int32 &rom_size)
 	XPSdecode(data, addr, size);
 	uint32 target_size = XPSdecode(data, addr, size);
 	uint32 metadata_size = XPSdecode(data, addr, size);
+	if(addr > size - 12 || metadata_size > size - 12 - addr) return false;  //metadata runs into the checksums
 	addr += metadata_size;
 
 	if(target_size > CMemory::MAX_ROM_SIZE) return false;  //applying this patch will overflow Memory.ROM buffer
@@ -3719,40 +3934,59 @@ static bool8 ReadBPSPatch (Stream *r, long, int32 &rom_size)
 	uint32 outputOffset = 0, sourceRelativeOffset = 0, targetRelativeOffset = 0;
 
 	std::vector<uint8_t> patched_rom_vector(target_size);
-	uint8 *patched_rom = &patched_rom_vector[0];
-	memset(patched_rom, 0, target_size);
+	uint8 *patched_rom = patched_rom_vector.data();
 
+	//every action is a run of bytes, copied in one go. a malformed patch that
+	//would read or write out of bounds fails instead
 	while(addr < size - 12) {
 		uint32 length = XPSdecode(data, addr, size);
+		if(addr > size - 12) return false;  //action runs into the checksums
 		uint32 mode = length & 3;
 		length = (length >> 2) + 1;
 
+		if(length > target_size - outputOffset) return false;
+		uint8 *out = patched_rom + outputOffset;
+
 		switch((int)mode) {
 			case SourceRead:
-				while(length--) {
-					patched_rom[outputOffset] = Memory.ROM[outputOffset];
-					outputOffset++;
-				}
+				if(outputOffset + length > CMemory::MAX_ROM_SIZE) return false;
+				memcpy(out, Memory.ROM + outputOffset, length);
 				break;
 			case TargetRead:
-				while(length--) patched_rom[outputOffset++] = data[addr++];
+				if(length > size - 12 - addr) return false;
+				memcpy(out, data + addr, length);
+				addr += length;
 				break;
 			case SourceCopy:
 			case TargetCopy:
 				int32 offset = XPSdecode(data, addr, size);
+				if(addr > size - 12) return false;
 				bool negative = offset & 1;
 				offset >>= 1;
 				if(negative) offset = -offset;
 
 				if(mode == SourceCopy) {
 					sourceRelativeOffset += offset;
-					while(length--) patched_rom[outputOffset++] = Memory.ROM[sourceRelativeOffset++];
+					if(sourceRelativeOffset > CMemory::MAX_ROM_SIZE || length > CMemory::MAX_ROM_SIZE - sourceRelativeOffset) return false;
+					memcpy(out, Memory.ROM + sourceRelativeOffset, length);
+					sourceRelativeOffset += length;
 				} else {
 					targetRelativeOffset += offset;
-					while(length--) patched_rom[outputOffset++] = patched_rom[targetRelativeOffset++];
+					if(targetRelativeOffset >= outputOffset) return false;
+					//the source may overlap what is being written, repeating
+					//the last few bytes; copy whole repeats at a time
+					uint8 *in = patched_rom + targetRelativeOffset;
+					for(uint32 done = 0; done < length; ) {
+						uint32 chunk = min(length - done, (uint32) (out + done - (in + done)));
+						memcpy(out + done, in + done, chunk);
+						done += chunk;
+					}
+					targetRelativeOffset += length;
 				}
 				break;
 		}
+
+		outputOffset += length;
 	}
 
 	uint32 out_crc32 = caCRC32(patched_rom, target_size);
@@ -3767,17 +4001,16 @@ static bool8 ReadBPSPatch (Stream *r, long, int32 &rom_size)
 	}
 }
 
-static long ReadInt (Stream *r, unsigned nbytes)
+// Big-endian, as IPS has it; -1 if the patch ends first.
+static long ReadInt (const uint8 *&p, const uint8 *end, unsigned nbytes)
 {
 	long	v = 0;
 
+	if ((size_t) (end - p) < nbytes)
+		return (-1);
+
 	while (nbytes--)
-	{
-		int	c = r->get_char();
-		if (c == EOF)
-			return (-1);
-		v = (v << 8) | (c & 0xFF);
-	}
+		v = (v << 8) | *p++;
 
 	return (v);
 }
@@ -3786,26 +4019,20 @@ static bool8 ReadIPSPatch (Stream *r, long offset, int32 &rom_size)
 {
 	const int32	IPS_EOF = 0x00454F46l;
 	int32		ofs;
-	char		fname[6];
 
-	fname[5] = 0;
-	for (int i = 0; i < 5; i++)
-	{
-		int	c = r->get_char();
-		if (c == EOF)
-			return (0);
-		fname[i] = (char) c;
-	}
+	auto			data_vector = ReadStreamUntilEOF(r);
+	const uint8		*p = data_vector.data();
+	const uint8		*end = p + data_vector.size();
 
-	if (strncmp(fname, "PATCH", 5))
+	if (end - p < 5 || strncmp((const char *) p, "PATCH", 5))
 		return (0);
+	p += 5;
 
 	for (;;)
 	{
 		long	len, rlen;
-		int		rchar;
 
-		ofs = ReadInt(r, 3);
+		ofs = ReadInt(p, end, 3);
 		if (ofs == -1)
 			return (0);
 
@@ -3814,7 +4041,7 @@ static bool8 ReadIPSPatch (Stream *r, long offset, int32 &rom_size)
 
 		ofs -= offset;
 
-		len = ReadInt(r, 2);
+		len = ReadInt(p, end, 2);
 		if (len == -1)
 			return (0);
 
@@ -3823,39 +4050,41 @@ static bool8 ReadIPSPatch (Stream *r, long offset, int32 &rom_size)
 			if (ofs + len > CMemory::MAX_ROM_SIZE)
 				return (0);
 
-			while (len--)
+			// A record cut short still gets what there is of it.
+			if (end - p < len)
 			{
-				rchar = r->get_char();
-				if (rchar == EOF)
-					return (0);
-				Memory.ROM[ofs++] = (uint8) rchar;
+				memcpy(Memory.ROM + ofs, p, end - p);
+				return (0);
 			}
 
+			memcpy(Memory.ROM + ofs, p, len);
+			p += len;
+			ofs += len;
+
 			if (ofs > rom_size)
 				rom_size = ofs;
 		}
 		else
 		{
-			rlen = ReadInt(r, 2);
+			rlen = ReadInt(p, end, 2);
 			if (rlen == -1)
 				return (0);
 
-			rchar = r->get_char();
-			if (rchar == EOF)
+			if (p == end)
 				return (0);
 
 			if (ofs + rlen > CMemory::MAX_ROM_SIZE)
 				return (0);
 
-			while (rlen--)
-				Memory.ROM[ofs++] = (uint8) rchar;
+			memset(Memory.ROM + ofs, *p++, rlen);
+			ofs += rlen;
 
 			if (ofs > rom_size)
 				rom_size = ofs;
 		}
 	}
 
-	ofs = ReadInt(r, 3);
+	ofs = ReadInt(p, end, 3);
 	if (ofs != -1 && ofs - offset < rom_size)
 		rom_size = ofs - offset;
 
@@ -58,11 +58,13 @@ struct CMemory
 	int32	HeaderCount;
 
 	uint8	RAM[0x20000];
-	std::vector<uint8_t> ROMStorage;
+	uint8	*ROMStorage;
 	uint8   *ROM;
-	std::vector<uint8_t> SRAMStorage;
+	uint8	*SRAMStorage;
 	uint8	*SRAM;
 	const size_t SRAM_SIZE = 0x80000;
+	const size_t ROM_STORAGE_SIZE = MAX_ROM_SIZE + 0x200 + 0x8000;
+	uint32	SRAMExtent;		// how much of SRAM the cartridge can reach
 	uint8	VRAM[0x10000];
 	uint8	*FillRAM;
 	uint8	*BWRAM;
@@ -103,14 +105,19 @@ struct CMemory
 
 	bool8	Init (void);
 	void	Deinit (void);
+	size_t	ResidentBytes (void);
 
 	int		ScoreHiROM (bool8, int32 romoff = 0);
 	int		ScoreLoROM (bool8, int32 romoff = 0);
 	int		First512BytesCountZeroes() const;
+	uint32	HeaderSize (uint32);
+	void	HeaderSkip (const uint8 *);
 	uint32	HeaderRemove (uint32, uint8 *);
 	uint32	FileLoader (uint8 *, const char *, uint32);
     bool8   LoadROMMem (const uint8 *, uint32, const char* optional_rom_filename = NULL);
 	bool8	LoadROM (const char *);
+	uint8 *	FindROMHeader (int32 &, int &, int &, bool8);
+	void	ChooseROMMap (uint8 *, int, int, bool8 &, bool8 &);
     bool8	LoadROMInt (int32);
     bool8   LoadMultiCartMem (const uint8 *, uint32, const uint8 *, uint32, const uint8 *, uint32);
 	bool8	LoadMultiCart (const char *, const char *);
@@ -126,6 +133,8 @@ struct CMemory
 	bool8	SaveMPAK (const char *);
 
 	void	ParseSNESHeader (uint8 *);
+	void	ParseSNESHeader (uint8 *, bool8);
+	const char *	IdentifyROM (uint32);
 	void	InitROM (void);
 
 	uint32	map_mirror (uint32, uint32);
@@ -199,8 +208,8 @@ struct SMulti
 	char	fileNameA[PATH_MAX + 1], fileNameB[PATH_MAX + 1];
 };
 
-extern CMemory	Memory;
-extern SMulti	Multi;
+extern S9X_INSTANCE CMemory	Memory;
+extern S9X_INSTANCE SMulti	Multi;
 
 inline bool S9xInterlaceField()
 {
@@ -208,7 +217,11 @@ inline bool S9xInterlaceField()
 }
 
 void S9xAutoSaveSRAM (void);
-bool8 LoadZip(const char *, uint32 *, uint8 *);
+uint8 * S9xAllocLazy (size_t);
+void S9xFreeLazy (uint8 *, size_t);
+void S9xClearLazy (uint8 *, size_t);
+size_t S9xResidentBytes (const void *, size_t);
+bool8 LoadZip(const char *, uint32 *, uint8 *, CMemory &mem = Memory);
 
 enum s9xwrap_t
 {
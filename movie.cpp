@@ -16,6 +16,7 @@
 #include "snapshot.h"
 #include "movie.h"
 #include "language.h"
+#include "statehash.h"
 #ifdef NETPLAY_SUPPORT
 #include "netplay.h"
 #endif
@@ -33,6 +34,7 @@
 #define SMV_HEADER_SIZE			64
 #define SMV_EXTRAROMINFO_SIZE	30
 #define BUFFER_GROWTH_SIZE		4096
+#define SMV_HASH_MAGIC			0x48564d53 // SMVH
 
 enum MovieState
 {
@@ -71,13 +73,19 @@ struct SMovie
 	uint8	*InputBuffer;
 	uint8	*InputBufferPtr;
 	uint32	InputBufferSize;
+
+	// optional per-frame state hashes, stored after the controller data
+	uint64	*FrameHashes;
+	uint32	FrameHashCount;
+	uint32	FrameHashSize;
+	bool8	DesyncReported;
 };
 
-static struct SMovie	Movie;
+S9X_INSTANCE_STATIC struct SMovie	Movie;
 
-static uint8	prevPortType[2];
-static int8		prevPortIDs[2][4];
-static bool8	prevMouseMaster, prevSuperScopeMaster, prevJustifierMaster, prevMultiPlayer5Master;
+S9X_INSTANCE_STATIC uint8	prevPortType[2];
+S9X_INSTANCE_STATIC int8		prevPortIDs[2][4];
+S9X_INSTANCE_STATIC bool8	prevMouseMaster, prevSuperScopeMaster, prevJustifierMaster, prevMultiPlayer5Master;
 
 static uint8	Read8 (uint8 *&);
 static uint16	Read16 (uint8 *&);
@@ -91,11 +99,16 @@ static void		store_movie_settings (void);
 static void		restore_movie_settings (void);
 static int		bytes_per_sample (void);
 static void		reserve_buffer_space (uint32);
+static bool8		reserve_hash_space (uint32);
+static void		record_frame_hash (uint64);
+static void		check_frame_hash (void);
 static void		reset_controllers (void);
 static void		read_frame_controller_data (bool);
 static void		write_frame_controller_data (void);
 static void		flush_movie (void);
 static void		truncate_movie (void);
+static uint32	hash_block_size (void);
+static void		read_movie_hashes (FILE *, SMovie *);
 static int		read_movie_header (FILE *, SMovie *);
 static int		read_movie_extrarominfo (FILE *, SMovie *);
 static void		write_movie_header (FILE *, SMovie *);
@@ -235,6 +248,54 @@ static void reserve_buffer_space (uint32 space_needed)
 	}
 }
 
+static bool8 reserve_hash_space (uint32 count)
+{
+	if (count > Movie.FrameHashSize)
+	{
+		if (count > 0xffffffff / sizeof(uint64) - BUFFER_GROWTH_SIZE)
+			return (FALSE);
+
+		uint32	size   = count + BUFFER_GROWTH_SIZE;
+		uint64	*grown = (uint64 *) realloc(Movie.FrameHashes, size * sizeof(uint64));
+		if (!grown)
+			return (FALSE);
+
+		Movie.FrameHashes   = grown;
+		Movie.FrameHashSize = size;
+	}
+
+	return (TRUE);
+}
+
+static void record_frame_hash (uint64 hash)
+{
+	// frames recorded before hashing was enabled get 0, meaning "unchecked"
+	if (Movie.FrameHashCount > Movie.CurrentFrame)
+		Movie.FrameHashCount = Movie.CurrentFrame;
+
+	if (!reserve_hash_space(Movie.CurrentFrame + 1))
+		return;
+
+	while (Movie.FrameHashCount < Movie.CurrentFrame)
+		Movie.FrameHashes[Movie.FrameHashCount++] = 0;
+	Movie.FrameHashes[Movie.FrameHashCount++] = hash;
+}
+
+static void check_frame_hash (void)
+{
+	if (Movie.DesyncReported || Movie.CurrentFrame >= Movie.FrameHashCount || Movie.FrameHashes[Movie.CurrentFrame] == 0)
+		return;
+
+	if (Movie.FrameHashes[Movie.CurrentFrame] != S9xStateHash())
+	{
+		char	buf[64];
+
+		sprintf(buf, MOVIE_INFO_DESYNC, Movie.CurrentFrame);
+		S9xMessage(S9X_WARNING, S9X_MOVIE_INFO, buf);
+		Movie.DesyncReported = TRUE;
+	}
+}
+
 static void reset_controllers (void)
 {
 	for (int i = 0; i < 8; i++)
@@ -368,6 +429,28 @@ static void flush_movie (void)
 
 	if (!fwrite(Movie.InputBuffer, 1, Movie.BytesPerSample * (Movie.MaxSample + 1), Movie.File))
 		printf ("Movie flush failed.\n");
+
+	if (!Movie.FrameHashCount)
+		return;
+
+	// the hash block trails the controller data; recording carries on from
+	// the end of the controller data and overwrites it, so seek back after it
+	uint8	buf[8];
+	uint8	*ptr = buf;
+
+	Write32(SMV_HASH_MAGIC, ptr);
+	Write32(Movie.FrameHashCount, ptr);
+	fwrite(buf, 1, 8, Movie.File);
+
+	for (uint32 i = 0; i < Movie.FrameHashCount; i++)
+	{
+		ptr = buf;
+		Write32((uint32) Movie.FrameHashes[i], ptr);
+		Write32((uint32) (Movie.FrameHashes[i] >> 32), ptr);
+		fwrite(buf, 1, 8, Movie.File);
+	}
+
+	fseek(Movie.File, Movie.ControllerDataOffset + Movie.BytesPerSample * (Movie.MaxSample + 1), SEEK_SET);
 }
 
 static void truncate_movie (void)
@@ -378,10 +461,53 @@ static void truncate_movie (void)
 	if (Movie.SaveStateOffset > Movie.ControllerDataOffset)
 		return;
 
-	if (ftruncate(fileno(Movie.File), Movie.ControllerDataOffset + Movie.BytesPerSample * (Movie.MaxSample + 1)))
+	if (ftruncate(fileno(Movie.File), Movie.ControllerDataOffset + Movie.BytesPerSample * (Movie.MaxSample + 1) + hash_block_size()))
 		printf ("Couldn't truncate file.\n");
 }
 
+static uint32 hash_block_size (void)
+{
+	return (Movie.FrameHashCount ? 8 + Movie.FrameHashCount * 8 : 0);
+}
+
+static void read_movie_hashes (FILE *fd, SMovie *movie)
+{
+	uint8	buf[8];
+	uint8	*ptr = buf;
+
+	movie->FrameHashCount = 0;
+
+	if (fread(buf, 1, 8, fd) != 8 || Read32(ptr) != SMV_HASH_MAGIC)
+		return;
+
+	uint32	count = Read32(ptr);
+	long	here = ftell(fd);
+
+	if (here < 0 || fseek(fd, 0, SEEK_END))
+		return;
+
+	long	end = ftell(fd);
+
+	if (end < here || fseek(fd, here, SEEK_SET))
+		return;
+
+	// there is at most one hash per frame, and the file has to hold them all
+	if (count > (uint64) movie->MaxFrame + 1 || count > (uint64) (end - here) / 8 || !reserve_hash_space(count))
+		return;
+
+	for (uint32 i = 0; i < count; i++)
+	{
+		if (fread(buf, 1, 8, fd) != 8)
+			return;
+
+		ptr = buf;
+		uint32	lo = Read32(ptr);
+		uint32	hi = Read32(ptr);
+		movie->FrameHashes[i] = ((uint64) hi << 32) | lo;
+		movie->FrameHashCount = i + 1;
+	}
+}
+
 static int read_movie_header (FILE *fd, SMovie *movie)
 {
 	uint32	value;
@@ -569,6 +695,9 @@ int S9xMovieUnfreeze (uint8 *buf, uint32 size)
 		reserve_buffer_space(space_needed);
 		memcpy(Movie.InputBuffer, ptr, space_needed);
 
+		if (Movie.FrameHashCount > current_frame)
+			Movie.FrameHashCount = current_frame;
+
 		flush_movie();
 		fseek(Movie.File, Movie.ControllerDataOffset + (Movie.BytesPerSample * (Movie.CurrentSample + 1)), SEEK_SET);
 	}
@@ -585,6 +714,7 @@ int S9xMovieUnfreeze (uint8 *buf, uint32 size)
 	}
 
 	Movie.InputBufferPtr = Movie.InputBuffer + (Movie.BytesPerSample * Movie.CurrentSample);
+	Movie.DesyncReported = FALSE;
 	read_frame_controller_data(true);
 
 	return (SUCCESS);
@@ -673,6 +803,10 @@ int S9xMovieOpen (const char *filename, bool8 read_only)
 		return (WRONG_FORMAT);
 	}
 
+	read_movie_hashes(fd, &Movie);
+	fseek(fd, Movie.ControllerDataOffset + Movie.BytesPerSample * (Movie.MaxSample + 1), SEEK_SET);
+	Movie.DesyncReported = FALSE;
+
 	// read "baseline" controller data
 	if (Movie.MaxSample && Movie.MaxFrame)
 		read_frame_controller_data(true);
@@ -777,6 +911,7 @@ int S9xMovieCreate (const char *filename, uint8 controllers_mask, uint8 opts, co
 	Movie.File           = fd;
 	Movie.BytesPerSample = bytes_per_sample();
 	Movie.InputBufferPtr = Movie.InputBuffer;
+	Movie.FrameHashCount = 0;
 	write_frame_controller_data();
 
 	Movie.CurrentFrame  = 0;
@@ -875,7 +1010,10 @@ void S9xMovieUpdate (bool addFrame)
 			else
 			{
 				if (addFrame)
+				{
 					S9xUpdateFrameCounter();
+					check_frame_hash();
+				}
 				else
 				if (SKIPPED_POLLING_PORT_TYPE(Movie.PortType[0]) && SKIPPED_POLLING_PORT_TYPE(Movie.PortType[1]))
 					return;
@@ -892,7 +1030,11 @@ void S9xMovieUpdate (bool addFrame)
 		case MOVIE_STATE_RECORD:
 		{
 			if (addFrame)
+			{
 				S9xUpdateFrameCounter();
+				if (Settings.MovieStateHashes)
+					record_frame_hash(S9xStateHash());
+			}
 			else
 			if (SKIPPED_POLLING_PORT_TYPE(Movie.PortType[0]) && SKIPPED_POLLING_PORT_TYPE(Movie.PortType[1]))
 				return;
@@ -925,6 +1067,8 @@ void S9xMovieUpdateOnReset (void)
 		reserve_buffer_space((uint32) (Movie.InputBufferPtr + Movie.BytesPerSample - Movie.InputBuffer));
 		memset(Movie.InputBufferPtr, 0xFF, Movie.BytesPerSample);
 		Movie.InputBufferPtr += Movie.BytesPerSample;
+		if (Settings.MovieStateHashes)
+			record_frame_hash(0);
 		Movie.MaxSample = ++Movie.CurrentSample;
 		Movie.MaxFrame = ++Movie.CurrentFrame;
 
@@ -1022,7 +1166,7 @@ void S9xMovieToggleFrameDisplay (void)
 
 void S9xUpdateFrameCounter (int offset)
 {
-	extern bool8	pad_read;
+	extern S9X_INSTANCE bool8	pad_read;
 
 	offset++;
 
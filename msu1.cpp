@@ -13,13 +13,13 @@
 #include <fstream>
 #include <sys/stat.h>
 
-STREAM dataStream = NULL;
-STREAM audioStream = NULL;
-uint32 audioLoopPos;
-size_t partial_frames;
+S9X_INSTANCE STREAM dataStream = NULL;
+S9X_INSTANCE STREAM audioStream = NULL;
+S9X_INSTANCE uint32 audioLoopPos;
+S9X_INSTANCE size_t partial_frames;
 
 // Sample buffer
-static Resampler *msu_resampler = NULL;
+S9X_INSTANCE_STATIC Resampler *msu_resampler = NULL;
 
 #ifdef UNZIP_SUPPORT
 static int unzFindExtension(unzFile &file, const char *ext, bool restart = TRUE, bool print = TRUE, bool allowExact = FALSE)
@@ -39,7 +39,7 @@ enum SMSU1_CMD {
 	Resume			= 0x04
 };
 
-extern struct SMSU1	MSU1;
+extern S9X_INSTANCE struct SMSU1	MSU1;
 
 void S9xResetMSU(void);
 void S9xMSU1Init(void);
@@ -11,6 +11,9 @@
 #include <errno.h>
 #include <memory.h>
 #include <sys/types.h>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
 
 #include "snes9x.h"
 #include "controls.h"
@@ -52,16 +55,21 @@
 #include "netplay.h"
 #include "snapshot.h"
 #include "display.h"
+#include "statehash.h"
+#include "movie.h"
+#include "apu/apu.h"
 
 void S9xNPClientLoop (void *);
 bool8 S9xNPLoadROM (uint32 len);
 bool8 S9xNPLoadROMDialog (const char *);
-bool8 S9xNPGetROMImage (uint32 len);
-void S9xNPGetSRAMData (uint32 len);
-void S9xNPGetFreezeFile (uint32 len);
+void S9xNPGetTransfer (uint32 len, bool8 push);
+void S9xNPGetTransferData (uint32 len, bool8 packed);
+void S9xNPUnfreezeReceivedGame (const uint8 *data, uint32 len);
 
 unsigned long START = 0;
 
+struct SNPRollback NPRollback;
+
 bool8 S9xNPConnect ();
 
 bool8 S9xNPConnectToServer (const char *hostname, int port,
@@ -87,6 +95,8 @@ bool8 S9xNPConnectToServer (const char *hostname, int port,
         free ((char *) NetPlay.ROMName);
     NetPlay.ROMName = strdup (rom_name);
     NetPlay.Port = port;
+    if (Settings.NetPlaySpectate)
+        NetPlay.Port += NP_SPECTATOR_PORT_OFFSET;
     NetPlay.PendingWait4Sync = FALSE;
 
 #ifdef __WIN32__
@@ -261,6 +271,27 @@ version of the protocol. Disconnecting.");
 
     NetPlay.FrameCount = READ_LONG (&data [2]);
 
+    // Rollback servers append their input delay after the ROM name.
+    NetPlay.Rollback = (header [2] & 0x40) != 0;
+    if (NetPlay.Rollback && !NetPlay.RollbackCapable)
+    {
+        S9xNPSetError ("\
+The Snes9x NetPlay server runs a rollback session,\n\
+which this version can't join. Disconnecting.");
+        delete[] data;
+	S9xNPDisconnect ();
+        return (FALSE);
+    }
+
+    NPRollback.InputDelay = 0;
+    if (NetPlay.Rollback)
+    {
+        uint32 delay_pos = 4 + 2 + strlen ((char *) data + 4 + 2) + 1;
+
+        if (len >= 7 && delay_pos < (uint32) len - 7 && data [delay_pos] <= NP_ROLLBACK_MAX_DELAY)
+            NPRollback.InputDelay = data [delay_pos];
+    }
+
     if (!(header [2] & 0x80) &&
         strcmp ((char *) data + 4 + 2, NetPlay.ROMName) != 0)
     {
@@ -279,6 +310,9 @@ version of the protocol. Disconnecting.");
     S9xNPResetJoypadReadPos ();
     NetPlay.ServerSequenceNum = 1;
 
+    if (NetPlay.Rollback)
+        S9xNPRollbackReset (NetPlay.FrameCount);
+
 #ifdef NP_DEBUG
     printf ("CLIENT: Sending 'READY' to server @%ld...\n", S9xGetMilliTime () - START);
 #endif
@@ -332,6 +366,308 @@ bool8 S9xNPSendPause (bool8 paused)
     return (TRUE);
 }
 
+bool8 S9xNPSendStateHash ()
+{
+    uint8 data [7 + 12];
+    uint8 *ptr = data;
+    uint64 hash = S9xStateHash ();
+
+    *ptr++ = NP_CLNT_MAGIC;
+    *ptr++ = NetPlay.MySequenceNum++;
+    *ptr++ = NP_CLNT_STATE_HASH;
+    WRITE_LONG (ptr, sizeof (data));
+    ptr += 4;
+    WRITE_LONG (ptr, NetPlay.FrameCount);
+    ptr += 4;
+    WRITE_LONG (ptr, (uint32) (hash >> 32));
+    ptr += 4;
+    WRITE_LONG (ptr, (uint32) hash);
+
+    if (!S9xNPSendData (NetPlay.Socket, data, sizeof (data)))
+    {
+        S9xNPSetError ("Sending 'STATE HASH' message failed.");
+        S9xNPDisconnect ();
+        return (FALSE);
+    }
+
+    return (TRUE);
+}
+
+void S9xNPRollbackReset (uint32 frame)
+{
+    NPRollback.Active = TRUE;
+    NPRollback.Resimulating = FALSE;
+    NPRollback.StartFrame = frame;
+    NPRollback.Frame = frame;
+    NPRollback.ResimFrom = ~0U;
+    NPRollback.SendFrame = frame + NPRollback.InputDelay;
+
+    uint32 size = S9xFreezeSize ();
+    for (int i = 0; i < NP_ROLLBACK_FRAMES; i++)
+    {
+        if (NPRollback.StateSize != size)
+        {
+            delete[] NPRollback.States [i];
+            NPRollback.States [i] = new uint8 [size];
+        }
+        NPRollback.StateFrame [i] = ~0U;
+    }
+    NPRollback.StateSize = size;
+
+    memset (NPRollback.InputFrame, 0xff, sizeof (NPRollback.InputFrame));
+    memset (NPRollback.Used, 0, sizeof (NPRollback.Used));
+    memset (NPRollback.Received, 0, sizeof (NPRollback.Received));
+    memset (NPRollback.Present, 0, sizeof (NPRollback.Present));
+}
+
+// The server thread can't tell when the emulation thread is between frames,
+// so it asks that thread for freezes, which it takes at the next chance.
+enum
+{
+    NP_FREEZE_IDLE,
+    NP_FREEZE_REQUESTED,
+    NP_FREEZE_BUSY,
+    NP_FREEZE_DONE
+};
+
+static std::mutex np_freeze_lock;
+static std::condition_variable np_freeze_cond;
+static int np_freeze_state = NP_FREEZE_IDLE;
+static uint8 *np_freeze_data;
+static uint32 np_freeze_len;
+
+void S9xNPServeFreeze ()
+{
+    {
+        std::lock_guard<std::mutex> lock (np_freeze_lock);
+
+        if (np_freeze_state != NP_FREEZE_REQUESTED)
+            return;
+        np_freeze_state = NP_FREEZE_BUSY;
+    }
+
+    np_freeze_len = S9xFreezeSize ();
+    np_freeze_data = new uint8 [np_freeze_len];
+    if (!S9xFreezeGameMem (np_freeze_data, np_freeze_len))
+    {
+        delete[] np_freeze_data;
+        np_freeze_data = NULL;
+    }
+
+    std::lock_guard<std::mutex> lock (np_freeze_lock);
+    np_freeze_state = NP_FREEZE_DONE;
+    np_freeze_cond.notify_all ();
+}
+
+// Called from the server thread. When no frames are being run the game is
+// frozen right away.
+bool8 S9xNPFreezeBetweenFrames (uint8 *&data, uint32 &len)
+{
+    std::unique_lock<std::mutex> lock (np_freeze_lock);
+
+    np_freeze_state = NP_FREEZE_REQUESTED;
+
+    while (np_freeze_state != NP_FREEZE_DONE)
+    {
+        np_freeze_cond.wait_for (lock, std::chrono::milliseconds (40));
+
+        if (np_freeze_state == NP_FREEZE_REQUESTED &&
+            (!NetPlay.Connected || Settings.ForcedPause || Settings.StopEmulation ||
+             (Settings.Paused && !Settings.FrameAdvance)))
+        {
+            np_freeze_state = NP_FREEZE_IDLE;
+            lock.unlock ();
+
+            len = S9xFreezeSize ();
+            data = new uint8 [len];
+            return (S9xFreezeGameMem (data, len));
+        }
+    }
+
+    np_freeze_state = NP_FREEZE_IDLE;
+    data = np_freeze_data;
+    len = np_freeze_len;
+
+    return (data != NULL);
+}
+
+static uint16 S9xNPRollbackGetInput (uint32 frame, int player)
+{
+    if (frame < NPRollback.StartFrame + NPRollback.InputDelay)
+        return (0);
+
+    uint32 i = frame % NP_ROLLBACK_INPUT_RING;
+    if (NPRollback.InputFrame [i][player] == frame)
+        return (NPRollback.Input [i][player]);
+
+    // Predict: the player keeps holding whatever they held last.
+    if (NPRollback.Present [player])
+    {
+        i = NPRollback.Received [player] % NP_ROLLBACK_INPUT_RING;
+        if (NPRollback.InputFrame [i][player] == NPRollback.Received [player])
+            return (NPRollback.Input [i][player]);
+    }
+
+    return (0);
+}
+
+void S9xNPRollbackInput (int player, uint32 frame, uint16 joypad)
+{
+    if (!NPRollback.Active || player >= NP_MAX_CLIENTS ||
+        frame < NPRollback.StartFrame + NPRollback.InputDelay ||
+        frame + NP_ROLLBACK_FRAMES < NPRollback.Frame)
+        return;
+
+    uint32 i = frame % NP_ROLLBACK_INPUT_RING;
+    NPRollback.Input [i][player] = joypad;
+    NPRollback.InputFrame [i][player] = frame;
+
+    if (!NPRollback.Present [player] || frame > NPRollback.Received [player])
+        NPRollback.Received [player] = frame;
+    NPRollback.Present [player] = TRUE;
+
+    if (frame < NPRollback.Frame && frame < NPRollback.ResimFrom &&
+        NPRollback.Used [i][player] != joypad)
+        NPRollback.ResimFrom = frame;
+}
+
+static void S9xNPRollbackBeginFrame (uint32 frame)
+{
+    uint32 s = frame % NP_ROLLBACK_FRAMES;
+    uint32 i = frame % NP_ROLLBACK_INPUT_RING;
+
+    if (S9xFreezeGameMem (NPRollback.States [s], NPRollback.StateSize))
+        NPRollback.StateFrame [s] = frame;
+
+    for (int p = 0; p < NP_MAX_CLIENTS; p++)
+    {
+        NPRollback.Used [i][p] = S9xNPRollbackGetInput (frame, p);
+        MovieSetJoypad (p, NPRollback.Used [i][p]);
+    }
+}
+
+static void S9xNPRollbackResimulate ()
+{
+    uint32 from = NPRollback.ResimFrom;
+    uint32 s = from % NP_ROLLBACK_FRAMES;
+
+    NPRollback.ResimFrom = ~0U;
+
+    if (NPRollback.StateFrame [s] != from ||
+        S9xUnfreezeGameMem (NPRollback.States [s], NPRollback.StateSize) != SUCCESS)
+    {
+        S9xNPSetWarning ("Late input arrived past the rollback window; this session may be out of sync.");
+        return;
+    }
+
+    bool8 render = IPPU.RenderThisFrame;
+
+    NPRollback.Resimulating = TRUE;
+    S9xSetSoundDiscard (TRUE);
+
+    for (uint32 f = from; f < NPRollback.Frame; f++)
+    {
+        S9xNPRollbackBeginFrame (f);
+        IPPU.RenderThisFrame = FALSE;
+        S9xMainLoop ();
+    }
+
+    S9xSetSoundDiscard (FALSE);
+    NPRollback.Resimulating = FALSE;
+
+    IPPU.RenderThisFrame = render;
+}
+
+bool8 S9xNPRollbackUpdate (uint16 joypad)
+{
+    int me = NetPlay.Player - 1;
+    bool8 stalled;
+
+    // Between frames, so the server's freezes are taken here.
+    S9xNPServeFreeze ();
+
+    while (NetPlay.Connected && S9xNPCheckForHeartBeat ())
+        S9xNPWaitForHeartBeat ();
+
+    if (!NetPlay.Connected || !NPRollback.Active)
+        return (FALSE);
+
+    // Send local input for the frame it will take effect in; with an input
+    // delay, remote clients usually have it before they need it.
+    while (me >= 0 && NPRollback.SendFrame <= NPRollback.Frame + NPRollback.InputDelay)
+    {
+        uint32 frame = NPRollback.SendFrame++;
+        uint8 data [7 + 4 + 2];
+        uint8 *ptr = data;
+
+        *ptr++ = NP_CLNT_MAGIC;
+        *ptr++ = NetPlay.MySequenceNum++;
+        *ptr++ = NP_CLNT_ROLLBACK_INPUT;
+        WRITE_LONG (ptr, sizeof (data));
+        ptr += 4;
+        WRITE_LONG (ptr, frame);
+        ptr += 4;
+        *ptr++ = joypad >> 8;
+        *ptr++ = joypad & 0xff;
+
+        if (!S9xNPSendData (NetPlay.Socket, data, sizeof (data)))
+        {
+            S9xNPSetError ("Error while sending rollback input to server.");
+            S9xNPDisconnect ();
+            return (FALSE);
+        }
+
+        S9xNPRollbackInput (me, frame, joypad);
+    }
+
+    // Don't run further ahead of a remote player than the saved states
+    // reach back; give their input up to a frame time to arrive.
+    for (int wait = 0; wait < 2; wait++)
+    {
+        stalled = FALSE;
+        for (int p = 0; p < NP_MAX_CLIENTS; p++)
+        {
+            if (p != me && NPRollback.Present [p] &&
+                NPRollback.Received [p] + NP_ROLLBACK_FRAMES < NPRollback.Frame)
+                stalled = TRUE;
+        }
+
+        if (!stalled)
+            break;
+
+        if (wait == 0 && S9xNPCheckForHeartBeat (Settings.FrameTime / 1000))
+            while (NetPlay.Connected && S9xNPCheckForHeartBeat ())
+                S9xNPWaitForHeartBeat ();
+    }
+
+    if (stalled || !NetPlay.Connected)
+        return (FALSE);
+
+    if (NPRollback.ResimFrom < NPRollback.Frame)
+        S9xNPRollbackResimulate ();
+
+    // Only states every client agrees on are worth comparing.
+    NetPlay.FrameCount = NPRollback.Frame;
+    if (NetPlay.FrameCount % NP_STATE_HASH_INTERVAL == 0)
+    {
+        bool8 confirmed = TRUE;
+
+        for (int p = 0; p < NP_MAX_CLIENTS; p++)
+        {
+            if (p != me && NPRollback.Present [p] &&
+                NPRollback.Received [p] + 1 < NPRollback.Frame)
+                confirmed = FALSE;
+        }
+
+        if (confirmed)
+            S9xNPSendStateHash ();
+    }
+
+    S9xNPRollbackBeginFrame (NPRollback.Frame++);
+
+    return (TRUE);
+}
+
 #ifdef __WIN32__
 void S9xNPClientLoop (void *)
 {
@@ -403,6 +739,10 @@ bool8 S9xNPCheckForHeartBeat (uint32 time_msec)
 
 bool8 S9xNPWaitForHeartBeatDelay (uint32 time_msec)
 {
+    // The emulation thread waits here between frames, however long the
+    // server holds back the heart-beat.
+    S9xNPServeFreeze ();
+
     if (!S9xNPCheckForHeartBeat(time_msec))
         return FALSE;
 
@@ -437,6 +777,24 @@ bool8 S9xNPWaitForHeartBeat ()
         else
             NetPlay.ServerSequenceNum++;
 
+        if ((header [2] & 0x1f) == NP_SERV_ROLLBACK_INPUT)
+        {
+            uint8 input [4 + 2];
+
+            if (READ_LONG (&header [3]) != 7 + sizeof (input) ||
+                !S9xNPGetData (NetPlay.Socket, input, sizeof (input)))
+            {
+                S9xNPSetError ("Error while receiving 'ROLLBACK INPUT' message.");
+                S9xNPDisconnect ();
+                return (FALSE);
+            }
+
+            // Top 3 bits of opcode are the player the input belongs to.
+            S9xNPRollbackInput (header [2] >> 5, READ_LONG (input),
+                                (input [4] << 8) | input [5]);
+            return (TRUE);
+        }
+
         if ((header [2] & 0x1f) == NP_SERV_JOYPAD)
         {
             // Top 2 bits + 1 of opcode is joypad data count.
@@ -485,6 +843,8 @@ bool8 S9xNPWaitForHeartBeat ()
 		S9xReset ();
                 NetPlay.FrameCount = READ_LONG (&header [3]);
                 S9xNPResetJoypadReadPos ();
+                if (NetPlay.Rollback)
+                    S9xNPRollbackReset (NetPlay.FrameCount);
                 S9xNPSendReady ();
                 break;
 	    case NP_SERV_PAUSE:
@@ -508,29 +868,14 @@ bool8 S9xNPWaitForHeartBeat ()
                 if (S9xNPLoadROM (len - 7))
                     S9xNPSendReady (NP_CLNT_LOADED_ROM);
                 break;
-            case NP_SERV_ROM_IMAGE:
-#ifdef NP_DEBUG
-                printf ("CLIENT: ROM_IMAGE received @%ld\n", S9xGetMilliTime () - START);
-#endif
-                S9xNPDiscardHeartbeats ();
-                if (S9xNPGetROMImage (len - 7))
-                    S9xNPSendReady (NP_CLNT_RECEIVED_ROM_IMAGE);
-                break;
-            case NP_SERV_SRAM_DATA:
+            case NP_SERV_TRANSFER:
 #ifdef NP_DEBUG
-                printf ("CLIENT: SRAM_DATA received @%ld\n", S9xGetMilliTime () - START);
+                printf ("CLIENT: TRANSFER received @%ld\n", S9xGetMilliTime () - START);
 #endif
-                S9xNPDiscardHeartbeats ();
-                S9xNPGetSRAMData (len - 7);
+                S9xNPGetTransfer (len - 7, (header [2] & 0x80) != 0);
                 break;
-            case NP_SERV_FREEZE_FILE:
-#ifdef NP_DEBUG
-                printf ("CLIENT: FREEZE_FILE received @%ld\n", S9xGetMilliTime () - START);
-#endif
-                S9xNPDiscardHeartbeats ();
-                S9xNPGetFreezeFile (len - 7);
-                S9xNPResetJoypadReadPos ();
-                S9xNPSendReady ();
+            case NP_SERV_TRANSFER_DATA:
+                S9xNPGetTransferData (len - 7, (header [2] & 0x80) != 0);
                 break;
             default:
 #ifdef NP_DEBUG
@@ -539,6 +884,10 @@ bool8 S9xNPWaitForHeartBeat ()
                 S9xNPDisconnect ();
                 return (FALSE);
 	    }
+
+            // Rollback clients poll without blocking, one message at a time.
+            if (NetPlay.Rollback)
+                return (TRUE);
 	}
     }
 
@@ -601,60 +950,53 @@ bool8 S9xNPLoadROM (uint32 len)
     return (TRUE);
 }
 
-bool8 S9xNPGetROMImage (uint32 len)
+static bool8 S9xNPSendTransferReply (uint8 kind, uint32 offset)
 {
-    uint8 rom_info [5];
+    uint8 reply [7 + 1 + 4];
+    uint8 *ptr = reply;
+    *ptr++ = NP_CLNT_MAGIC;
+    *ptr++ = NetPlay.MySequenceNum++;
+    *ptr++ = NP_CLNT_TRANSFER;
+    WRITE_LONG (ptr, sizeof (reply));
+    ptr += 4;
+    *ptr++ = kind;
+    WRITE_LONG (ptr, offset);
 
-    S9xNPSetAction ("Receiving ROM information...");
-    if (!S9xNPGetData (NetPlay.Socket, rom_info, 5))
-    {
-        S9xNPSetError ("Error while receiving ROM information.");
-        S9xNPDisconnect ();
-        return (FALSE);
-    }
-    uint32 CalculatedSize = READ_LONG (&rom_info [1]);
-#ifdef NP_DEBUG
-    printf ("CLIENT: Hi-ROM: %s, Size: %04x\n", rom_info [0] ? "Y" : "N", CalculatedSize);
-#endif
-    if (CalculatedSize + 5 >= len ||
-        CalculatedSize >= CMemory::MAX_ROM_SIZE)
+    if (!S9xNPSendData (NetPlay.Socket, reply, sizeof (reply)))
     {
-        S9xNPSetError ("Size error in ROM image data received from server.");
-        S9xNPDisconnect ();
-        return (FALSE);
+	S9xNPDisconnect ();
+        S9xNPSetError ("Sending 'TRANSFER' reply failed.");
+	return (FALSE);
     }
 
-    Memory.HiROM = rom_info [0];
-    Memory.LoROM = !Memory.HiROM;
-    Memory.HeaderCount = 0;
-    Memory.CalculatedSize = CalculatedSize;
+    return (TRUE);
+}
 
-    // Load up ROM image
-#ifdef NP_DEBUG
-    printf ("CLIENT: Receiving ROM image @%ld...\n", S9xGetMilliTime () - START);
-#endif
-    S9xNPSetAction ("Receiving ROM image...");
-    if (!S9xNPGetData (NetPlay.Socket, Memory.ROM, Memory.CalculatedSize))
-    {
-        S9xNPSetError ("Error while receiving ROM image from server.");
-        Settings.StopEmulation = TRUE;
-        S9xNPDisconnect ();
-        return (FALSE);
-    }
+static void S9xNPFreeTransfer ()
+{
+    delete[] NetPlay.Transfer.Data;
+    NetPlay.Transfer.Data = NULL;
+    free (NetPlay.Transfer.Name);
+    NetPlay.Transfer.Name = NULL;
+    NetPlay.Transfer.Active = FALSE;
+}
+
+static void S9xNPApplyROMImage (struct SNPTransfer *t)
+{
 #ifdef NP_DEBUG
-    printf ("CLIENT: Receiving ROM filename @%ld...\n", S9xGetMilliTime () - START);
+    printf ("CLIENT: Hi-ROM: %s, Size: %04x\n", t->Info ? "Y" : "N", t->Size);
 #endif
-    S9xNPSetAction ("Receiving ROM filename...");
-    uint32 filename_len = len - Memory.CalculatedSize - 5;
-    if (filename_len > PATH_MAX ||
-        !S9xNPGetData (NetPlay.Socket, (uint8 *) Memory.ROMFilename.c_str(), filename_len))
+    // Data is NULL when the ROM already loaded is the one the server has.
+    if (t->Data)
     {
-        S9xNPSetError ("Error while receiving ROM filename from server.");
-        S9xNPDisconnect ();
-        Settings.StopEmulation = TRUE;
-        return (FALSE);
+        memcpy (Memory.ROM, t->Data, t->Size);
+        Memory.HiROM = t->Info != 0;
+        Memory.LoROM = !Memory.HiROM;
+        Memory.HeaderCount = 0;
+        Memory.CalculatedSize = t->Size;
+        Memory.ROMFilename = t->Name ? t->Name : "";
+        Memory.InitROM ();
     }
-    Memory.InitROM ();
     S9xReset ();
     S9xNPResetJoypadReadPos ();
     Settings.StopEmulation = FALSE;
@@ -662,57 +1004,197 @@ bool8 S9xNPGetROMImage (uint32 len)
 #ifdef __WIN32__
     PostMessage (GUI.hWnd, WM_NULL, 0, 0);
 #endif
-
-    return (TRUE);
 }
 
-void S9xNPGetSRAMData (uint32 len)
+static void S9xNPTransferComplete ()
 {
-    if (len > 0x70000)
+    struct SNPTransfer *t = &NetPlay.Transfer;
+
+    if (t->Data && S9xStateHashData (t->Data, t->Size) != t->Hash)
     {
-        S9xNPSetError ("Length error in S-RAM data received from server.");
+        S9xNPFreeTransfer ();
+        S9xNPSetError ("Data received from server is corrupt.");
         S9xNPDisconnect ();
         return;
     }
-    S9xNPSetAction ("Receiving S-RAM data...");
-    if (len > 0 && !S9xNPGetData (NetPlay.Socket, Memory.SRAM, len))
+
+    switch (t->Kind)
     {
-        S9xNPSetError ("Error while receiving S-RAM data from server.");
-        S9xNPDisconnect ();
+        case NP_SERV_ROM_IMAGE:
+            S9xNPApplyROMImage (t);
+            S9xNPFreeTransfer ();
+            S9xNPSendReady (NP_CLNT_RECEIVED_ROM_IMAGE);
+            break;
+
+        case NP_SERV_SRAM_DATA:
+            if (t->Data)
+                memcpy (Memory.SRAM, t->Data, t->Size);
+            S9xNPFreeTransfer ();
+            S9xNPSetAction ("", TRUE);
+            break;
+
+        case NP_SERV_FREEZE_FILE:
+            NetPlay.FrameCount = t->Info;
+            S9xNPUnfreezeReceivedGame (t->Data, t->Size);
+            S9xNPFreeTransfer ();
+            S9xNPResetJoypadReadPos ();
+            if (NetPlay.Rollback)
+                S9xNPRollbackReset (NetPlay.FrameCount);
+            S9xNPSendReady ();
+            break;
     }
-	S9xNPSetAction ("", TRUE);
 }
 
-void S9xNPGetFreezeFile (uint32 len)
+void S9xNPGetTransfer (uint32 len, bool8 push)
 {
-    uint8 frame_count [4];
+    struct SNPTransfer *t = &NetPlay.Transfer;
+
+    if (len < 1 + 4 + 8 + 4 + 1 || len > 1 + 4 + 8 + 4 + PATH_MAX)
+    {
+        S9xNPSetError ("Length error in transfer information received from server.");
+        S9xNPDisconnect ();
+        return;
+    }
+
+    uint8 *data = new uint8 [len];
+
+    S9xNPSetAction ("Receiving transfer information...");
+    if (!S9xNPGetData (NetPlay.Socket, data, len))
+    {
+        S9xNPSetError ("Error while receiving transfer information from server.");
+        delete[] data;
+        S9xNPDisconnect ();
+        return;
+    }
+    data [len - 1] = 0;
+
+    uint8 kind = data [0];
+    uint32 size = READ_LONG (&data [1]);
+    uint64 hash = ((uint64) READ_LONG (&data [5]) << 32) | (uint32) READ_LONG (&data [9]);
+    uint32 info = READ_LONG (&data [13]);
+    bool8 have = FALSE;
+
+    if ((kind == NP_SERV_ROM_IMAGE && size >= CMemory::MAX_ROM_SIZE) ||
+        (kind == NP_SERV_SRAM_DATA && size > 0x70000) ||
+        (kind == NP_SERV_FREEZE_FILE && size > 0x1000000) ||
+        (kind != NP_SERV_ROM_IMAGE && kind != NP_SERV_SRAM_DATA && kind != NP_SERV_FREEZE_FILE))
+    {
+        S9xNPSetError ("Size error in transfer information received from server.");
+        delete[] data;
+        S9xNPDisconnect ();
+        return;
+    }
+
+    S9xNPDiscardHeartbeats ();
+
+    // Content we already hold is not sent again.
+    if (!push)
+    {
+        if (kind == NP_SERV_ROM_IMAGE)
+            have = size == Memory.CalculatedSize && S9xStateHashData (Memory.ROM, size) == hash;
+        else
+        if (kind == NP_SERV_SRAM_DATA)
+            have = S9xStateHashData (Memory.SRAM, size) == hash;
+    }
+
+    // What is left over from a transfer of the same content is kept, so
+    // a client that lost its connection picks up where it stopped.
+    if (have || push || !t->Data || t->Kind != kind || t->Size != size || t->Hash != hash)
+    {
+        S9xNPFreeTransfer ();
+        if (!have)
+            t->Data = new uint8 [size];
+        t->Offset = have ? size : 0;
+    }
+    else
+    {
+        free (t->Name);
+        t->Name = NULL;
+    }
+
+    t->Kind = kind;
+    t->Size = size;
+    t->Hash = hash;
+    t->Info = info;
+    t->Name = strdup ((char *) &data [17]);
+    t->Active = TRUE;
+    delete[] data;
 
 #ifdef NP_DEBUG
-    printf ("CLIENT: Receiving freeze file information @%ld...\n", S9xGetMilliTime () - START);
+    printf ("CLIENT: Transfer of %d bytes (kind %d), starting at %d @%ld\n", size, kind, t->Offset, S9xGetMilliTime () - START);
 #endif
-    S9xNPSetAction ("Receiving freeze file information...");
-    if (!S9xNPGetData (NetPlay.Socket, frame_count, 4))
+
+    if (!push && !S9xNPSendTransferReply (kind, t->Offset))
+        return;
+
+    if (t->Offset == t->Size)
+        S9xNPTransferComplete ();
+    else
+        S9xNPSetAction (kind == NP_SERV_ROM_IMAGE ? "Receiving ROM image..." :
+                        kind == NP_SERV_SRAM_DATA ? "Receiving S-RAM data..." :
+                                                    "Receiving freeze file...");
+}
+
+void S9xNPGetTransferData (uint32 len, bool8 packed)
+{
+    static uint8 chunk [NP_TRANSFER_CHUNK];
+    struct SNPTransfer *t = &NetPlay.Transfer;
+    uint8 offset [4];
+
+    if (!t->Active || !t->Data || len < 4 || len > 4 + NP_TRANSFER_CHUNK ||
+        !S9xNPGetData (NetPlay.Socket, offset, 4) ||
+        (uint32) READ_LONG (offset) != (uint32) t->Offset ||
+        !S9xNPGetData (NetPlay.Socket, chunk, len - 4))
     {
-        S9xNPSetError ("Error while receiving freeze file information from server.");
+        S9xNPSetError ("Error while receiving transfer data from server.");
         S9xNPDisconnect ();
         return;
     }
-    NetPlay.FrameCount = READ_LONG (frame_count);
 
-#ifdef NP_DEBUG
-    printf ("CLIENT: Receiving freeze file @%ld...\n", S9xGetMilliTime () - START);
+    uint32 raw = t->Size - t->Offset;
+    bool8 ok;
+
+    if (raw > NP_TRANSFER_CHUNK)
+        raw = NP_TRANSFER_CHUNK;
+
+    if (packed)
+    {
+#ifdef ZLIB
+        uLongf out = raw;
+
+        ok = uncompress (t->Data + t->Offset, &out, chunk, len - 4) == Z_OK && out == raw;
+#else
+        ok = FALSE;
 #endif
-    S9xNPSetAction ("Receiving freeze file...");
-    uint8 *data = new uint8 [len];
-    if (!S9xNPGetData (NetPlay.Socket, data, len - 4))
+    }
+    else
     {
-        S9xNPSetError ("Error while receiving freeze file from server.");
+        ok = len - 4 == raw;
+        if (ok)
+            memcpy (t->Data + t->Offset, chunk, raw);
+    }
+
+    if (!ok)
+    {
+        S9xNPSetError ("Data received from server is corrupt.");
         S9xNPDisconnect ();
-        delete[] data;
         return;
     }
-	S9xNPSetAction ("", TRUE);
 
+    t->Offset += raw;
+
+    NetPlay.PercentageComplete = (uint8) (((uint64) t->Offset * 100) / t->Size);
+#ifdef __WIN32__
+    PostMessage (GUI.hWnd, WM_USER, NetPlay.PercentageComplete,
+                 NetPlay.PercentageComplete);
+#endif
+
+    if (t->Offset == t->Size)
+        S9xNPTransferComplete ();
+}
+
+void S9xNPUnfreezeReceivedGame (const uint8 *data, uint32 len)
+{
     //FIXME: Setting umask here wouldn't hurt.
     FILE *file;
 #ifdef HAVE_MKSTEMP
@@ -754,7 +1236,6 @@ void S9xNPGetFreezeFile (uint32 len)
         remove (fname);
     } else
         S9xNPSetError ("Unable to get name for temporary freeze file.");
-    delete[] data;
 }
 
 uint32 S9xNPGetJoypad (int which1)
@@ -777,6 +1258,8 @@ uint32 S9xNPGetJoypad (int which1)
 
 void S9xNPStepJoypadHistory ()
 {
+    S9xNPServeFreeze ();
+
     if ((NetPlay.JoypadReadInd + 1) % NP_JOYPAD_HIST_SIZE != NetPlay.JoypadWriteInd)
     {
         NetPlay.JoypadReadInd = (NetPlay.JoypadReadInd + 1) % NP_JOYPAD_HIST_SIZE;
@@ -787,6 +1270,9 @@ void S9xNPStepJoypadHistory ()
             printf ("*** CLIENT: client out of sync with server (%d, %d) @%ld\n", NetPlay.FrameCount, NetPlay.Frame [NetPlay.JoypadReadInd], S9xGetMilliTime () - START);
 #endif
         }
+
+        if (NetPlay.FrameCount % NP_STATE_HASH_INTERVAL == 0)
+            S9xNPSendStateHash ();
     }
     else
     {
@@ -815,6 +1301,10 @@ bool8 S9xNPSendJoypadUpdate (uint32 joypad)
     uint8 data [7];
     uint8 *ptr = data;
 
+    // Spectators (player 0) only follow the game.
+    if (!NetPlay.Player)
+        return (TRUE);
+
     *ptr++ = NP_CLNT_MAGIC;
     *ptr++ = NetPlay.MySequenceNum++;
     *ptr++ = NP_CLNT_JOYPAD;
@@ -833,6 +1323,7 @@ bool8 S9xNPSendJoypadUpdate (uint32 joypad)
 
 void S9xNPDisconnect ()
 {
+    NPRollback.Active = FALSE;
     close (NetPlay.Socket);
     NetPlay.Socket = -1;
     NetPlay.Connected = FALSE;
@@ -20,18 +20,94 @@
  * sequence_no  1
  * opcode       1 + num joypads (top 3 bits)
  * joypad data  4 * n
+ *
+ * Client to server state hash, every NP_STATE_HASH_INTERVAL frames
+ * magic        1
+ * sequence_no  1
+ * opcode       1
+ * length       4
+ * frame        4
+ * hash         8 (high word first)
+ *
+ * Rollback sessions replace the joypad updates above with inputs that are
+ * relayed to the other clients as soon as the server receives them.
+ *
+ * Client to server rollback input
+ * magic        1
+ * sequence_no  1
+ * opcode       1
+ * frame        4
+ * joypad data  2
+ *
+ * Server to client rollback input
+ * magic        1
+ * sequence_no  1
+ * opcode       1 + player index (top 3 bits)
+ * frame        4
+ * joypad data  2
+ *
+ * ROM images, S-RAM and freeze files are sent as a transfer: the server
+ * announces the content, the client answers with the offset to start from
+ * (the size if it already has content with that hash, or how much it kept
+ * of an interrupted transfer of it), and the data follows in chunks.
+ *
+ * Server to client transfer
+ * magic        1
+ * sequence_no  1
+ * opcode       1 + 0x80 if the data follows without waiting for a reply
+ * length       4
+ * kind         1 (NP_SERV_ROM_IMAGE, NP_SERV_SRAM_DATA or NP_SERV_FREEZE_FILE)
+ * size         4
+ * hash         8 (high word first)
+ * info         4 (Hi-ROM flag or freeze frame count)
+ * name         variable (ROM filename, empty otherwise)
+ *
+ * Client to server transfer reply
+ * magic        1
+ * sequence_no  1
+ * opcode       1
+ * length       4
+ * kind         1
+ * offset       4
+ *
+ * Server to client transfer data, one per NP_TRANSFER_CHUNK of content
+ * magic        1
+ * sequence_no  1
+ * opcode       1 + 0x80 if the chunk is zlib compressed
+ * length       4
+ * offset       4
+ * data         variable
  */
 
 #ifdef _DEBUG
 #define NP_DEBUG 1
 #endif
 
-#define NP_VERSION 10
+#define NP_VERSION 13
 #define NP_JOYPAD_HIST_SIZE 120
 #define NP_DEFAULT_PORT 6096
+#define NP_STATE_HASH_INTERVAL 60
+
+#define NP_ROLLBACK_FRAMES 8
+#define NP_ROLLBACK_INPUT_RING 64
+#define NP_ROLLBACK_MAX_DELAY 8
+
+#define NP_TRANSFER_CHUNK (32 * 1024)
+// Bytes of content a background transfer may send per server loop pass.
+#define NP_TRANSFER_BUDGET (4 * NP_TRANSFER_CHUNK)
 
 #define NP_MAX_CLIENTS 8
 
+// Spectators connect to the netplay port + NP_SPECTATOR_PORT_OFFSET. They get
+// the current state and then the same joypad stream as the players, but the
+// server never waits for them; one that can't keep up is dropped.
+#define NP_MAX_SPECTATORS 64
+#define NP_SPECTATOR_PORT_OFFSET 1
+
+// The server never blocks writing to a player or spectator; what a socket
+// doesn't take is queued, and a peer this far behind is dropped.
+#define NP_SEND_QUEUE_LIMIT (4 * 1024 * 1024)
+
 #define NP_SERV_MAGIC 'S'
 #define NP_CLNT_MAGIC 'C'
 
@@ -47,6 +123,9 @@
 #define NP_CLNT_LOADED_ROM 9
 #define NP_CLNT_RECEIVED_ROM_IMAGE 10
 #define NP_CLNT_WAITING_FOR_ROM_IMAGE 11
+#define NP_CLNT_STATE_HASH 12
+#define NP_CLNT_ROLLBACK_INPUT 13
+#define NP_CLNT_TRANSFER 14
 
 #define NP_SERV_HELLO 0
 #define NP_SERV_JOYPAD 1
@@ -59,6 +138,29 @@
 #define NP_SERV_READY 8
 // ...
 #define NP_SERV_JOYPAD_SWAP 12
+#define NP_SERV_ROLLBACK_INPUT 13
+#define NP_SERV_TRANSFER 14
+#define NP_SERV_TRANSFER_DATA 15
+
+struct SNPTransfer
+{
+    bool8  Active;
+    bool8  Acked;           // client told us where to start
+    uint8  Kind;
+    uint8  *Data;
+    uint32 Size;
+    uint32 Offset;          // bytes sent (server) or received (client)
+    uint64 Hash;
+    uint32 Info;
+    char   *Name;
+};
+
+struct SNPSendQueue
+{
+    uint8  *Data;           // data not yet accepted by the socket
+    uint32 Len;
+    uint32 Size;
+};
 
 struct SNPClient
 {
@@ -72,6 +174,23 @@ struct SNPClient
     char *ROMName;
     char *HostName;
     char *Who;
+    uint32 HashFrame;
+    uint64 StateHash;
+    struct SNPTransfer Transfer;
+    struct SNPSendQueue Queue;
+};
+
+struct SNPSpectator
+{
+    uint8  SendSequenceNum;
+    bool8  Connected;
+    bool8  SaidHello;
+    int    Socket;
+    char   *HostName;
+    struct SNPSendQueue Queue;
+    uint8  Header [7];      // message header read so far
+    uint32 HeaderLen;
+    uint32 Skip;            // bytes of the current message still to drop
 };
 
 enum {
@@ -82,7 +201,8 @@ enum {
     NP_SERVER_SEND_ROM_LOAD_REQUEST_ALL,
     NP_SERVER_RESET_ALL,
     NP_SERVER_SEND_SRAM_ALL,
-    NP_SERVER_SEND_SRAM
+    NP_SERVER_SEND_SRAM,
+    NP_SERVER_SYNC_SPECTATOR
 };
 
 #define NP_MAX_TASKS 20
@@ -109,6 +229,12 @@ struct SNPServer
     uint32 Paused;
     bool8  SendROMImageOnConnect;
     bool8  SyncByReset;
+    bool8  Rollback;
+    uint8  InputDelay;
+    struct SNPSpectator Spectators [NP_MAX_SPECTATORS];
+    int    NumSpectators;
+    int    SpectatorSocket;
+    int    PollFD;
 };
 
 #define NP_MAX_ACTION_LEN 200
@@ -145,10 +271,39 @@ struct SNetPlay
     char   ActionMsg [NP_MAX_ACTION_LEN];
     char   ErrorMsg [NP_MAX_ACTION_LEN];
     char   WarningMsg [NP_MAX_ACTION_LEN];
+    bool8  Rollback;
+    bool8  RollbackCapable;    // set by frontends that call S9xNPRollbackUpdate
+    // Kept across disconnects so a reconnect can resume an interrupted transfer.
+    struct SNPTransfer Transfer;
 };
 
 extern "C" struct SNetPlay NetPlay;
 
+// Client side of a rollback session. Remote input that has not arrived yet is
+// predicted by repeating the player's last known input; when the real input
+// turns out different, the emulator returns to the saved state of that frame
+// and runs the frames since again with video and sound suppressed.
+struct SNPRollback
+{
+    bool8  Active;
+    volatile bool8 Resimulating;
+    uint32 InputDelay;
+    uint32 StartFrame;      // input for frames before StartFrame + InputDelay is zero
+    uint32 Frame;           // next frame to be emulated
+    uint32 ResimFrom;       // earliest frame that ran on a wrong prediction
+    uint32 SendFrame;       // next frame local input is to be sent for
+    uint32 StateSize;
+    uint8  *States [NP_ROLLBACK_FRAMES];
+    uint32 StateFrame [NP_ROLLBACK_FRAMES];
+    uint16 Input [NP_ROLLBACK_INPUT_RING][NP_MAX_CLIENTS];
+    uint32 InputFrame [NP_ROLLBACK_INPUT_RING][NP_MAX_CLIENTS];
+    uint16 Used [NP_ROLLBACK_INPUT_RING][NP_MAX_CLIENTS];
+    uint32 Received [NP_MAX_CLIENTS];
+    bool8  Present [NP_MAX_CLIENTS];
+};
+
+extern struct SNPRollback NPRollback;
+
 //
 // NETPLAY_CLIENT_HELLO message format:
 // header
@@ -186,6 +341,13 @@ void S9xNPStepJoypadHistory ();
 void S9xNPResetJoypadReadPos ();
 bool8 S9xNPSendReady (uint8 op = NP_CLNT_READY);
 bool8 S9xNPSendPause (bool8 pause);
+bool8 S9xNPSendStateHash ();
+
+void S9xNPRollbackReset (uint32 frame);
+void S9xNPRollbackInput (int player, uint32 frame, uint16 joypad);
+bool8 S9xNPRollbackUpdate (uint16 joypad);
+bool8 S9xNPFreezeBetweenFrames (uint8 *&data, uint32 &len);
+void S9xNPServeFreeze ();
 void S9xNPReset ();
 void S9xNPSetAction (const char *action, bool8 force = FALSE);
 void S9xNPSetError (const char *error);
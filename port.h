@@ -52,6 +52,25 @@
 #define alwaysinline  inline
 #endif
 
+// Marks everything that belongs to one emulated machine, S9X_INSTANCE_STATIC
+// for the variables that are local to a file or function. Built with
+// S9X_MULTI_INSTANCE each thread gets its own copy, so that independent
+// emulators can run side by side in one process, one per thread; otherwise
+// there is a single machine and these are plain variables. There is no
+// context to pass around, so a machine can't move to another thread.
+#if defined(S9X_MULTI_INSTANCE) && defined(__GNUC__)
+// Hidden, so that a shared library reaches them without going through the
+// dynamic linker.
+#define S9X_INSTANCE         thread_local __attribute__((visibility("hidden")))
+#define S9X_INSTANCE_STATIC  static thread_local
+#elif defined(S9X_MULTI_INSTANCE)
+#define S9X_INSTANCE         thread_local
+#define S9X_INSTANCE_STATIC  static thread_local
+#else
+#define S9X_INSTANCE
+#define S9X_INSTANCE_STATIC  static
+#endif
+
 #ifndef snes9x_types_defined
 #define snes9x_types_defined
 typedef unsigned char		bool8;
@@ -7,6 +7,8 @@
 #ifndef _PPU_H_
 #define _PPU_H_
 
+#include "statehash.h"
+
 #define FIRST_VISIBLE_LINE	1
 
 #define TILE_2BIT			0
@@ -196,8 +198,8 @@ struct SPPU
 };
 
 extern uint16				SignExtend[2];
-extern struct SPPU			PPU;
-extern struct InternalPPU	IPPU;
+extern S9X_INSTANCE struct SPPU			PPU;
+extern S9X_INSTANCE struct InternalPPU	IPPU;
 
 void S9xResetPPU (void);
 void S9xResetPPUFast (void);
@@ -367,6 +369,8 @@ static inline void REGISTER_2118 (uint8 Byte)
 	else
 		Memory.VRAM[address = (PPU.VMA.Address << 1) & 0xffff] = Byte;
 
+	S9xStateHashMarkVRAM(address);
+
 	IPPU.TileCached[TILE_2BIT][address >> 4] = FALSE;
 	IPPU.TileCached[TILE_4BIT][address >> 5] = FALSE;
 	IPPU.TileCached[TILE_8BIT][address >> 6] = FALSE;
@@ -397,6 +401,7 @@ static inline void REGISTER_2118_tile (uint8 Byte)
 	uint32 address = (((PPU.VMA.Address & ~PPU.VMA.Mask1) + (rem >> PPU.VMA.Shift) + ((rem & (PPU.VMA.FullGraphicCount - 1)) << 3)) << 1) & 0xffff;
 
 	Memory.VRAM[address] = Byte;
+	S9xStateHashMarkVRAM(address);
 
 	IPPU.TileCached[TILE_2BIT][address >> 4] = FALSE;
 	IPPU.TileCached[TILE_4BIT][address >> 5] = FALSE;
@@ -421,6 +426,7 @@ static inline void REGISTER_2118_linear (uint8 Byte)
 	uint32	address;
 
 	Memory.VRAM[address = (PPU.VMA.Address << 1) & 0xffff] = Byte;
+	S9xStateHashMarkVRAM(address);
 
 	IPPU.TileCached[TILE_2BIT][address >> 4] = FALSE;
 	IPPU.TileCached[TILE_4BIT][address >> 5] = FALSE;
@@ -474,6 +480,8 @@ static inline void REGISTER_2119 (uint8 Byte)
 	else
 		Memory.VRAM[address = ((PPU.VMA.Address << 1) + 1) & 0xffff] = Byte;
 
+	S9xStateHashMarkVRAM(address);
+
 	IPPU.TileCached[TILE_2BIT][address >> 4] = FALSE;
 	IPPU.TileCached[TILE_4BIT][address >> 5] = FALSE;
 	IPPU.TileCached[TILE_8BIT][address >> 6] = FALSE;
@@ -504,6 +512,7 @@ static inline void REGISTER_2119_tile (uint8 Byte)
 	uint32 address = ((((PPU.VMA.Address & ~PPU.VMA.Mask1) + (rem >> PPU.VMA.Shift) + ((rem & (PPU.VMA.FullGraphicCount - 1)) << 3)) << 1) + 1) & 0xffff;
 
 	Memory.VRAM[address] = Byte;
+	S9xStateHashMarkVRAM(address);
 
 	IPPU.TileCached[TILE_2BIT][address >> 4] = FALSE;
 	IPPU.TileCached[TILE_4BIT][address >> 5] = FALSE;
@@ -528,6 +537,7 @@ static inline void REGISTER_2119_linear (uint8 Byte)
 	uint32	address;
 
 	Memory.VRAM[address = ((PPU.VMA.Address << 1) + 1) & 0xffff] = Byte;
+	S9xStateHashMarkVRAM(address);
 
 	IPPU.TileCached[TILE_2BIT][address >> 4] = FALSE;
 	IPPU.TileCached[TILE_4BIT][address >> 5] = FALSE;
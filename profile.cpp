@@ -0,0 +1,411 @@
+/*****************************************************************************\
+     Snes9x - Portable Super Nintendo Entertainment System (TM) emulator.
+                This file is licensed under the Snes9x License.
+   For further information, consult the LICENSE file in the root directory.
+\*****************************************************************************/
+
+// Profiles the game's code on the S-CPU, the SA-1, the SMP and the SuperFX.
+// Each processor calls in before every instruction while it is profiled, and
+// the time since the last call is charged to the instruction that used it.
+// With a sample interval of 0 every instruction is counted and its time is
+// exact; otherwise an instruction is charged a sample, and the interval's
+// time, each time the processor's clock passes a multiple of the interval,
+// which costs less and is still fair over a long enough run.
+//
+// Time is kept in each processor's own units: master clocks for the S-CPU,
+// thirds of a master clock for the SA-1, SMP cycles for the SMP and
+// instructions for the SuperFX, which isn't timed in cycles.
+//
+// Calls are followed as well, from the call instructions and interrupts to
+// the return that takes the stack pointer back above where the callee
+// started, so time is also charged to the chain of calls that led to it.
+// That is written out in the folded format flame graph tools read.
+
+#ifdef DEBUGGER
+
+#include <algorithm>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "snes9x.h"
+#include "memmap.h"
+#include "sa1.h"
+#include "fxemu.h"
+#include "display.h"
+#include "profile.h"
+
+#define PROFILE_MAX_DEPTH	512
+
+struct profile_node
+{
+	uint32	pc;
+	uint32	parent;
+	uint64	cycles;
+};
+
+struct profile_frame
+{
+	uint32	node;
+	uint32	sp;
+};
+
+struct profile_entry
+{
+	uint32	pc;
+	uint32	count;
+	uint64	cycles;
+};
+
+struct profile_target
+{
+	uint32								*counts[256];
+	uint64								*cycles[256];
+	bool8								started;
+	bool8								pending;
+	uint32								last_pc;
+	int64								last_clock;
+	int64								next_sample;
+	uint32								current;
+	std::vector<profile_frame>			stack;
+	std::vector<profile_node>			nodes;
+	std::unordered_map<uint64, uint32>	children;
+};
+
+struct SProfile	S9xProfile = { 0, 0 };
+
+static profile_target	profile[PROFILE_TARGETS];
+
+static int32	cpu_last_v;
+static int32	cpu_line_length;
+static int64	cpu_base;
+static int32	sa1_last_cycles;
+static int64	sa1_clock;
+static int64	smp_base;
+static int64	gsu_clock;
+
+static const char	*profile_names[PROFILE_TARGETS] = { "S-CPU", "SA-1", "SMP", "GSU" };
+static const char	*profile_units[PROFILE_TARGETS] = { "master clocks", "SA-1 clocks", "SMP cycles", "instructions" };
+
+static void profile_clear (profile_target &t)
+{
+	for (int i = 0; i < 256; i++)
+	{
+		delete [] t.counts[i];
+		delete [] t.cycles[i];
+		t.counts[i] = NULL;
+		t.cycles[i] = NULL;
+	}
+
+	t.started = FALSE;
+	t.pending = FALSE;
+	t.last_pc = 0;
+	t.last_clock = 0;
+	t.next_sample = 0;
+	t.current = 0;
+	t.stack.clear();
+	t.children.clear();
+	t.nodes.clear();
+
+	// The root stands for whatever runs outside any call that was seen.
+	profile_node	root = { 0, 0, 0 };
+	t.nodes.push_back(root);
+}
+
+// Counts and times are kept in a table per bank, made when it's first used.
+static inline uint32 & profile_count (profile_target &t, uint32 pc)
+{
+	uint32	bank = (pc >> 16) & 0xff;
+
+	if (!t.counts[bank])
+		t.counts[bank] = new uint32[0x10000]();
+
+	return (t.counts[bank][pc & 0xffff]);
+}
+
+static inline uint64 & profile_cycles (profile_target &t, uint32 pc)
+{
+	uint32	bank = (pc >> 16) & 0xff;
+
+	if (!t.cycles[bank])
+		t.cycles[bank] = new uint64[0x10000]();
+
+	return (t.cycles[bank][pc & 0xffff]);
+}
+
+static uint32 profile_child (profile_target &t, uint32 parent, uint32 pc)
+{
+	uint64	key = ((uint64) parent << 24) | (pc & 0xffffff);
+
+	std::unordered_map<uint64, uint32>::iterator	it = t.children.find(key);
+	if (it != t.children.end())
+		return (it->second);
+
+	profile_node	node = { pc, parent, 0 };
+	t.nodes.push_back(node);
+	t.children[key] = (uint32) t.nodes.size() - 1;
+
+	return ((uint32) t.nodes.size() - 1);
+}
+
+static void profile_step (profile_target &t, uint32 pc, uint32 sp, int64 now, bool8 call)
+{
+	int64	interval = S9xProfile.SampleInterval;
+
+	if (!t.started)
+	{
+		t.started = TRUE;
+		t.next_sample = now + interval;
+	}
+	else
+	if (interval == 0)
+	{
+		// A reset or a loaded state can take the clock back.
+		int64	delta = std::max(now - t.last_clock, (int64) 0);
+
+		profile_cycles(t, t.last_pc) += delta;
+		t.nodes[t.current].cycles += delta;
+	}
+	else
+	if (now >= t.next_sample)
+	{
+		int64	samples = (now - t.next_sample) / interval + 1;
+
+		profile_count(t, t.last_pc) += (uint32) samples;
+		profile_cycles(t, t.last_pc) += samples * interval;
+		t.nodes[t.current].cycles += samples * interval;
+		t.next_sample += samples * interval;
+	}
+	else
+	if (now < t.last_clock)
+		t.next_sample = now + interval;
+
+	// Returning, or unwinding the stack any other way, ends the calls it
+	// passes back over.
+	while (!t.stack.empty() && sp > t.stack.back().sp)
+		t.stack.pop_back();
+
+	t.current = t.stack.empty() ? 0 : t.stack.back().node;
+
+	if (t.pending)
+	{
+		t.pending = FALSE;
+
+		if (t.stack.size() < PROFILE_MAX_DEPTH)
+		{
+			profile_frame	frame = { profile_child(t, t.current, pc), sp };
+			t.stack.push_back(frame);
+			t.current = frame.node;
+		}
+	}
+
+	if (interval == 0)
+		profile_count(t, pc)++;
+
+	t.pending = call;
+	t.last_pc = pc;
+	t.last_clock = now;
+}
+
+static inline bool8 profile_65c816_call (uint8 op)
+{
+	// JSR, JSR (a,x), JSL, BRK and COP
+	return (op == 0x20 || op == 0xfc || op == 0x22 || op == 0x00 || op == 0x02);
+}
+
+static inline bool8 profile_spc700_call (uint8 op)
+{
+	// CALL, PCALL, BRK and the TCALLs
+	return (op == 0x3f || op == 0x4f || op == 0x0f || (op & 0x0f) == 0x01);
+}
+
+void S9xProfileCPU (uint8 op)
+{
+	// CPU.Cycles goes back by a line's length at the end of each line, and
+	// lines aren't all the same length.
+	if (CPU.V_Counter != cpu_last_v)
+	{
+		int32	lines = CPU.V_Counter > cpu_last_v ? CPU.V_Counter - cpu_last_v : CPU.V_Counter + Timings.V_Max - cpu_last_v;
+
+		cpu_base += (int64) lines * cpu_line_length;
+		cpu_last_v = CPU.V_Counter;
+	}
+
+	cpu_line_length = Timings.H_Max;
+
+	profile_step(profile[PROFILE_CPU], Registers.PBPC & 0xffffff, Registers.S.W, cpu_base + CPU.Cycles, profile_65c816_call(op));
+}
+
+void S9xProfileSA1 (uint8 op)
+{
+	// So does SA1.Cycles, three times over.
+	int32	delta = SA1.Cycles - sa1_last_cycles;
+	if (delta < 0)
+		delta += Timings.H_Max * 3;
+
+	sa1_clock += delta;
+	sa1_last_cycles = SA1.Cycles;
+
+	profile_step(profile[PROFILE_SA1], SA1Registers.PBPC & 0xffffff, SA1Registers.S.W, sa1_clock, profile_65c816_call(op));
+}
+
+void S9xProfileSMP (uint16 pc, uint8 sp, uint8 op, int32 clock)
+{
+	profile_step(profile[PROFILE_SMP], pc, sp, smp_base + clock, profile_spc700_call(op));
+}
+
+// The SMP's clock is taken back by the cycles it's given to run each time.
+void S9xProfileSMPClock (int32 cycles)
+{
+	smp_base += cycles;
+}
+
+void S9xProfileGSU (uint32 pc, uint8 op)
+{
+	profile_step(profile[PROFILE_GSU], pc, 0, ++gsu_clock, FALSE);
+}
+
+// Interrupts are followed like calls.
+void S9xProfileInterrupt (int target)
+{
+	if (S9xProfile.Targets & (1 << target))
+		profile[target].pending = TRUE;
+}
+
+void S9xProfileStart (uint8 targets, uint32 interval)
+{
+	S9xProfileStop();
+
+	for (int i = 0; i < PROFILE_TARGETS; i++)
+		profile_clear(profile[i]);
+
+	cpu_last_v = CPU.V_Counter;
+	cpu_line_length = Timings.H_Max;
+	cpu_base = 0;
+	sa1_last_cycles = SA1.Cycles;
+	sa1_clock = 0;
+	smp_base = 0;
+	gsu_clock = 0;
+
+	S9xProfile.SampleInterval = interval;
+	S9xProfile.Targets = targets;
+}
+
+void S9xProfileStop (void)
+{
+	S9xProfile.Targets = 0;
+}
+
+static std::string profile_address (int target, uint32 pc)
+{
+	char	s[16];
+
+	if (target == PROFILE_SMP)
+		sprintf(s, "$%04X", pc & 0xffff);
+	else
+		sprintf(s, "$%02X:%04X", (pc >> 16) & 0xff, pc & 0xffff);
+
+	return (s);
+}
+
+static bool profile_compare (const profile_entry &a, const profile_entry &b)
+{
+	if (a.cycles != b.cycles)
+		return (a.cycles > b.cycles);
+	if (a.count != b.count)
+		return (a.count > b.count);
+	return (a.pc < b.pc);
+}
+
+static void profile_write_report (FILE *fp, int target)
+{
+	profile_target				&t = profile[target];
+	std::vector<profile_entry>	entries;
+	uint64						total = 0;
+
+	for (int bank = 0; bank < 256; bank++)
+	{
+		if (!t.counts[bank] && !t.cycles[bank])
+			continue;
+
+		for (int i = 0; i < 0x10000; i++)
+		{
+			profile_entry	e;
+			e.pc = (bank << 16) | i;
+			e.count = t.counts[bank] ? t.counts[bank][i] : 0;
+			e.cycles = t.cycles[bank] ? t.cycles[bank][i] : 0;
+
+			if (e.count || e.cycles)
+			{
+				entries.push_back(e);
+				total += e.cycles;
+			}
+		}
+	}
+
+	if (entries.empty())
+		return;
+
+	std::sort(entries.begin(), entries.end(), profile_compare);
+
+	if (S9xProfile.SampleInterval)
+		fprintf(fp, "%s, one sample every %u %s, %llu in all\n\n", profile_names[target], S9xProfile.SampleInterval, profile_units[target], (unsigned long long) total);
+	else
+		fprintf(fp, "%s, every instruction, %llu %s in all\n\n", profile_names[target], (unsigned long long) total, profile_units[target]);
+
+	fprintf(fp, "  Address       %s            Time       %%\n", S9xProfile.SampleInterval ? "Samples" : "  Count");
+
+	for (size_t i = 0; i < entries.size(); i++)
+		fprintf(fp, "%9s  %12u  %14llu  %6.2f\n", profile_address(target, entries[i].pc).c_str(), entries[i].count, (unsigned long long) entries[i].cycles,
+			total ? entries[i].cycles * 100.0 / total : 0.0);
+
+	fprintf(fp, "\n");
+}
+
+static void profile_write_folded (FILE *fp, int target)
+{
+	profile_target	&t = profile[target];
+
+	for (size_t i = 0; i < t.nodes.size(); i++)
+	{
+		if (t.nodes[i].cycles == 0)
+			continue;
+
+		std::string	stack;
+
+		for (uint32 n = (uint32) i; n != 0; n = t.nodes[n].parent)
+			stack = ";" + profile_address(target, t.nodes[n].pc) + stack;
+
+		fprintf(fp, "%s%s %llu\n", profile_names[target], stack.c_str(), (unsigned long long) t.nodes[i].cycles);
+	}
+}
+
+// Writes the report, sorted by time, to profile.txt and the time spent in
+// each chain of calls to profile.folded, both in the log directory.
+bool8 S9xProfileWrite (void)
+{
+	std::string	dir = S9xGetDirectory(LOG_DIR) + SLASH_STR;
+
+	FILE	*report = fopen((dir + "profile.txt").c_str(), "w");
+	if (!report)
+		return (FALSE);
+
+	FILE	*folded = fopen((dir + "profile.folded").c_str(), "w");
+	if (!folded)
+	{
+		fclose(report);
+		return (FALSE);
+	}
+
+	for (int i = 0; i < PROFILE_TARGETS; i++)
+	{
+		profile_write_report(report, i);
+		profile_write_folded(folded, i);
+	}
+
+	fclose(report);
+	fclose(folded);
+
+	return (TRUE);
+}
+
+#endif
@@ -0,0 +1,41 @@
+/*****************************************************************************\
+     Snes9x - Portable Super Nintendo Entertainment System (TM) emulator.
+                This file is licensed under the Snes9x License.
+   For further information, consult the LICENSE file in the root directory.
+\*****************************************************************************/
+
+#ifdef DEBUGGER
+
+#ifndef _PROFILE_H_
+#define _PROFILE_H_
+
+enum
+{
+	PROFILE_CPU,
+	PROFILE_SA1,
+	PROFILE_SMP,
+	PROFILE_GSU,
+	PROFILE_TARGETS
+};
+
+struct SProfile
+{
+	uint8	Targets;			// bit n is set while target n is profiled
+	uint32	SampleInterval;		// 0 to count every instruction
+};
+
+extern struct SProfile	S9xProfile;
+
+void S9xProfileStart (uint8, uint32);
+void S9xProfileStop (void);
+bool8 S9xProfileWrite (void);
+void S9xProfileCPU (uint8);
+void S9xProfileSA1 (uint8);
+void S9xProfileSMP (uint16, uint8, uint8, int32);
+void S9xProfileSMPClock (int32);
+void S9xProfileGSU (uint32, uint8);
+void S9xProfileInterrupt (int);
+
+#endif
+
+#endif
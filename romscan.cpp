@@ -0,0 +1,297 @@
+/*****************************************************************************\
+     Snes9x - Portable Super Nintendo Entertainment System (TM) emulator.
+                This file is licensed under the Snes9x License.
+   For further information, consult the LICENSE file in the root directory.
+\*****************************************************************************/
+
+// Catalogs a ROM collection. The directory tree is listed first, which is
+// quick, and the files are then shared out among a pool of threads that
+// read, identify and hash them; that part is bound by decompression, hashing
+// and the disk, and scales with the number of cores. Each thread has a
+// CMemory and a ROM buffer of its own, so the game that may be running in
+// the emulator is left alone.
+//
+// The catalog is BML in the layout of the cheat database, one cartridge node
+// per ROM, keyed by the same SHA-256 the emulator computes when it loads the
+// game. Entries are written as ROMs are identified, so their order varies
+// from run to run and an interrupted scan leaves a usable catalog behind.
+
+#include <ctype.h>
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <vector>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <dirent.h>
+#include <sys/stat.h>
+#endif
+
+#include "snes9x.h"
+#include "memmap.h"
+#include "sha256.h"
+#include "checksum.h"
+#include "romscan.h"
+#ifdef JMA_SUPPORT
+#include "jma/s9x-jma.h"
+#endif
+
+struct scan_state
+{
+	std::vector<std::string>	files;
+	std::atomic<size_t>			next;
+	std::mutex					lock;
+	FILE						*catalog;
+	S9xROMScanCallback			callback;
+	void						*data;
+	int							found;
+};
+
+static const char	*rom_extensions[] =
+{
+	".sfc", ".smc", ".swc", ".fig", ".bs", ".st", ".gz",
+#ifdef UNZIP_SUPPORT
+	".zip", ".msu1",
+#endif
+#ifdef JMA_SUPPORT
+	".jma",
+#endif
+	NULL
+};
+
+static bool IsROMFile (const std::string &name)
+{
+	SplitPath	path = splitpath(name);
+
+	for (int i = 0; rom_extensions[i]; i++)
+	{
+		if (path.ext_is(rom_extensions[i]))
+			return (true);
+	}
+
+	return (false);
+}
+
+static void FindROMs (const std::string &dir, std::vector<std::string> &files)
+{
+#ifdef _WIN32
+	WIN32_FIND_DATAA	entry;
+	HANDLE				find = FindFirstFileA((dir + "\\*").c_str(), &entry);
+
+	if (find == INVALID_HANDLE_VALUE)
+		return;
+
+	do
+	{
+		std::string	name = entry.cFileName;
+		if (name == "." || name == "..")
+			continue;
+
+		if (entry.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+			FindROMs(dir + SLASH_STR + name, files);
+		else
+		if (IsROMFile(name))
+			files.push_back(dir + SLASH_STR + name);
+	} while (FindNextFileA(find, &entry));
+
+	FindClose(find);
+#else
+	DIR	*d = opendir(dir.c_str());
+	if (!d)
+		return;
+
+	struct dirent	*entry;
+
+	while ((entry = readdir(d)))
+	{
+		std::string	name = entry->d_name;
+		if (name == "." || name == "..")
+			continue;
+
+		std::string	path = dir + SLASH_STR + name;
+		struct stat	st;
+
+		// Links to directories aren't followed, which could go round in circles.
+		if (lstat(path.c_str(), &st))
+			continue;
+
+		if (S_ISDIR(st.st_mode))
+			FindROMs(path, files);
+		else
+		if ((S_ISREG(st.st_mode) || S_ISLNK(st.st_mode)) && IsROMFile(name))
+			files.push_back(path);
+	}
+
+	closedir(d);
+#endif
+}
+
+// Reads a ROM into mem.ROM the way FileLoader does, without the messages,
+// and returns its size once the copier header is removed.
+static uint32 ReadROM (CMemory &mem, const std::string &filename)
+{
+	SplitPath	path = splitpath(filename);
+
+	memset(mem.NSRTHeader, 0, sizeof(mem.NSRTHeader));
+	mem.HeaderCount = 0;
+
+#ifdef UNZIP_SUPPORT
+	if (path.ext_is(".zip") || path.ext_is(".msu1"))
+	{
+		uint32	size;
+		return (LoadZip(filename.c_str(), &size, mem.ROM, mem) ? size : 0);
+	}
+#endif
+
+#ifdef JMA_SUPPORT
+	if (path.ext_is(".jma"))
+	{
+		size_t	size = load_jma_file(filename.c_str(), mem.ROM);
+		return (size ? mem.HeaderRemove(size, mem.ROM) : 0);
+	}
+#endif
+
+	STREAM	fp = OPEN_STREAM(filename.c_str(), "rb");
+	if (!fp)
+		return (0);
+
+	uint32	size = READ_STREAM(mem.ROM, CMemory::MAX_ROM_SIZE + 0x200, fp);
+	CLOSE_STREAM(fp);
+
+	return (mem.HeaderRemove(size, mem.ROM));
+}
+
+static void WriteCatalogEntry (FILE *fp, CMemory &mem, const S9xROMScanEntry &entry)
+{
+	fprintf(fp, "cartridge sha256:");
+	for (int i = 0; i < 32; i++)
+		fprintf(fp, "%02x", entry.SHA256[i]);
+	fprintf(fp, "\n");
+
+	fprintf(fp, "  path:%s\n", entry.Path.c_str());
+	fprintf(fp, "  name:%s\n", mem.SafeString(entry.Name).c_str());
+	fprintf(fp, "  kind:%s\n", entry.Kind);
+	fprintf(fp, "  size:%u\n", entry.Size);
+	fprintf(fp, "  crc32:%08x\n", entry.CRC32);
+	fprintf(fp, "  map:%s\n", entry.HiROM ? (mem.ExtendedFormat != CMemory::NOPE ? "ExHiROM" : "HiROM") : "LoROM");
+	if (isalnum(entry.Id[0]) && isalnum(entry.Id[1]) && isalnum(entry.Id[2]) && isalnum(entry.Id[3]))
+		fprintf(fp, "  id:%s\n", entry.Id);
+	fprintf(fp, "  region:%d\n", entry.Region);
+	fprintf(fp, "  type:%02x\n", entry.Type);
+	fprintf(fp, "  speed:%02x\n", entry.Speed);
+	fprintf(fp, "  company:%d\n", entry.CompanyId);
+	fprintf(fp, "  checksum:%04x\n", entry.Checksum);
+	if (entry.Headered)
+		fprintf(fp, "  headered\n");
+	fprintf(fp, "\n");
+}
+
+static void ScanWorker (scan_state *state)
+{
+	CMemory	*mem = new CMemory();
+	uint8	*buffer = S9xAllocLazy(mem->ROM_STORAGE_SIZE);
+	uint32	dirty = 0;
+
+	if (!buffer)
+	{
+		delete mem;
+		return;
+	}
+
+	// Same offset as Memory.ROM, for ROMs that are read past their end.
+	mem->ROM = buffer + 0x8000;
+
+	for (size_t i; (i = state->next++) < state->files.size(); )
+	{
+		// Headers are scored from whatever follows a small ROM, which has
+		// to be zeroes as it is for a loaded game.
+		memset(mem->ROM, 0, dirty);
+
+		S9xROMScanEntry	entry;
+		uint32			size = ReadROM(*mem, state->files[i]);
+
+		// Moving a copier header out of the way, here and in IdentifyROM,
+		// leaves its old place past the end. A failed read may have left
+		// anything anywhere.
+		dirty = size ? std::min(size + 0x400, (uint32) CMemory::MAX_ROM_SIZE + 0x200) : CMemory::MAX_ROM_SIZE + 0x200;
+
+		if (size == 0 || size > CMemory::MAX_ROM_SIZE)
+			continue;
+
+		int32	headers = mem->HeaderCount;
+
+		entry.Kind = mem->IdentifyROM(size);
+		entry.Path = state->files[i];
+		entry.Size = mem->HeaderCount > headers ? size - 0x200 : size;
+		entry.Headered = mem->HeaderCount != 0;
+		entry.HiROM = mem->HiROM;
+		entry.Region = mem->ROMRegion;
+		entry.Type = mem->ROMType;
+		entry.Speed = mem->ROMSpeed;
+		entry.CompanyId = mem->CompanyId;
+		entry.Checksum = mem->ROMChecksum;
+		memcpy(entry.Name, mem->ROMName, ROM_NAME_LEN);
+		memcpy(entry.Id, mem->ROMId, 4);
+		entry.Id[4] = 0;
+
+		// Hashed like InitROM does, over the size rounded up to 8KB.
+		entry.CRC32 = caCRC32(mem->ROM, mem->CalculatedSize);
+		sha256sum(mem->ROM, mem->CalculatedSize, entry.SHA256);
+
+		std::lock_guard<std::mutex>	guard(state->lock);
+
+		if (state->catalog)
+		{
+			WriteCatalogEntry(state->catalog, *mem, entry);
+			fflush(state->catalog);
+		}
+
+		if (state->callback)
+			state->callback(entry, state->data);
+
+		state->found++;
+	}
+
+	S9xFreeLazy(buffer, mem->ROM_STORAGE_SIZE);
+	delete mem;
+}
+
+// Catalogs every ROM under dir, in any zip or JMA archives the build can
+// read too, using the given number of threads, or one per core if that's 0.
+// catalog names the file to write, or is NULL to only report ROMs through
+// the callback. Returns how many were found, or -1 if the catalog couldn't
+// be created.
+int S9xScanROMs (const char *dir, const char *catalog, int threads, S9xROMScanCallback callback, void *data)
+{
+	scan_state	state;
+
+	state.next = 0;
+	state.catalog = NULL;
+	state.callback = callback;
+	state.data = data;
+	state.found = 0;
+
+	if (catalog && !(state.catalog = fopen(catalog, "w")))
+		return (-1);
+
+	FindROMs(dir, state.files);
+
+	if (threads <= 0)
+		threads = std::max(1u, std::thread::hardware_concurrency());
+	threads = (int) std::min((size_t) threads, std::max((size_t) 1, state.files.size()));
+
+	std::vector<std::thread>	pool;
+
+	for (int i = 0; i < threads; i++)
+		pool.push_back(std::thread(ScanWorker, &state));
+
+	for (size_t i = 0; i < pool.size(); i++)
+		pool[i].join();
+
+	if (state.catalog)
+		fclose(state.catalog);
+
+	return (state.found);
+}
@@ -0,0 +1,36 @@
+/*****************************************************************************\
+     Snes9x - Portable Super Nintendo Entertainment System (TM) emulator.
+                This file is licensed under the Snes9x License.
+   For further information, consult the LICENSE file in the root directory.
+\*****************************************************************************/
+
+#ifndef _ROMSCAN_H_
+#define _ROMSCAN_H_
+
+#include <string>
+
+struct S9xROMScanEntry
+{
+	std::string	Path;
+	const char	*Kind;			// "Game", "BS-X slotted", "Sufami Turbo"...
+	uint32		Size;			// without copier header
+	uint32		CRC32;
+	uint8		SHA256[32];
+	char		Name[ROM_NAME_LEN];
+	char		Id[5];
+	bool8		HiROM;
+	bool8		Headered;
+	uint8		Region;
+	uint8		Type;
+	uint8		Speed;
+	int32		CompanyId;
+	uint32		Checksum;
+};
+
+// Called once for every ROM found, from whichever thread read it, but never
+// from two threads at the same time.
+typedef void (*S9xROMScanCallback) (const S9xROMScanEntry &, void *);
+
+int S9xScanROMs (const char *, const char *, int, S9xROMScanCallback callback = NULL, void *data = NULL);
+
+#endif
@@ -6,8 +6,9 @@
 
 #include "snes9x.h"
 #include "memmap.h"
+#include "tile.h"
 
-uint8	SA1OpenBus;
+S9X_INSTANCE uint8	SA1OpenBus;
 
 static void S9xSA1SetBWRAMMemMap (uint8);
 static void S9xSetSA1MemMap (uint32, uint8);
@@ -615,61 +616,9 @@ static void S9xSA1CharConv2 (void)
 	uint8	*p             = &Memory.FillRAM[0x3000] + (dest & 0x7ff) + offset * bytes_per_char;
 	uint8	*q             = &Memory.ROM[CMemory::MAX_ROM_SIZE - 0x10000] + offset * 64;
 
-	switch (depth)
-	{
-		case 2:
-			for (int l = 0; l < 8; l++, q += 8)
-			{
-				for (int b = 0; b < 8; b++)
-				{
-					uint8	r = *(q + b);
-					*(p +  0) = (*(p +  0) << 1) | ((r >> 0) & 1);
-					*(p +  1) = (*(p +  1) << 1) | ((r >> 1) & 1);
-				}
-
-				p += 2;
-			}
-
-			break;
-
-		case 4:
-			for (int l = 0; l < 8; l++, q += 8)
-			{
-				for (int b = 0; b < 8; b++)
-				{
-					uint8	r = *(q + b);
-					*(p +  0) = (*(p +  0) << 1) | ((r >> 0) & 1);
-					*(p +  1) = (*(p +  1) << 1) | ((r >> 1) & 1);
-					*(p + 16) = (*(p + 16) << 1) | ((r >> 2) & 1);
-					*(p + 17) = (*(p + 17) << 1) | ((r >> 3) & 1);
-				}
-
-				p += 2;
-			}
-
-			break;
-
-		case 8:
-			for (int l = 0; l < 8; l++, q += 8)
-			{
-				for (int b = 0; b < 8; b++)
-				{
-					uint8	r = *(q + b);
-					*(p +  0) = (*(p +  0) << 1) | ((r >> 0) & 1);
-					*(p +  1) = (*(p +  1) << 1) | ((r >> 1) & 1);
-					*(p + 16) = (*(p + 16) << 1) | ((r >> 2) & 1);
-					*(p + 17) = (*(p + 17) << 1) | ((r >> 3) & 1);
-					*(p + 32) = (*(p + 32) << 1) | ((r >> 4) & 1);
-					*(p + 33) = (*(p + 33) << 1) | ((r >> 5) & 1);
-					*(p + 48) = (*(p + 48) << 1) | ((r >> 6) & 1);
-					*(p + 49) = (*(p + 49) << 1) | ((r >> 7) & 1);
-				}
-
-				p += 2;
-			}
-
-			break;
-	}
+	// A row of the buffer has a byte for each pixel, whatever the depth.
+	for (int l = 0; l < 8; l++, q += 8, p += 2)
+		S9xStorePlanarRow(p, S9xPlanarRow(S9xChunkyRow(q, 8)), depth);
 }
 
 static void S9xSA1DMA (void)
@@ -758,6 +707,29 @@ static void S9xSA1ReadVariableLengthData (bool8 inc, bool8 no_shift)
 	}
 }
 
+// The bitmap views of BW-RAM have a byte of address space for each pixel, of
+// which there are four to a byte of BW-RAM in 2bpp format and two in 4bpp.
+// shift is the log2 of that, worked out from the depth without a branch.
+static inline uint8 S9xSA1GetBitmapPixel (uint8 *bwram, uint32 pixel)
+{
+	uint32	bits  = SA1.VirtualBitmapFormat;
+	uint32	shift = 3 - (bits >> 1);
+	uint32	pos   = (pixel & ((1 << shift) - 1)) * bits;
+
+	return ((bwram[(pixel >> shift) & 0x3ffff] >> pos) & ((1 << bits) - 1));
+}
+
+static inline void S9xSA1SetBitmapPixel (uint8 *bwram, uint32 pixel, uint8 byte)
+{
+	uint32	bits  = SA1.VirtualBitmapFormat;
+	uint32	shift = 3 - (bits >> 1);
+	uint32	pos   = (pixel & ((1 << shift) - 1)) * bits;
+	uint32	mask  = ((1 << bits) - 1) << pos;
+	uint8	*ptr  = &bwram[(pixel >> shift) & 0x3ffff];
+
+	*ptr = (*ptr & ~mask) | ((byte << pos) & mask);
+}
+
 uint8 S9xSA1GetByte (uint32 address)
 {
 	uint8	*GetAddress = SA1.Map[(address & 0xffffff) >> MEMMAP_SHIFT];
@@ -787,20 +759,12 @@ uint8 S9xSA1GetByte (uint32 address)
 		case CMemory::MAP_BWRAM_BITMAP:
 			SA1.Cycles += ONE_CYCLE * 2;
 
-			address -= 0x600000;
-			if (SA1.VirtualBitmapFormat == 2)
-				return ((Memory.SRAM[(address >> 2) & 0x3ffff] >> ((address & 3) << 1)) &  3);
-			else
-				return ((Memory.SRAM[(address >> 1) & 0x3ffff] >> ((address & 1) << 2)) & 15);
+			return (S9xSA1GetBitmapPixel(Memory.SRAM, address - 0x600000));
 
 		case CMemory::MAP_BWRAM_BITMAP2:
 			SA1.Cycles += ONE_CYCLE * 2;
 
-			address = (address & 0xffff) - 0x6000;
-			if (SA1.VirtualBitmapFormat == 2)
-				return ((SA1.BWRAM[(address >> 2) & 0x3ffff] >> ((address & 3) << 1)) &  3);
-			else
-				return ((SA1.BWRAM[(address >> 1) & 0x3ffff] >> ((address & 1) << 2)) & 15);
+			return (S9xSA1GetBitmapPixel(SA1.BWRAM, (address & 0xffff) - 0x6000));
 
 		default:
 			SA1.Cycles += ONE_CYCLE;
@@ -859,37 +823,11 @@ void S9xSA1SetByte (uint8 byte, uint32 address)
 			return;
 
 		case CMemory::MAP_BWRAM_BITMAP:
-			address -= 0x600000;
-			if (SA1.VirtualBitmapFormat == 2)
-			{
-				uint8	*ptr = &Memory.SRAM[(address >> 2) & 0x3ffff];
-				*ptr &= ~(3  << ((address & 3) << 1));
-				*ptr |= (byte &  3) << ((address & 3) << 1);
-			}
-			else
-			{
-				uint8	*ptr = &Memory.SRAM[(address >> 1) & 0x3ffff];
-				*ptr &= ~(15 << ((address & 1) << 2));
-				*ptr |= (byte & 15) << ((address & 1) << 2);
-			}
-
+			S9xSA1SetBitmapPixel(Memory.SRAM, address - 0x600000, byte);
 			return;
 
 		case CMemory::MAP_BWRAM_BITMAP2:
-			address = (address & 0xffff) - 0x6000;
-			if (SA1.VirtualBitmapFormat == 2)
-			{
-				uint8	*ptr = &SA1.BWRAM[(address >> 2) & 0x3ffff];
-				*ptr &= ~(3  << ((address & 3) << 1));
-				*ptr |= (byte &  3) << ((address & 3) << 1);
-			}
-			else
-			{
-				uint8	*ptr = &SA1.BWRAM[(address >> 1) & 0x3ffff];
-				*ptr &= ~(15 << ((address & 1) << 2));
-				*ptr |= (byte & 15) << ((address & 1) << 2);
-			}
-
+			S9xSA1SetBitmapPixel(SA1.BWRAM, (address & 0xffff) - 0x6000, byte);
 			return;
 
 		default:
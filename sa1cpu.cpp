@@ -160,6 +160,11 @@ void S9xSA1MainLoop (void)
 			Opcodes = S9xSA1OpcodesSlow;
 		}
 
+	#ifdef DEBUGGER
+		if (S9xProfile.Targets & (1 << PROFILE_SA1))
+			S9xProfileSA1(Op);
+	#endif
+
 		Registers.PCw++;
 		(*Opcodes[Op].S9xOpcode)();
 	}
@@ -4,11 +4,30 @@
    For further information, consult the LICENSE file in the root directory.
 \*****************************************************************************/
 
+#include <unordered_map>
+#include <vector>
 #include "snes9x.h"
 #include "memmap.h"
 #include "sdd1.h"
+#include "sdd1emu.h"
 #include "display.h"
 
+// Games DMA the same compressed graphics over and over, so what each block
+// decompressed to is kept, along with the compressed bytes it came from.
+// Those are compared on every hit, which is much quicker than decoding them
+// again and catches anything that changed the source since: a cheat, a new
+// ROM, or a DMA from RAM.
+struct sdd1_block
+{
+	std::vector<uint8>	in;
+	std::vector<uint8>	out;
+};
+
+static const size_t	sdd1_cache_limit = 16 << 20;
+
+S9X_INSTANCE_STATIC std::unordered_map<const uint8 *, sdd1_block>	sdd1_cache;
+S9X_INSTANCE_STATIC size_t	sdd1_cache_size = 0;
+
 
 void S9xSetSDD1MemoryMap (uint32 bank, uint32 value)
 {
@@ -25,6 +44,9 @@ void S9xSetSDD1MemoryMap (uint32 bank, uint32 value)
 
 void S9xResetSDD1 (void)
 {
+	sdd1_cache.clear();
+	sdd1_cache_size = 0;
+
 	memset(&Memory.FillRAM[0x4800], 0, 4);
 	for (int i = 0; i < 4; i++)
 	{
@@ -38,3 +60,37 @@ void S9xSDD1PostLoadState (void)
 	for (int i = 0; i < 4; i++)
 		S9xSetSDD1MemoryMap(i, Memory.FillRAM[0x4804 + i]);
 }
+
+// Decompresses len bytes, or 0x10000 if len is 0, from in and returns where
+// they are, which stays good until the next call.
+uint8 * S9xSDD1Decompress (uint8 *in, int len)
+{
+	uint32	size = len ? len : 0x10000;
+
+	std::unordered_map<const uint8 *, sdd1_block>::iterator	i = sdd1_cache.find(in);
+	if (i != sdd1_cache.end())
+	{
+		sdd1_block	&block = i->second;
+
+		// A shorter transfer of the same block is the start of a longer one.
+		if (block.out.size() >= size && memcmp(&block.in[0], in, block.in.size()) == 0)
+			return (&block.out[0]);
+
+		sdd1_cache_size -= block.in.size() + block.out.size();
+		sdd1_cache.erase(i);
+	}
+
+	if (sdd1_cache_size >= sdd1_cache_limit)
+	{
+		sdd1_cache.clear();
+		sdd1_cache_size = 0;
+	}
+
+	sdd1_block	&block = sdd1_cache[in];
+
+	block.out.resize(size);
+	block.in.assign(in, in + SDD1_decompress(&block.out[0], in, len));
+	sdd1_cache_size += block.in.size() + block.out.size();
+
+	return (&block.out[0]);
+}
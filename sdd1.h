@@ -10,5 +10,6 @@
 void S9xSetSDD1MemoryMap (uint32, uint32);
 void S9xResetSDD1 (void);
 void S9xSDD1PostLoadState (void);
+uint8 * S9xSDD1Decompress (uint8 *, int);
 
 #endif
@@ -22,17 +22,6 @@
 #include "port.h"
 #include "sdd1emu.h"
 
-static int valid_bits;
-static uint16 in_stream;
-static uint8 *in_buf;
-static uint8 bit_ctr[8];
-static uint8 context_states[32];
-static int context_MPS[32];
-static int bitplane_type;
-static int high_context_bits;
-static int low_context_bits;
-static int prev_bits[8];
-
 static struct {
     uint8 code_size;
     uint8 MPS_next;
@@ -85,127 +74,145 @@ static uint8 run_table[128] = {
     113,  49,  81,  17,  97,  33,  65,   1
 };
 
-static inline uint8 GetCodeword(int bits){
-    uint8 tmp;
+/* The decoder state lives on the stack for the length of one call, where
+ * the compiler can keep it in registers, rather than in globals that every
+ * write to the output would force it to reload. */
+struct SDD1Decoder {
+    int valid_bits;
+    uint32 in_stream;
+    const uint8 *in_buf;
+    uint8 bit_ctr[8];
+    uint8 context_states[32];
+    uint8 context_MPS[32];
+    int high_context_bits;
+    int low_context_bits;
+    int prev_bits[8];
 
-    if(!valid_bits){
-        in_stream|=*(in_buf++);
-        valid_bits=8;
-    }
-    in_stream<<=1;
-    valid_bits--;
-    in_stream^=0x8000;
-    if(in_stream&0x8000) return 0x80+(1<<bits);
-    tmp=(in_stream>>8) | (0x7f>>bits);
-    in_stream<<=bits;
-    valid_bits-=bits;
-    if(valid_bits<0){
-        in_stream |= (*(in_buf++))<<(-valid_bits);
-        valid_bits+=8;
+    /* Unread input, left-aligned, valid_bits of it. A byte is fetched
+     * whenever the longest codeword of this size might not fit in what is
+     * left, so this can read one byte past the end of the compressed data.
+     * That byte is still inside the ROM buffer, which has room after any
+     * image, and counts towards the input the S-DD1 cache checks. */
+    inline uint8 GetCodeword(int bits){
+        if(valid_bits<=bits){
+            in_stream|=(uint32)*(in_buf++)<<(24-valid_bits);
+            valid_bits+=8;
+        }
+        uint32 lead=in_stream;
+        if(!(lead&0x80000000)){
+            in_stream<<=1;
+            valid_bits--;
+            return 0x80+(1<<bits);
+        }
+        in_stream<<=1+bits;
+        valid_bits-=1+bits;
+        /* The run length, from the codeword's bits with ones below. */
+        return run_table[((lead>>24)&0x7f) | (0x7f>>bits)];
     }
-    return run_table[tmp];
-}
 
-static inline uint8 GolombGetBit(int code_size){
-    if(!bit_ctr[code_size]) bit_ctr[code_size]=GetCodeword(code_size);
-    bit_ctr[code_size]--;
-    if(bit_ctr[code_size]==0x80){
-        bit_ctr[code_size]=0;
-        return 2; /* secret code for 'last zero'. ones are always last. */
+    inline uint8 GolombGetBit(int code_size){
+        if(!bit_ctr[code_size]) bit_ctr[code_size]=GetCodeword(code_size);
+        bit_ctr[code_size]--;
+        if(bit_ctr[code_size]==0x80){
+            bit_ctr[code_size]=0;
+            return 2; /* secret code for 'last zero'. ones are always last. */
+        }
+        return (bit_ctr[code_size]==0)?1:0;
     }
-    return (bit_ctr[code_size]==0)?1:0;
-}
 
-static inline uint8 ProbGetBit(uint8 context){
-    uint8 state=context_states[context];
-    uint8 bit=GolombGetBit(evolution_table[state].code_size);
+    inline uint8 ProbGetBit(uint8 context){
+        uint8 state=context_states[context];
+        uint8 bit=GolombGetBit(evolution_table[state].code_size);
 
-    if(bit&1){
-        context_states[context]=evolution_table[state].LPS_next;
-        if(state<2){
-            context_MPS[context]^=1;
-            return context_MPS[context]; /* just inverted, so just return it */
-        } else{
-            return context_MPS[context]^1; /* we know bit is 1, so use a constant */
+        if(bit&1){
+            context_states[context]=evolution_table[state].LPS_next;
+            if(state<2){
+                context_MPS[context]^=1;
+                return context_MPS[context]; /* just inverted, so just return it */
+            } else{
+                return context_MPS[context]^1; /* we know bit is 1, so use a constant */
+            }
+        } else if(bit){
+            context_states[context]=evolution_table[state].MPS_next;
+            /* zero here, zero there, no difference so drop through. */
         }
-    } else if(bit){
-        context_states[context]=evolution_table[state].MPS_next;
-        /* zero here, zero there, no difference so drop through. */
+        return context_MPS[context]; /* we know bit is 0, so don't bother xoring */
     }
-    return context_MPS[context]; /* we know bit is 0, so don't bother xoring */
-}
 
-static inline uint8 GetBit(uint8 cur_bitplane){
-    uint8 bit;
+    inline uint8 GetBit(uint8 cur_bitplane){
+        uint8 bit;
 
-    bit=ProbGetBit(((cur_bitplane&1)<<4)
-                   | ((prev_bits[cur_bitplane]&high_context_bits)>>5)
-                   | (prev_bits[cur_bitplane]&low_context_bits));
+        bit=ProbGetBit(((cur_bitplane&1)<<4)
+                       | ((prev_bits[cur_bitplane]&high_context_bits)>>5)
+                       | (prev_bits[cur_bitplane]&low_context_bits));
 
-    prev_bits[cur_bitplane] <<= 1;
-    prev_bits[cur_bitplane] |= bit;
-    return bit;
-}
+        prev_bits[cur_bitplane] <<= 1;
+        prev_bits[cur_bitplane] |= bit;
+        return bit;
+    }
+};
 
-void SDD1_decompress(uint8 *out, uint8 *in, int len){
+int SDD1_decompress(uint8 *out, uint8 *in, int len){
     uint8 bit, i, plane;
     uint8 byte1, byte2;
+    SDD1Decoder d;
 
     if(len==0) len=0x10000;
 
-    bitplane_type=in[0]>>6;
+    int bitplane_type=in[0]>>6;
 
     switch(in[0]&0x30){
       case 0x00:
-        high_context_bits=0x01c0;
-        low_context_bits =0x0001;
+        d.high_context_bits=0x01c0;
+        d.low_context_bits =0x0001;
         break;
       case 0x10:
-        high_context_bits=0x0180;
-        low_context_bits =0x0001;
+        d.high_context_bits=0x0180;
+        d.low_context_bits =0x0001;
         break;
       case 0x20:
-        high_context_bits=0x00c0;
-        low_context_bits =0x0001;
+        d.high_context_bits=0x00c0;
+        d.low_context_bits =0x0001;
         break;
       case 0x30:
-        high_context_bits=0x0180;
-        low_context_bits =0x0003;
+      default:
+        d.high_context_bits=0x0180;
+        d.low_context_bits =0x0003;
         break;
     }
 
-    in_stream=(in[0]<<11) | (in[1]<<3);
-    valid_bits=5;
-    in_buf=in+2;
-    memset(bit_ctr, 0, sizeof(bit_ctr));
-    memset(context_states, 0, sizeof(context_states));
-    memset(context_MPS, 0, sizeof(context_MPS));
-    memset(prev_bits, 0, sizeof(prev_bits));
+    d.in_stream=(uint32)in[0]<<28;
+    d.valid_bits=4;
+    d.in_buf=in+1;
+    memset(d.bit_ctr, 0, sizeof(d.bit_ctr));
+    memset(d.context_states, 0, sizeof(d.context_states));
+    memset(d.context_MPS, 0, sizeof(d.context_MPS));
+    memset(d.prev_bits, 0, sizeof(d.prev_bits));
 
     switch(bitplane_type){
       case 0:
         while(1) {
             for(byte1=byte2=0, bit=0x80; bit; bit>>=1){
-                if(GetBit(0)) byte1 |= bit;
-                if(GetBit(1)) byte2 |= bit;
+                if(d.GetBit(0)) byte1 |= bit;
+                if(d.GetBit(1)) byte2 |= bit;
             }
             *(out++)=byte1;
-            if(!--len) return;
+            if(!--len) return d.in_buf-in;
             *(out++)=byte2;
-            if(!--len) return;
+            if(!--len) return d.in_buf-in;
         }
         break;
       case 1:
         i=plane=0;
         while(1) {
             for(byte1=byte2=0, bit=0x80; bit; bit>>=1){
-                if(GetBit(plane)) byte1 |= bit;
-                if(GetBit(plane+1)) byte2 |= bit;
+                if(d.GetBit(plane)) byte1 |= bit;
+                if(d.GetBit(plane+1)) byte2 |= bit;
             }
             *(out++)=byte1;
-            if(!--len) return;
+            if(!--len) return d.in_buf-in;
             *(out++)=byte2;
-            if(!--len) return;
+            if(!--len) return d.in_buf-in;
             if(!(i+=32)) plane = (plane+2)&7;
         }
         break;
@@ -213,31 +220,32 @@ void SDD1_decompress(uint8 *out, uint8 *in, int len){
         i=plane=0;
         while(1) {
             for(byte1=byte2=0, bit=0x80; bit; bit>>=1){
-                if(GetBit(plane)) byte1 |= bit;
-                if(GetBit(plane+1)) byte2 |= bit;
+                if(d.GetBit(plane)) byte1 |= bit;
+                if(d.GetBit(plane+1)) byte2 |= bit;
             }
             *(out++)=byte1;
-            if(!--len) return;
+            if(!--len) return d.in_buf-in;
             *(out++)=byte2;
-            if(!--len) return;
+            if(!--len) return d.in_buf-in;
             if(!(i+=32)) plane ^= 2;
         }
         break;
       case 3:
         do {
             for(byte1=plane=0, bit=1; bit; bit<<=1, plane++){
-                if(GetBit(plane)) byte1 |= bit;
+                if(d.GetBit(plane)) byte1 |= bit;
             }
             *(out++)=byte1;
         } while(--len);
         break;
     }
+    return d.in_buf-in;
 }
 
 #if 0
-static uint8 cur_plane;
-static uint8 num_bits;
-static uint8 next_byte;
+S9X_INSTANCE_STATIC uint8 cur_plane;
+S9X_INSTANCE_STATIC uint8 num_bits;
+S9X_INSTANCE_STATIC uint8 next_byte;
 
 void SDD1_init(uint8 *in){
     bitplane_type=in[0]>>6;
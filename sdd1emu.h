@@ -7,6 +7,7 @@
 #ifndef _SDD1EMU_H_
 #define _SDD1EMU_H_
 
-void SDD1_decompress (uint8 *, uint8 *, int);
+// Returns how many bytes of compressed input the output took.
+int SDD1_decompress (uint8 *, uint8 *, int);
 
 #endif
@@ -34,6 +34,7 @@
 	#include <sys/time.h>
 
 	#include <netdb.h>
+	#include <sys/ioctl.h>
 	#include <sys/socket.h>
 	#include <sys/param.h>
 	#include <netinet/in.h>
@@ -44,11 +45,17 @@
 		#include <sys/stropts.h>
 	#endif
 
+	#ifdef __linux__
+		#include <sys/epoll.h>
+		#define NP_USE_EPOLL
+	#endif
+
 #endif // !__WIN32__
 
 #include "memmap.h"
 #include "snapshot.h"
 #include "netplay.h"
+#include "statehash.h"
 
 #ifdef __WIN32__
 #define NP_ONE_CLIENT 1
@@ -61,8 +68,14 @@ struct SNPServer NPServer;
 extern unsigned long START;
 
 void S9xNPSendToAllClients (uint8 *data, int len);
+void S9xNPProcessClient (int c);
+void S9xNPAcceptClient (int Listen, bool8 block);
 bool8 S9xNPLoadFreezeFile (const char *fname, uint8 *&data, uint32 &len);
 void S9xNPSendFreezeFile (int c, uint8 *data, uint32 len);
+bool8 S9xNPBeginTransfer (int c, uint8 kind, const uint8 *data, uint32 size, uint32 info, const char *name, bool8 push);
+bool8 S9xNPSendTransferData (int c, uint32 budget);
+void S9xNPFinishTransfer (int c);
+void S9xNPEndTransfer (struct SNPTransfer *t);
 void S9xNPNoClientReady (int start_index = NP_ONE_CLIENT);
 void S9xNPRecomputePause ();
 void S9xNPWaitForEmulationToComplete ();
@@ -74,6 +87,120 @@ void S9xNPSyncClient (int);
 void S9xNPSendROMLoadRequest (const char *filename);
 void S9xNPSendFreezeFileToAllClients (const char *filename);
 void S9xNPStopServer ();
+void S9xNPRelayRollbackInput (int c, uint32 frame, const uint8 *joypad);
+void S9xNPSendToSpectators (uint8 *data, int len);
+void S9xNPSendFreezeFileToSpectator (int s, uint8 *data, uint32 len);
+void S9xNPSyncSpectator (int s);
+void S9xNPShutdownSpectator (int s, const char *reason);
+
+// What a socket registered with the poller is; packed with the array index
+// into the epoll event data.
+enum
+{
+    NP_POLL_LISTEN,
+    NP_POLL_SPECTATOR_LISTEN,
+    NP_POLL_CLIENT,
+    NP_POLL_SPECTATOR
+};
+
+static void S9xNPPollAdd (int fd, int type, int index)
+{
+#ifdef NP_USE_EPOLL
+    struct epoll_event ev;
+
+    memset (&ev, 0, sizeof (ev));
+    ev.events = EPOLLIN;
+    ev.data.u32 = (type << 16) | index;
+    epoll_ctl (NPServer.PollFD, EPOLL_CTL_ADD, fd, &ev);
+#endif
+}
+
+static void S9xNPPollWatchOutput (int fd, int type, int index, bool8 watch)
+{
+#ifdef NP_USE_EPOLL
+    struct epoll_event ev;
+
+    memset (&ev, 0, sizeof (ev));
+    ev.events = EPOLLIN | (watch ? (uint32_t) EPOLLOUT : 0u);
+    ev.data.u32 = (type << 16) | index;
+    epoll_ctl (NPServer.PollFD, EPOLL_CTL_MOD, fd, &ev);
+#endif
+}
+
+static void S9xNPPollRemove (int fd)
+{
+#ifdef NP_USE_EPOLL
+    struct epoll_event ev;
+
+    epoll_ctl (NPServer.PollFD, EPOLL_CTL_DEL, fd, &ev);
+#endif
+}
+
+// Writes as much of the queue as the socket takes without blocking; FALSE if
+// the peer has gone.
+static bool8 S9xNPFlushQueue (int fd, struct SNPSendQueue *q)
+{
+    uint32 done = 0;
+    bool8 ok = TRUE;
+
+    while (done < q->Len)
+    {
+        int sent = write (fd, (char *) q->Data + done, q->Len - done);
+
+        if (sent < 0 && (errno == EINTR
+#ifdef EAGAIN
+            || errno == EAGAIN
+#endif
+#ifdef EWOULDBLOCK
+            || errno == EWOULDBLOCK
+#endif
+            ))
+            break;
+
+        if (sent <= 0)
+        {
+            ok = FALSE;
+            break;
+        }
+
+        done += sent;
+    }
+
+    memmove (q->Data, q->Data + done, q->Len - done);
+    q->Len -= done;
+
+    return (ok);
+}
+
+static bool8 S9xNPQueueData (struct SNPSendQueue *q, const uint8 *data, uint32 len)
+{
+    if (q->Len + len > NP_SEND_QUEUE_LIMIT)
+        return (FALSE);
+
+    if (q->Len + len > q->Size)
+    {
+        uint32 size = (q->Len + len) * 2;
+        uint8 *grown = (uint8 *) realloc (q->Data, size);
+
+        if (!grown)
+            return (FALSE);
+
+        q->Data = grown;
+        q->Size = size;
+    }
+
+    memcpy (q->Data + q->Len, data, len);
+    q->Len += len;
+
+    return (TRUE);
+}
+
+static void S9xNPFreeQueue (struct SNPSendQueue *q)
+{
+    free (q->Data);
+    q->Data = NULL;
+    q->Len = q->Size = 0;
+}
 
 void S9xNPShutdownClient (int c, bool8 report_error = FALSE)
 {
@@ -82,6 +209,7 @@ void S9xNPShutdownClient (int c, bool8 report_error = FALSE)
         NPServer.Clients [c].Connected = FALSE;
         NPServer.Clients [c].SaidHello = FALSE;
 
+        S9xNPPollRemove (NPServer.Clients [c].Socket);
         close (NPServer.Clients [c].Socket);
 #ifdef NP_DEBUG
         printf ("SERVER: Player %d disconnecting @%ld\n", c + 1, S9xGetMilliTime () - START);
@@ -109,6 +237,8 @@ void S9xNPShutdownClient (int c, bool8 report_error = FALSE)
             free ((char *) NPServer.Clients [c].Who);
             NPServer.Clients [c].Who = NULL;
         }
+        S9xNPEndTransfer (&NPServer.Clients [c].Transfer);
+        S9xNPFreeQueue (&NPServer.Clients [c].Queue);
         NPServer.Joypads [c] = 0;
         NPServer.NumClients--;
         S9xNPRecomputePause ();
@@ -143,7 +273,15 @@ static bool8 S9xNPSGetData (int socket, uint8 *data, int length)
                 || errno == WSAEWOULDBLOCK
 #endif
 		)
+            {
+                // Player sockets don't block; wait for the rest to arrive.
+                fd_set fds;
+
+                FD_ZERO (&fds);
+                FD_SET (socket, &fds);
+                select (socket + 1, &fds, NULL, NULL, NULL);
 		continue;
+            }
 #ifdef WSAEMSGSIZE
             if (errno != WSAEMSGSIZE)
                 return (FALSE);
@@ -169,58 +307,38 @@ static bool8 S9xNPSGetData (int socket, uint8 *data, int length)
     return (TRUE);
 }
 
-static bool8 S9xNPSSendData (int fd, const uint8 *data, int length)
+static void S9xNPFlushClient (int c)
 {
-    int len = length;
-    int chunk = length / 50;
-
-    if (chunk < 1024)
-        chunk = 1024;
+    struct SNPClient *cl = &NPServer.Clients [c];
 
-    do
+    if (!S9xNPFlushQueue (cl->Socket, &cl->Queue))
     {
-        int num_bytes = len;
+        S9xNPShutdownClient (c, TRUE);
+        return;
+    }
 
-        // Write the data in small chunks, allowing this thread to spot an
-        // abort request from another thread.
-        if (num_bytes > chunk)
-            num_bytes = chunk;
+    if (cl->Queue.Len == 0)
+        S9xNPPollWatchOutput (cl->Socket, NP_POLL_CLIENT, c, FALSE);
+}
 
-	int sent;
-	sent = write (fd, (char *) data, len);
+// Queues a message for a player; FALSE if the player has to be dropped.
+static bool8 S9xNPSendToClient (int c, const uint8 *data, uint32 len)
+{
+    struct SNPClient *cl = &NPServer.Clients [c];
 
-	if (sent < 0)
-	{
-	    if (errno == EINTR
-#ifdef EAGAIN
-		|| errno == EAGAIN
-#endif
-#ifdef EWOULDBLOCK
-		|| errno == EWOULDBLOCK
-#endif
-		)
-            {
-#ifdef NP_DEBUG
-                printf ("SERVER: EINTR, EAGAIN or EWOULDBLOCK while sending data @%ld\n", S9xGetMilliTime () - START);
-#endif
-		continue;
-            }
-	    return (FALSE);
-	}
-	else
-	if (sent == 0)
-	    return (FALSE);
-	len -= sent;
-	data += sent;
-        if (length > 1024)
-        {
-#ifdef __WIN32__
-            int Percent = (uint8) (((length - len) * 100) / length);
-            PostMessage (GUI.hWnd, WM_USER, Percent, Percent);
-            Sleep (0);
-#endif
-        }
-    } while (len > 0);
+    if (!S9xNPQueueData (&cl->Queue, data, len))
+        return (FALSE);
+
+    // Only try the socket right away when nothing is waiting already;
+    // otherwise the poller tells us when it can take more.
+    if (cl->Queue.Len == len)
+    {
+        if (!S9xNPFlushQueue (cl->Socket, &cl->Queue))
+            return (FALSE);
+
+        if (cl->Queue.Len)
+            S9xNPPollWatchOutput (cl->Socket, NP_POLL_CLIENT, c, TRUE);
+    }
 
     return (TRUE);
 }
@@ -264,6 +382,38 @@ void S9xNPSendHeartBeat ()
     }
 }
 
+void S9xNPRelayRollbackInput (int c, uint32 frame, const uint8 *joypad)
+{
+    uint8 data [7 + 4 + 2];
+    uint8 *ptr = data;
+
+    *ptr++ = NP_SERV_MAGIC;
+    *ptr++ = 0; // Individual client sequence number will get placed here
+    *ptr++ = NP_SERV_ROLLBACK_INPUT | (c << 5);
+    WRITE_LONG (ptr, sizeof (data));
+    ptr += 4;
+    WRITE_LONG (ptr, frame);
+    ptr += 4;
+    *ptr++ = joypad [0];
+    *ptr++ = joypad [1];
+
+    // Clients resynced by the server restart from this frame.
+    if (frame > NPServer.FrameCount + NPServer.InputDelay)
+        NPServer.FrameCount = frame - NPServer.InputDelay;
+
+    for (int i = 0; i < NP_MAX_CLIENTS; i++)
+    {
+        if (i != c && NPServer.Clients [i].SaidHello)
+        {
+            data [1] = NPServer.Clients [i].SendSequenceNum++;
+            if (!S9xNPSendToClient (i, data, sizeof (data)))
+                S9xNPShutdownClient (i, TRUE);
+        }
+    }
+
+    S9xNPSendToSpectators (data, sizeof (data));
+}
+
 void S9xNPSendToAllClients (uint8 *data, int len)
 {
     int i;
@@ -273,10 +423,349 @@ void S9xNPSendToAllClients (uint8 *data, int len)
 	if (NPServer.Clients [i].SaidHello)
 	{
             data [1] = NPServer.Clients [i].SendSequenceNum++;
-	    if (!S9xNPSSendData (NPServer.Clients [i].Socket, data, len))
+	    if (!S9xNPSendToClient (i, data, len))
 		S9xNPShutdownClient (i, TRUE);
 	}
     }
+
+    S9xNPSendToSpectators (data, len);
+}
+
+static void S9xNPFlushSpectator (int s)
+{
+    struct SNPSpectator *sp = &NPServer.Spectators [s];
+
+    if (!S9xNPFlushQueue (sp->Socket, &sp->Queue))
+    {
+        S9xNPShutdownSpectator (s, "has disconnected");
+        return;
+    }
+
+    if (sp->Queue.Len == 0)
+        S9xNPPollWatchOutput (sp->Socket, NP_POLL_SPECTATOR, s, FALSE);
+}
+
+static void S9xNPQueueSpectatorData (int s, const uint8 *data, uint32 len)
+{
+    struct SNPSpectator *sp = &NPServer.Spectators [s];
+
+    if (!S9xNPQueueData (&sp->Queue, data, len))
+    {
+        S9xNPShutdownSpectator (s, "fell too far behind");
+        return;
+    }
+
+    // Only try the socket right away when nothing is waiting already;
+    // otherwise the poller tells us when it can take more.
+    if (sp->Queue.Len == len)
+    {
+        if (!S9xNPFlushQueue (sp->Socket, &sp->Queue))
+        {
+            S9xNPShutdownSpectator (s, "has disconnected");
+            return;
+        }
+
+        if (sp->Queue.Len)
+            S9xNPPollWatchOutput (sp->Socket, NP_POLL_SPECTATOR, s, TRUE);
+    }
+}
+
+void S9xNPSendToSpectators (uint8 *data, int len)
+{
+    for (int s = 0; s < NP_MAX_SPECTATORS; s++)
+    {
+        if (NPServer.Spectators [s].SaidHello)
+        {
+            data [1] = NPServer.Spectators [s].SendSequenceNum++;
+            S9xNPQueueSpectatorData (s, data, len);
+        }
+    }
+}
+
+void S9xNPShutdownSpectator (int s, const char *reason)
+{
+    struct SNPSpectator *sp = &NPServer.Spectators [s];
+
+    if (!sp->Connected)
+        return;
+
+    sprintf (NetPlay.WarningMsg, "SERVER: Spectator on '%s' %s.",
+             sp->HostName ? sp->HostName : "Unknown", reason);
+    S9xNPSetWarning (NetPlay.WarningMsg);
+
+    S9xNPPollRemove (sp->Socket);
+    close (sp->Socket);
+    sp->Connected = FALSE;
+    sp->SaidHello = FALSE;
+    free (sp->HostName);
+    sp->HostName = NULL;
+    S9xNPFreeQueue (&sp->Queue);
+    NPServer.NumSpectators--;
+}
+
+static void S9xNPAcceptSpectator ()
+{
+    struct sockaddr_in remote_address;
+    socklen_t len = sizeof (remote_address);
+    int new_fd, s;
+
+    memset (&remote_address, 0, sizeof (remote_address));
+    new_fd = accept (NPServer.SpectatorSocket, (struct sockaddr *) &remote_address, &len);
+    if (new_fd < 0)
+        return;
+
+    for (s = 0; s < NP_MAX_SPECTATORS; s++)
+    {
+        if (!NPServer.Spectators [s].Connected)
+            break;
+    }
+
+    if (s >= NP_MAX_SPECTATORS)
+    {
+        S9xNPSetWarning ("SERVER: Maximum number of spectators have already connected.");
+        close (new_fd);
+        return;
+    }
+
+    // Writes to spectators never block, whatever is not taken is queued.
+    unsigned long nonblocking = 1;
+    ioctl (new_fd, FIONBIO, &nonblocking);
+
+    struct SNPSpectator *sp = &NPServer.Spectators [s];
+    char *ip = inet_ntoa (remote_address.sin_addr);
+
+    sp->Socket = new_fd;
+    sp->Connected = TRUE;
+    sp->SaidHello = FALSE;
+    sp->SendSequenceNum = 0;
+    sp->HostName = strdup (ip ? ip : "Unknown");
+    sp->Queue.Len = 0;
+    sp->HeaderLen = 0;
+    sp->Skip = 0;
+    NPServer.NumSpectators++;
+
+    S9xNPPollAdd (new_fd, NP_POLL_SPECTATOR, s);
+
+    sprintf (NetPlay.WarningMsg, "SERVER: Spectator on %s has connected.", sp->HostName);
+    S9xNPSetWarning (NetPlay.WarningMsg);
+}
+
+// Spectator sockets don't block, and a message may arrive in pieces, so what
+// has come in is kept and the rest is waited for with the other sockets.
+static void S9xNPProcessSpectator (int s)
+{
+    struct SNPSpectator *sp = &NPServer.Spectators [s];
+    uint8 buffer [512];
+    uint8 *data;
+    uint32 len;
+
+    for (;;)
+    {
+        uint8 *ptr = sp->Skip ? buffer : sp->Header + sp->HeaderLen;
+        int want = sp->Skip ? (sp->Skip < sizeof (buffer) ? sp->Skip : sizeof (buffer)) :
+                              7 - sp->HeaderLen;
+        int got = read (sp->Socket, (char *) ptr, want);
+
+        if (got < 0 && errno == EINTR)
+            continue;
+
+        if (got < 0 && (FALSE
+#ifdef EAGAIN
+            || errno == EAGAIN
+#endif
+#ifdef EWOULDBLOCK
+            || errno == EWOULDBLOCK
+#endif
+#ifdef WSAEWOULDBLOCK
+            || errno == WSAEWOULDBLOCK
+#endif
+            ))
+            return;
+
+        if (got <= 0)
+        {
+            S9xNPShutdownSpectator (s, "has disconnected");
+            return;
+        }
+
+        if (sp->Skip)
+        {
+            sp->Skip -= got;
+            continue;
+        }
+
+        if ((sp->HeaderLen += got) < 7)
+            continue;
+
+        sp->HeaderLen = 0;
+
+        if (sp->Header [0] != NP_CLNT_MAGIC)
+        {
+            S9xNPShutdownSpectator (s, "sent a bad message");
+            return;
+        }
+
+        // Joypad messages carry data in the length field; spectators
+        // have no say in the game, so apart from HELLO everything is
+        // dropped, and nothing in a HELLO is needed.
+        if ((sp->Header [2] & 0x3f) == NP_CLNT_JOYPAD)
+            len = 0;
+        else
+            len = READ_LONG (&sp->Header [3]) - 7;
+
+        if (len > 0x10000)
+        {
+            S9xNPShutdownSpectator (s, "sent a bad message");
+            return;
+        }
+
+        sp->Skip = len;
+
+        if ((sp->Header [2] & 0x3f) == NP_CLNT_HELLO && !sp->SaidHello)
+            break;
+    }
+
+    len = 7 + 1 + 1 + 4 + strlen (NPServer.ROMName) + 1 + 1;
+
+    uint8 *ptr = data = new uint8 [len];
+    *ptr++ = NP_SERV_MAGIC;
+    *ptr++ = sp->SendSequenceNum++;
+    *ptr++ = NP_SERV_HELLO | (NPServer.Rollback ? 0x40 : 0);
+    WRITE_LONG (ptr, len);
+    ptr += 4;
+    *ptr++ = NP_VERSION;
+    *ptr++ = 0; // player 0 is a spectator
+    WRITE_LONG (ptr, NPServer.FrameCount);
+    ptr += 4;
+    strcpy ((char *) ptr, NPServer.ROMName);
+    ptr += strlen (NPServer.ROMName) + 1;
+    *ptr++ = NPServer.InputDelay;
+
+    S9xNPQueueSpectatorData (s, data, len);
+    delete[] data;
+
+    if (sp->Connected)
+    {
+        sp->SaidHello = TRUE;
+        S9xNPServerAddTask (NP_SERVER_SYNC_SPECTATOR, (void *) (pint) s);
+    }
+}
+
+// Waits up to timeout_usec for socket activity and handles it; returns the
+// number of sockets that were ready.
+static int S9xNPServerPoll (int timeout_usec)
+{
+    int res;
+
+#ifdef NP_USE_EPOLL
+    struct epoll_event events [NP_MAX_CLIENTS + NP_MAX_SPECTATORS + 2];
+
+    res = epoll_wait (NPServer.PollFD, events, sizeof (events) / sizeof (events [0]),
+                      (timeout_usec + 999) / 1000);
+
+    for (int e = 0; e < res; e++)
+    {
+        int type = events [e].data.u32 >> 16;
+        int index = events [e].data.u32 & 0xffff;
+        bool8 readable = (events [e].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) != 0;
+        bool8 writable = (events [e].events & EPOLLOUT) != 0;
+
+        switch (type)
+        {
+            case NP_POLL_LISTEN:
+                S9xNPAcceptClient (NPServer.Socket, FALSE);
+                break;
+            case NP_POLL_SPECTATOR_LISTEN:
+                S9xNPAcceptSpectator ();
+                break;
+            case NP_POLL_CLIENT:
+                if (writable && NPServer.Clients [index].Connected)
+                    S9xNPFlushClient (index);
+                if (readable && NPServer.Clients [index].Connected)
+                    S9xNPProcessClient (index);
+                break;
+            case NP_POLL_SPECTATOR:
+                if (writable && NPServer.Spectators [index].Connected)
+                    S9xNPFlushSpectator (index);
+                if (readable && NPServer.Spectators [index].Connected)
+                    S9xNPProcessSpectator (index);
+                break;
+        }
+    }
+#else
+    fd_set read_fds, write_fds;
+    struct timeval timeout;
+    int i;
+
+    int max_fd = NPServer.Socket;
+
+    FD_ZERO (&read_fds);
+    FD_ZERO (&write_fds);
+    FD_SET (NPServer.Socket, &read_fds);
+    if (NPServer.SpectatorSocket >= 0)
+    {
+        FD_SET (NPServer.SpectatorSocket, &read_fds);
+        if (NPServer.SpectatorSocket > max_fd)
+            max_fd = NPServer.SpectatorSocket;
+    }
+    for (i = 0; i < NP_MAX_CLIENTS; i++)
+    {
+        if (NPServer.Clients [i].Connected)
+        {
+            FD_SET (NPServer.Clients [i].Socket, &read_fds);
+            if (NPServer.Clients [i].Queue.Len)
+                FD_SET (NPServer.Clients [i].Socket, &write_fds);
+            if (NPServer.Clients [i].Socket > max_fd)
+                max_fd = NPServer.Clients [i].Socket;
+        }
+    }
+    for (i = 0; i < NP_MAX_SPECTATORS; i++)
+    {
+        if (NPServer.Spectators [i].Connected)
+        {
+            FD_SET (NPServer.Spectators [i].Socket, &read_fds);
+            if (NPServer.Spectators [i].Queue.Len)
+                FD_SET (NPServer.Spectators [i].Socket, &write_fds);
+            if (NPServer.Spectators [i].Socket > max_fd)
+                max_fd = NPServer.Spectators [i].Socket;
+        }
+    }
+
+    timeout.tv_sec = 0;
+    timeout.tv_usec = timeout_usec;
+    res = select (max_fd + 1, &read_fds, &write_fds, NULL, &timeout);
+
+    if (res > 0)
+    {
+        if (FD_ISSET (NPServer.Socket, &read_fds))
+            S9xNPAcceptClient (NPServer.Socket, FALSE);
+
+        if (NPServer.SpectatorSocket >= 0 && FD_ISSET (NPServer.SpectatorSocket, &read_fds))
+            S9xNPAcceptSpectator ();
+
+        for (i = 0; i < NP_MAX_CLIENTS; i++)
+        {
+            int fd = NPServer.Clients [i].Socket;
+
+            if (NPServer.Clients [i].Connected && FD_ISSET (fd, &write_fds))
+                S9xNPFlushClient (i);
+            if (NPServer.Clients [i].Connected && FD_ISSET (fd, &read_fds))
+                S9xNPProcessClient (i);
+        }
+
+        for (i = 0; i < NP_MAX_SPECTATORS; i++)
+        {
+            int fd = NPServer.Spectators [i].Socket;
+
+            if (NPServer.Spectators [i].Connected && FD_ISSET (fd, &write_fds))
+                S9xNPFlushSpectator (i);
+            if (NPServer.Spectators [i].Connected && FD_ISSET (fd, &read_fds))
+                S9xNPProcessSpectator (i);
+        }
+    }
+#endif
+
+    return (res);
 }
 
 void S9xNPProcessClient (int c)
@@ -357,18 +846,20 @@ void S9xNPProcessClient (int c)
 
             NPServer.Clients [c].SendSequenceNum = 0;
 
-            len = 7 + 1 + 1 + 4 + strlen (NPServer.ROMName) + 1;
+            len = 7 + 1 + 1 + 4 + strlen (NPServer.ROMName) + 1 + 1;
 
             delete[] data;
             ptr = data = new uint8 [len];
             *ptr++ = NP_SERV_MAGIC;
             *ptr++ = NPServer.Clients [c].SendSequenceNum++;
 
+            *ptr = NP_SERV_HELLO;
             if (NPServer.SendROMImageOnConnect &&
                 NPServer.NumClients > NP_ONE_CLIENT)
-                *ptr++ = NP_SERV_HELLO | 0x80;
-            else
-                *ptr++ = NP_SERV_HELLO;
+                *ptr |= 0x80;
+            if (NPServer.Rollback)
+                *ptr |= 0x40;
+            ptr++;
             WRITE_LONG (ptr, len);
             ptr += 4;
             *ptr++ = NP_VERSION;
@@ -376,12 +867,14 @@ void S9xNPProcessClient (int c)
             WRITE_LONG (ptr, NPServer.FrameCount);
             ptr += 4;
             strcpy ((char *) ptr, NPServer.ROMName);
+            ptr += strlen (NPServer.ROMName) + 1;
+            *ptr++ = NPServer.InputDelay;
 
 #ifdef NP_DEBUG
             printf ("SERVER: Sending welcome information to client @%ld...\n", S9xGetMilliTime () - START);
 #endif
             S9xNPSetAction ("SERVER: Sending welcome information to new client...", TRUE);
-            if (!S9xNPSSendData (NPServer.Clients [c].Socket, data, len))
+            if (!S9xNPSendToClient (c, data, len))
             {
                 S9xNPSetWarning ("SERVER: Failed to send welcome message to client.");
                 S9xNPShutdownClient (c, TRUE);
@@ -437,10 +930,11 @@ void S9xNPProcessClient (int c)
 #ifdef NP_DEBUG
             printf ("SERVER: Client %d waiting for ROM image @%ld...\n", c, S9xGetMilliTime () - START);
 #endif
-            NPServer.Clients [c].SaidHello = TRUE;
+            // The image is streamed from the server loop; the client only
+            // joins the game, and pauses the others for its freeze file,
+            // once it says it has received it.
             NPServer.Clients [c].Ready = FALSE;
             NPServer.Clients [c].Paused = FALSE;
-            S9xNPRecomputePause ();
             S9xNPSendROMImageToClient (c);
             break;
 
@@ -491,6 +985,20 @@ void S9xNPProcessClient (int c)
         case NP_CLNT_JOYPAD:
             NPServer.Joypads [c] = len;
             break;
+        case NP_CLNT_ROLLBACK_INPUT:
+        {
+            uint8 input [4 + 2];
+
+            if (len != 7 + sizeof (input) ||
+                !S9xNPSGetData (NPServer.Clients [c].Socket, input, sizeof (input)))
+            {
+                S9xNPSetWarning ("SERVER: Failed to get rollback input from client.\n");
+                S9xNPShutdownClient (c, TRUE);
+                return;
+            }
+            S9xNPRelayRollbackInput (c, READ_LONG (input), input + 4);
+            break;
+        }
         case NP_CLNT_PAUSE:
 #ifdef NP_DEBUG
             printf ("SERVER: Client %d Paused: %s @%ld\n", c, (header [2] & 0x80) ? "YES" : "NO", S9xGetMilliTime () - START);
@@ -503,6 +1011,67 @@ void S9xNPProcessClient (int c)
             S9xNPSetWarning (NetPlay.WarningMsg);
             S9xNPRecomputePause ();
             break;
+        case NP_CLNT_TRANSFER:
+        {
+            uint8 reply [1 + 4];
+            struct SNPTransfer *t = &NPServer.Clients [c].Transfer;
+
+            if (len != 7 + sizeof (reply) ||
+                !S9xNPSGetData (NPServer.Clients [c].Socket, reply, sizeof (reply)))
+            {
+                S9xNPSetWarning ("SERVER: Failed to get transfer reply from client.\n");
+                S9xNPShutdownClient (c, TRUE);
+                return;
+            }
+
+            if (t->Active && !t->Acked && reply [0] == t->Kind)
+            {
+                t->Offset = READ_LONG (&reply [1]);
+                t->Acked = TRUE;
+#ifdef NP_DEBUG
+                printf ("SERVER: Player %d starts transfer at %d of %d @%ld\n", c + 1, t->Offset, t->Size, S9xGetMilliTime () - START);
+#endif
+                // The client already had it.
+                if (t->Offset >= t->Size)
+                    S9xNPEndTransfer (t);
+            }
+            break;
+        }
+        case NP_CLNT_STATE_HASH:
+        {
+            uint8 hash [12];
+
+            if (len != 7 + sizeof (hash) ||
+                !S9xNPSGetData (NPServer.Clients [c].Socket, hash, sizeof (hash)))
+            {
+                S9xNPSetWarning ("SERVER: Failed to get state hash from client.\n");
+                S9xNPShutdownClient (c, TRUE);
+                return;
+            }
+
+            NPServer.Clients [c].HashFrame = READ_LONG (hash);
+            NPServer.Clients [c].StateHash = ((uint64) READ_LONG (hash + 4) << 32) |
+                                             (uint32) READ_LONG (hash + 8);
+
+            // Compare against any other client that already reported this
+            // frame; clients that are behind will be checked when they catch up.
+            for (int i = 0; i < NP_MAX_CLIENTS; i++)
+            {
+                if (i == c || !NPServer.Clients [i].SaidHello ||
+                    NPServer.Clients [i].HashFrame != NPServer.Clients [c].HashFrame)
+                    continue;
+
+                if (NPServer.Clients [i].StateHash != NPServer.Clients [c].StateHash)
+                {
+                    sprintf (NetPlay.WarningMsg, "SERVER: Player %d out of sync at frame %d, resyncing.",
+                             c + 1, NPServer.Clients [c].HashFrame);
+                    S9xNPSetWarning (NetPlay.WarningMsg);
+                    S9xNPServerAddTask (NP_SERVER_SYNC_ALL, 0);
+                }
+                break;
+            }
+            break;
+        }
     }
 }
 
@@ -534,6 +1103,10 @@ void S9xNPAcceptClient (int Listen, bool8 block)
         return;
     }
 
+    // Like spectators, players are never waited for when written to.
+    unsigned long nonblocking = 1;
+    ioctl (new_fd, FIONBIO, &nonblocking);
+
     for (i = 0; i < NP_MAX_CLIENTS; i++)
     {
 	if (!NPServer.Clients [i].Connected)
@@ -549,6 +1122,8 @@ void S9xNPAcceptClient (int Listen, bool8 block)
             NPServer.Clients [i].ROMName = NULL;
             NPServer.Clients [i].HostName = NULL;
             NPServer.Clients [i].Who = NULL;
+            NPServer.Clients [i].HashFrame = ~0U;
+            S9xNPPollAdd (new_fd, NP_POLL_CLIENT, i);
 	    break;
 	}
     }
@@ -618,11 +1193,32 @@ static bool8 S9xNPServerInit (int port)
         NPServer.Clients [i].ROMName = NULL;
         NPServer.Clients [i].HostName = NULL;
         NPServer.Clients [i].Who = NULL;
+        NPServer.Clients [i].Transfer.Active = FALSE;
+        NPServer.Clients [i].Transfer.Data = NULL;
+        NPServer.Clients [i].Transfer.Name = NULL;
+        NPServer.Clients [i].Queue.Data = NULL;
+        NPServer.Clients [i].Queue.Len = 0;
+        NPServer.Clients [i].Queue.Size = 0;
         NPServer.Joypads [i] = 0;
     }
 
+    for (i = 0; i < NP_MAX_SPECTATORS; i++)
+    {
+        NPServer.Spectators [i].Connected = FALSE;
+        NPServer.Spectators [i].SaidHello = FALSE;
+        NPServer.Spectators [i].HostName = NULL;
+        NPServer.Spectators [i].Queue.Data = NULL;
+        NPServer.Spectators [i].Queue.Len = 0;
+        NPServer.Spectators [i].Queue.Size = 0;
+    }
+
     NPServer.NumClients = 0;
+    NPServer.NumSpectators = 0;
+    NPServer.SpectatorSocket = -1;
     NPServer.FrameCount = 0;
+    NPServer.Rollback = Settings.NetPlayRollback;
+    NPServer.InputDelay = Settings.NetPlayInputDelay < NP_ROLLBACK_MAX_DELAY ?
+                          Settings.NetPlayInputDelay : NP_ROLLBACK_MAX_DELAY;
 
 #ifdef NP_DEBUG
     printf ("SERVER: Creating socket @%ld\n", S9xGetMilliTime () - START);
@@ -660,6 +1256,33 @@ static bool8 S9xNPServerInit (int port)
 	return (FALSE);
     }
 
+#ifdef NP_USE_EPOLL
+    if ((NPServer.PollFD = epoll_create (NP_MAX_CLIENTS + NP_MAX_SPECTATORS + 2)) < 0)
+    {
+	S9xNPSetError ("NetPlay Server: Can't create epoll instance.");
+	return (FALSE);
+    }
+#endif
+    S9xNPPollAdd (NPServer.Socket, NP_POLL_LISTEN, 0);
+
+    // Spectators are optional, a server that can't take them still runs.
+    address.sin_port = htons (port + NP_SPECTATOR_PORT_OFFSET);
+    if ((NPServer.SpectatorSocket = socket (AF_INET, SOCK_STREAM, 0)) >= 0)
+    {
+        setsockopt (NPServer.SpectatorSocket, SOL_SOCKET, SO_REUSEADDR,
+                    (char *)&val, sizeof (val));
+
+        if (bind (NPServer.SpectatorSocket, (struct sockaddr *) &address, sizeof (address)) < 0 ||
+            listen (NPServer.SpectatorSocket, NP_MAX_SPECTATORS) < 0)
+        {
+            S9xNPSetWarning ("NetPlay Server: Can't listen on the spectator port, spectators disabled.");
+            close (NPServer.SpectatorSocket);
+            NPServer.SpectatorSocket = -1;
+        }
+        else
+            S9xNPPollAdd (NPServer.SpectatorSocket, NP_POLL_SPECTATOR_LISTEN, 0);
+    }
+
 #ifdef NP_DEBUG
     printf ("SERVER: Init complete @%ld\n", S9xGetMilliTime () - START);
 #endif
@@ -708,18 +1331,14 @@ void S9xNPServerLoop (void *)
 
     while (server_continue)
     {
-        fd_set read_fds;
-        struct timeval timeout;
         int res;
-        int i;
-
-        int max_fd = NPServer.Socket;
 
 #ifdef __WIN32__
         Sleep (0);
 #endif
 
-        if (success && !(Settings.Paused && !Settings.FrameAdvance) && !Settings.StopEmulation &&
+        if (success && !NPServer.Rollback &&
+            !(Settings.Paused && !Settings.FrameAdvance) && !Settings.StopEmulation &&
             !Settings.ForcedPause && !NPServer.Paused)
         {
             S9xNPSendHeartBeat ();
@@ -738,38 +1357,15 @@ void S9xNPServerLoop (void *)
 
         do
         {
-            FD_ZERO (&read_fds);
-            FD_SET (NPServer.Socket, &read_fds);
-            for (i = 0; i < NP_MAX_CLIENTS; i++)
-            {
-                if (NPServer.Clients [i].Connected)
-                {
-                    FD_SET (NPServer.Clients [i].Socket, &read_fds);
-                    if (NPServer.Clients [i].Socket > max_fd)
-                        max_fd = NPServer.Clients [i].Socket;
-                }
-            }
-
-            timeout.tv_sec = 0;
-            timeout.tv_usec = 1000;
-            res = select (max_fd + 1, &read_fds, NULL, NULL, &timeout);
-
-            if (res > 0)
-            {
-                if (FD_ISSET (NPServer.Socket, &read_fds))
-                    S9xNPAcceptClient (NPServer.Socket, FALSE);
-
-                for (i = 0; i < NP_MAX_CLIENTS; i++)
-                {
-                    if (NPServer.Clients [i].Connected &&
-                        FD_ISSET (NPServer.Clients [i].Socket, &read_fds))
-                    {
-                        S9xNPProcessClient (i);
-                    }
-                }
-            }
+            res = S9xNPServerPoll (1000);
         } while (res > 0);
 
+        for (int c = 0; c < NP_MAX_CLIENTS; c++)
+        {
+            if (NPServer.Clients [c].Transfer.Active)
+                S9xNPSendTransferData (c, NP_TRANSFER_BUDGET);
+        }
+
 #ifdef __WIN32__
         success = WaitForSingleObject (GUI.ServerTimerSemaphore, 200) == WAIT_OBJECT_0;
 #else
@@ -865,6 +1461,10 @@ void S9xNPServerLoop (void *)
                     S9xNPSendSRAMToAllClients ();
                     break;
 
+                case NP_SERVER_SYNC_SPECTATOR:
+                    S9xNPSyncSpectator ((pint) task_data);
+                    break;
+
                 default:
                     S9xNPSetError ("SERVER: *** Unknown task ***\n");
                     break;
@@ -915,6 +1515,17 @@ void S9xNPStopServer ()
         if (NPServer.Clients [i].Connected)
 	    S9xNPShutdownClient(i, FALSE);
     }
+
+    for (int i = 0; i < NP_MAX_SPECTATORS; i++)
+        S9xNPShutdownSpectator (i, "was disconnected");
+
+    if (NPServer.SpectatorSocket >= 0)
+        close (NPServer.SpectatorSocket);
+    NPServer.SpectatorSocket = -1;
+
+#ifdef NP_USE_EPOLL
+    close (NPServer.PollFD);
+#endif
 }
 
 #ifdef __WIN32__
@@ -927,6 +1538,162 @@ void S9xGetTimeOfDay (struct timeval *n)
 }
 #endif
 
+void S9xNPEndTransfer (struct SNPTransfer *t)
+{
+    delete[] t->Data;
+    t->Data = NULL;
+    free (t->Name);
+    t->Name = NULL;
+    t->Active = FALSE;
+}
+
+static uint8 *S9xNPTransferMessage (uint8 seq, const struct SNPTransfer *t, bool8 push, uint32 &len)
+{
+    const char *name = t->Name ? t->Name : "";
+
+    len = 7 + 1 + 4 + 8 + 4 + strlen (name) + 1;
+
+    uint8 *data = new uint8 [len];
+    uint8 *ptr = data;
+
+    *ptr++ = NP_SERV_MAGIC;
+    *ptr++ = seq;
+    *ptr++ = NP_SERV_TRANSFER | (push ? 0x80 : 0);
+    WRITE_LONG (ptr, len);
+    ptr += 4;
+    *ptr++ = t->Kind;
+    WRITE_LONG (ptr, t->Size);
+    ptr += 4;
+    WRITE_LONG (ptr, (uint32) (t->Hash >> 32));
+    ptr += 4;
+    WRITE_LONG (ptr, (uint32) t->Hash);
+    ptr += 4;
+    WRITE_LONG (ptr, t->Info);
+    ptr += 4;
+    strcpy ((char *) ptr, name);
+
+    return (data);
+}
+
+static uint8 transfer_chunk [7 + 4 + NP_TRANSFER_CHUNK];
+
+// Packs the chunk at t->Offset into transfer_chunk and advances the offset.
+// Chunks that don't get smaller are sent as they are.
+static uint32 S9xNPTransferChunk (uint8 seq, struct SNPTransfer *t)
+{
+    uint32 raw = t->Size - t->Offset;
+    uint32 len;
+    uint8 op = NP_SERV_TRANSFER_DATA;
+    uint8 *ptr = transfer_chunk;
+
+    if (raw > NP_TRANSFER_CHUNK)
+        raw = NP_TRANSFER_CHUNK;
+
+#ifdef ZLIB
+    uLongf packed = raw;
+
+    if (compress2 (transfer_chunk + 7 + 4, &packed, t->Data + t->Offset, raw, Z_BEST_SPEED) == Z_OK &&
+        packed < raw)
+    {
+        op |= 0x80;
+        len = packed;
+    }
+    else
+#endif
+    {
+        memcpy (transfer_chunk + 7 + 4, t->Data + t->Offset, raw);
+        len = raw;
+    }
+
+    *ptr++ = NP_SERV_MAGIC;
+    *ptr++ = seq;
+    *ptr++ = op;
+    WRITE_LONG (ptr, 7 + 4 + len);
+    ptr += 4;
+    WRITE_LONG (ptr, t->Offset);
+
+    t->Offset += raw;
+
+    return (7 + 4 + len);
+}
+
+bool8 S9xNPBeginTransfer (int c, uint8 kind, const uint8 *data, uint32 size,
+                          uint32 info, const char *name, bool8 push)
+{
+    struct SNPTransfer *t = &NPServer.Clients [c].Transfer;
+
+    // The content is copied so that it stays the same while it is streamed.
+    S9xNPEndTransfer (t);
+    t->Kind = kind;
+    t->Data = new uint8 [size];
+    memcpy (t->Data, data, size);
+    t->Size = size;
+    t->Offset = 0;
+    t->Hash = S9xStateHashData (data, size);
+    t->Info = info;
+    t->Name = name ? strdup (name) : NULL;
+    t->Active = TRUE;
+    t->Acked = push;
+
+    uint32 len;
+    uint8 *msg = S9xNPTransferMessage (NPServer.Clients [c].SendSequenceNum++, t, push, len);
+    bool8 ok = S9xNPSendToClient (c, msg, len);
+
+    delete[] msg;
+    if (!ok)
+    {
+        S9xNPShutdownClient (c, TRUE);
+        return (FALSE);
+    }
+    return (TRUE);
+}
+
+bool8 S9xNPSendTransferData (int c, uint32 budget)
+{
+    struct SNPTransfer *t = &NPServer.Clients [c].Transfer;
+    uint32 sent = 0;
+
+    if (!t->Active || !t->Acked)
+        return (TRUE);
+
+    // Chunks are only added while the socket keeps up, so a whole ROM
+    // image is never queued at once.
+    while (t->Offset < t->Size && sent < budget &&
+           NPServer.Clients [c].Queue.Len < NP_TRANSFER_BUDGET)
+    {
+        uint32 start = t->Offset;
+        uint32 len = S9xNPTransferChunk (NPServer.Clients [c].SendSequenceNum++, t);
+
+        if (!S9xNPSendToClient (c, transfer_chunk, len))
+        {
+            S9xNPShutdownClient (c, TRUE);
+            return (FALSE);
+        }
+        sent += t->Offset - start;
+    }
+
+    if (t->Offset >= t->Size)
+        S9xNPEndTransfer (t);
+
+    return (TRUE);
+}
+
+// Runs a transfer to completion, for content that has to arrive before the
+// messages that follow it. Other clients are still serviced while waiting
+// for this one to reply.
+void S9xNPFinishTransfer (int c)
+{
+    while (server_continue && NPServer.Clients [c].Connected &&
+           NPServer.Clients [c].Transfer.Active)
+    {
+        if (NPServer.Clients [c].Transfer.Acked)
+            S9xNPSendTransferData (c, ~0U);
+
+        if (NPServer.Clients [c].Transfer.Active)
+            S9xNPServerPoll (1000);
+    }
+}
+
 void S9xNPSendROMImageToAllClients ()
 {
     S9xNPNoClientReady ();
@@ -934,12 +1701,22 @@ void S9xNPSendROMImageToAllClients ()
 
     int c;
 
+    // Clients still receiving the previous image in the background get the
+    // new one instead.
     for (c = NP_ONE_CLIENT; c < NP_MAX_CLIENTS; c++)
     {
-        if (NPServer.Clients [c].SaidHello)
+        if (NPServer.Clients [c].SaidHello ||
+            (NPServer.Clients [c].Transfer.Active &&
+             NPServer.Clients [c].Transfer.Kind == NP_SERV_ROM_IMAGE))
             S9xNPSendROMImageToClient (c);
     }
 
+    for (c = NP_ONE_CLIENT; c < NP_MAX_CLIENTS; c++)
+    {
+        if (NPServer.Clients [c].SaidHello)
+            S9xNPFinishTransfer (c);
+    }
+
     if (NPServer.SyncByReset)
     {
         S9xNPServerAddTask (NP_SERVER_SEND_SRAM_ALL, 0);
@@ -957,28 +1734,8 @@ bool8 S9xNPSendROMImageToClient (int c)
     sprintf (NetPlay.ActionMsg, "Sending ROM image to player %d...", c + 1);
     S9xNPSetAction (NetPlay.ActionMsg, TRUE);
 
-    uint8 header [7 + 1 + 4];
-    uint8 *ptr = header;
-    int len = sizeof (header) + Memory.CalculatedSize +
-              Memory.ROMFilename.length() + 1;
-    *ptr++ = NP_SERV_MAGIC;
-    *ptr++ = NPServer.Clients [c].SendSequenceNum++;
-    *ptr++ = NP_SERV_ROM_IMAGE;
-    WRITE_LONG (ptr, len);
-    ptr += 4;
-    *ptr++ = Memory.HiROM;
-    WRITE_LONG (ptr, Memory.CalculatedSize);
-
-    if (!S9xNPSSendData (NPServer.Clients [c].Socket, header, sizeof (header)) ||
-        !S9xNPSSendData (NPServer.Clients [c].Socket, Memory.ROM,
-                        Memory.CalculatedSize) ||
-        !S9xNPSSendData (NPServer.Clients [c].Socket, (uint8 *) Memory.ROMFilename.c_str(),
-                        Memory.ROMFilename.length() + 1))
-    {
-        S9xNPShutdownClient (c, TRUE);
-        return (FALSE);
-    }
-    return (TRUE);
+    return (S9xNPBeginTransfer (c, NP_SERV_ROM_IMAGE, Memory.ROM, Memory.CalculatedSize,
+                                Memory.HiROM, Memory.ROMFilename.c_str(), FALSE));
 }
 
 void S9xNPSyncClients ()
@@ -987,58 +1744,93 @@ void S9xNPSyncClients ()
     S9xNPSyncClient (-1);
 }
 
-void S9xNPSyncClient (int client)
+static bool8 S9xNPFreezeCurrentGame (uint8 *&data, uint32 &len)
 {
-#ifdef HAVE_MKSTEMP
-    char fname[] = "/tmp/snes9x_fztmpXXXXXX";
-    int fd=-1;
-#else
-    char fname [L_tmpnam];
-#endif
+    // Frozen uncompressed; the transfer compresses it.
+    S9xNPSetAction ("SERVER: Freezing game...", TRUE);
 
-    S9xNPWaitForEmulationToComplete ();
+    // Taken by the emulation thread between frames. Waiting for it to stall
+    // isn't enough: players aren't held for spectators, rollback clients
+    // never wait for the server, and a heart-beat already sent can start
+    // the next frame while the game is being frozen.
+    return (S9xNPFreezeBetweenFrames (data, len));
+}
 
-    S9xNPSetAction ("SERVER: Freezing game...", TRUE);
-#ifdef HAVE_MKSTEMP
-    if ( ((fd=mkstemp(fname)) >= 0) && S9xFreezeGame(fname) )
-#else
-    if ( tmpnam(fname) && S9xFreezeGame(fname) )
-#endif
+void S9xNPSyncClient (int client)
+{
+    uint8 *data;
+    uint32 len;
+
+    if (S9xNPFreezeCurrentGame (data, len))
     {
-        uint8 *data;
-        uint32 len;
+        int c;
 
-        S9xNPSetAction ("SERVER: Loading freeze file...", TRUE);
-        if (S9xNPLoadFreezeFile (fname, data, len))
+        if (client < 0)
         {
-            int c;
-
-            if (client < 0)
+            // In a rollback session the host reloads the state as well,
+            // so that every client restarts its history at the same frame.
+            for (c = NPServer.Rollback ? 0 : NP_ONE_CLIENT; c < NP_MAX_CLIENTS; c++)
             {
-                for (c = NP_ONE_CLIENT; c < NP_MAX_CLIENTS; c++)
+                if (NPServer.Clients [c].SaidHello)
                 {
-                    if (NPServer.Clients [c].SaidHello)
-                    {
-                        NPServer.Clients [c].Ready = FALSE;
-                        S9xNPRecomputePause ();
-                        S9xNPSendFreezeFile (c, data, len);
-                    }
+                    NPServer.Clients [c].Ready = FALSE;
+                    S9xNPRecomputePause ();
+                    S9xNPSendFreezeFile (c, data, len);
                 }
             }
-            else
+
+            for (c = 0; c < NP_MAX_SPECTATORS; c++)
             {
-                NPServer.Clients [client].Ready = FALSE;
-                S9xNPRecomputePause ();
-                S9xNPSendFreezeFile (client, data, len);
+                if (NPServer.Spectators [c].SaidHello)
+                    S9xNPSendFreezeFileToSpectator (c, data, len);
             }
-            delete[] data;
         }
-        remove (fname);
+        else
+        {
+            NPServer.Clients [client].Ready = FALSE;
+            S9xNPRecomputePause ();
+            S9xNPSendFreezeFile (client, data, len);
+        }
+        delete[] data;
+    }
+}
+
+void S9xNPSyncSpectator (int s)
+{
+    uint8 *data;
+    uint32 len;
+
+    // Players are not paused for this; the state is queued for the
+    // spectator and the joypad stream that follows picks up from it.
+    if (NPServer.Spectators [s].SaidHello && S9xNPFreezeCurrentGame (data, len))
+    {
+        S9xNPSendFreezeFileToSpectator (s, data, len);
+        delete[] data;
+    }
+}
+
+void S9xNPSendFreezeFileToSpectator (int s, uint8 *data, uint32 len)
+{
+    struct SNPTransfer t;
+    uint32 msg_len;
+
+    t.Kind = NP_SERV_FREEZE_FILE;
+    t.Data = data;
+    t.Size = len;
+    t.Offset = 0;
+    t.Hash = S9xStateHashData (data, len);
+    t.Info = NPServer.FrameCount;
+    t.Name = NULL;
+
+    uint8 *msg = S9xNPTransferMessage (NPServer.Spectators [s].SendSequenceNum++, &t, TRUE, msg_len);
+    S9xNPQueueSpectatorData (s, msg, msg_len);
+    delete[] msg;
+
+    while (NPServer.Spectators [s].Connected && t.Offset < t.Size)
+    {
+        msg_len = S9xNPTransferChunk (NPServer.Spectators [s].SendSequenceNum++, &t);
+        S9xNPQueueSpectatorData (s, transfer_chunk, msg_len);
     }
-#ifdef HAVE_MKSTEMP
-    if (fd != -1)
-        close(fd);
-#endif
 }
 
 bool8 S9xNPLoadFreezeFile (const char *fname, uint8 *&data, uint32 &len)
@@ -1068,21 +1860,12 @@ void S9xNPSendFreezeFile (int c, uint8 *data, uint32 len)
 
     sprintf (NetPlay.ActionMsg, "SERVER: Sending freeze-file to player %d...", c + 1);
     S9xNPSetAction (NetPlay.ActionMsg, TRUE);
-    uint8 header [7 + 4];
-    uint8 *ptr = header;
-
-    *ptr++ = NP_SERV_MAGIC;
-    *ptr++ = NPServer.Clients [c].SendSequenceNum++;
-    *ptr++ = NP_SERV_FREEZE_FILE;
-    WRITE_LONG (ptr, len + 7 + 4);
-    ptr += 4;
-    WRITE_LONG (ptr, NPServer.FrameCount);
+    NPServer.Clients [c].HashFrame = ~0U;
 
-    if (!S9xNPSSendData (NPServer.Clients [c].Socket, header, 7 + 4) ||
-        !S9xNPSSendData (NPServer.Clients [c].Socket, data, len))
-    {
-       S9xNPShutdownClient (c, TRUE);
-    }
+    // A freeze file is never the same twice, so it is pushed without
+    // waiting for the client to say what it already has.
+    if (S9xNPBeginTransfer (c, NP_SERV_FREEZE_FILE, data, len, NPServer.FrameCount, NULL, TRUE))
+        S9xNPFinishTransfer (c);
     S9xNPSetAction ("", TRUE);
 }
 
@@ -1141,7 +1924,7 @@ void S9xNPSendROMLoadRequest (const char *filename)
             sprintf (NetPlay.WarningMsg, "SERVER: sending ROM load request to player %d...", i + 1);
             S9xNPSetAction (NetPlay.WarningMsg, TRUE);
             data [1] = NPServer.Clients [i].SendSequenceNum++;
-	    if (!S9xNPSSendData (NPServer.Clients [i].Socket, data, len))
+	    if (!S9xNPSendToClient (i, data, len))
             {
 		S9xNPShutdownClient (i, TRUE);
             }
@@ -1166,7 +1949,6 @@ void S9xNPSendSRAMToClient (int c)
 #ifdef NP_DEBUG
     printf ("SERVER: Sending S-RAM data to player %d @%ld\n", c + 1, S9xGetMilliTime () - START);
 #endif
-    uint8 sram [7];
     int SRAMSize = Memory.SRAMSize ?
                    (1 << (Memory.SRAMSize + 3)) * 128 : 0;
     if (Memory.LoROM)
@@ -1174,24 +1956,12 @@ void S9xNPSendSRAMToClient (int c)
 	else if (Memory.HiROM)
 		SRAMSize = SRAMSize < 0x40000 ? SRAMSize : 0x40000;
 
-    int len = 7 + SRAMSize;
-
     sprintf (NetPlay.ActionMsg, "SERVER: Sending S-RAM to player %d...", c + 1);
     S9xNPSetAction (NetPlay.ActionMsg, TRUE);
 
-    uint8 *ptr = sram;
-    *ptr++ = NP_SERV_MAGIC;
-    *ptr++ = NPServer.Clients [c].SendSequenceNum++;
-    *ptr++ = NP_SERV_SRAM_DATA;
-    WRITE_LONG (ptr, len);
-    if (!S9xNPSSendData (NPServer.Clients [c].Socket,
-                        sram, sizeof (sram)) ||
-        (len > 7 &&
-         !S9xNPSSendData (NPServer.Clients [c].Socket,
-                         Memory.SRAM, len - 7)))
-    {
-        S9xNPShutdownClient (c, TRUE);
-    }
+    // A RESET usually follows, which has to find the S-RAM in place.
+    if (S9xNPBeginTransfer (c, NP_SERV_SRAM_DATA, Memory.SRAM, SRAMSize, 0, NULL, FALSE))
+        S9xNPFinishTransfer (c);
 }
 
 void S9xNPSendFreezeFileToAllClients (const char *filename)
@@ -1208,6 +1978,11 @@ void S9xNPSendFreezeFileToAllClients (const char *filename)
             if (NPServer.Clients [c].SaidHello)
                 S9xNPSendFreezeFile (c, data, len);
         }
+        for (int s = 0; s < NP_MAX_SPECTATORS; s++)
+        {
+            if (NPServer.Spectators [s].SaidHello)
+                S9xNPSendFreezeFileToSpectator (s, data, len);
+        }
         delete[] data;
     }
 }
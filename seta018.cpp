@@ -8,7 +8,7 @@
 #include "memmap.h"
 #include "seta.h"
 
-static int	line;	// line counter
+S9X_INSTANCE_STATIC int	line;	// line counter
 
 
 uint8 S9xGetST018 (uint32 Address)
@@ -46,7 +46,7 @@ uint8 S9xGetST018 (uint32 Address)
 
 void S9xSetST018 (uint8 Byte, uint32 Address)
 {
-	static bool	reset   = false;
+	S9X_INSTANCE_STATIC bool	reset   = false;
 	uint16		address = (uint16) Address & 0xFFFF;
 
 #ifdef DEBUGGER
@@ -16,6 +16,7 @@
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
+#include "checksum.h"
 
 /****************************** MACROS ******************************/
 #define ROTLEFT(a,b) (((a) << (b)) | ((a) >> (32-(b))))
@@ -110,11 +111,31 @@ void sha256_init(SHA256_CTX *ctx)
 
 void sha256_update(SHA256_CTX *ctx, const BYTE data[], size_t len)
 {
-	WORD i;
+	while (len) {
+		/* Whole blocks are hashed where they are, in one go. */
+		if (ctx->datalen == 0 && len >= 64) {
+			size_t blocks = len / 64;
+
+			if (!S9xSHA256Blocks(ctx->state, data, blocks)) {
+				for (size_t b = 0; b < blocks; ++b)
+					sha256_transform(ctx, data + b * 64);
+			}
+
+			ctx->bitlen += blocks * 512;
+			data += blocks * 64;
+			len -= blocks * 64;
+			continue;
+		}
+
+		size_t n = 64 - ctx->datalen;
+		if (n > len)
+			n = len;
+
+		memcpy(ctx->data + ctx->datalen, data, n);
+		ctx->datalen += n;
+		data += n;
+		len -= n;
 
-	for (i = 0; i < len; ++i) {
-		ctx->data[ctx->datalen] = data[i];
-		ctx->datalen++;
 		if (ctx->datalen == 64) {
 			sha256_transform(ctx, ctx->data);
 			ctx->bitlen += 512;
@@ -19,6 +19,9 @@
 #include "display.h"
 #include "language.h"
 #include "gfx.h"
+#ifdef DEBUGGER
+#include "history.h"
+#endif
 
 #ifndef min
 #define min(a,b)	(((a) < (b)) ? (a) : (b))
@@ -998,6 +1001,7 @@ static int UnfreezeStruct (STREAM, const char *, void *, FreezeData *, int, int)
 static int UnfreezeStructCopy (STREAM, const char *, uint8 **, FreezeData *, int, int);
 static void UnfreezeStructFromCopy (void *, FreezeData *, int, uint8 *, int);
 static void FreezeBlock (STREAM, const char *, uint8 *, int);
+static void FreezeBlockPadded (STREAM, const char *, uint8 *, int, int);
 static void FreezeStruct (STREAM, const char *, void *, FreezeData *, int);
 static bool CheckBlockName(STREAM stream, const char *name, int &len);
 static void SkipBlockWithName(STREAM stream, const char *name);
@@ -1005,7 +1009,7 @@ static void SkipBlockWithName(STREAM stream, const char *name);
 
 void S9xResetSaveTimer (bool8 dontsave)
 {
-	static time_t	t = -1;
+	S9X_INSTANCE_STATIC time_t	t = -1;
 
 	if (!Settings.DontSaveOopsSnapshot && !dontsave && t != -1 && time(NULL) - t > 300)
 	{
@@ -1193,7 +1197,9 @@ void S9xFreezeToStream (STREAM stream)
 
 	FreezeBlock (stream, "RAM", Memory.RAM, sizeof(Memory.RAM));
 
-	FreezeBlock (stream, "SRA", Memory.SRAM, Memory.SRAM_SIZE);
+	// SRAM the cartridge can't reach is saved as zeroes rather than read,
+	// which would take memory for it.
+	FreezeBlockPadded (stream, "SRA", Memory.SRAM, Memory.SRAMExtent, Memory.SRAM_SIZE);
 
 	FreezeBlock (stream, "FIL", Memory.FillRAM, 0x8000);
 
@@ -1398,8 +1404,9 @@ int S9xUnfreezeFromStream (STREAM stream)
 		if (result != SUCCESS)
 			break;
 
+		// SRAM the cartridge can't reach is skipped, so it stays unallocated.
 		if (fast)
-			result = UnfreezeBlock(stream, "SRA", Memory.SRAM, Memory.SRAM_SIZE);
+			result = UnfreezeBlock(stream, "SRA", Memory.SRAM, Memory.SRAMExtent);
 		else
 			result = UnfreezeBlockCopy (stream, "SRA", &local_sram, Memory.SRAM_SIZE);
 		if (result != SUCCESS)
@@ -1555,6 +1562,12 @@ int S9xUnfreezeFromStream (STREAM stream)
 			S9xReset();
 		}
 
+	#ifdef DEBUGGER
+		// A fast load doesn't go through S9xReset, so drop the history here.
+		// Going back in the history loads snapshots too; it is kept then.
+		S9xHistoryReset();
+	#endif
+
 		UnfreezeStructFromCopy(&CPU, SnapCPU, COUNT(SnapCPU), local_cpu, version);
 
 		UnfreezeStructFromCopy(&Registers, SnapRegisters, COUNT(SnapRegisters), local_registers, version);
@@ -1565,13 +1578,16 @@ int S9xUnfreezeFromStream (STREAM stream)
 		UnfreezeStructFromCopy(&dma_snap, SnapDMA, COUNT(SnapDMA), local_dma, version);
 
 		if (local_vram)
+		{
 			memcpy(Memory.VRAM, local_vram, 0x10000);
+			S9xStateHashInvalidate();
+		}
 
 		if (local_ram)
 			memcpy(Memory.RAM, local_ram, 0x20000);
 
 		if (local_sram)
-			memcpy(Memory.SRAM, local_sram, Memory.SRAM_SIZE);
+			memcpy(Memory.SRAM, local_sram, Memory.SRAMExtent);
 
 		if (local_fillram)
 			memcpy(Memory.FillRAM, local_fillram, 0x8000);
@@ -1759,7 +1775,7 @@ int S9xUnfreezeFromStream (STREAM stream)
 		if (local_movie_data)
 		{
 			// restore last displayed pad_read status
-			extern bool8	pad_read, pad_read_last;
+			extern S9X_INSTANCE bool8	pad_read, pad_read_last;
 			bool8			pad_read_temp = pad_read;
 
 			pad_read = pad_read_last;
@@ -2081,7 +2097,7 @@ static void FreezeStruct (STREAM stream, const char *name, void *base, FreezeDat
 	delete [] block;
 }
 
-static void FreezeBlock (STREAM stream, const char *name, uint8 *block, int size)
+static void FreezeBlockHeader (STREAM stream, const char *name, int size)
 {
 	char	buffer[20];
 
@@ -2101,9 +2117,27 @@ static void FreezeBlock (STREAM stream, const char *name, uint8 *block, int size
 	buffer[11] = 0;
 
 	WRITE_STREAM(buffer, 11, stream);
+}
+
+static void FreezeBlock (STREAM stream, const char *name, uint8 *block, int size)
+{
+	FreezeBlockHeader(stream, name, size);
 	WRITE_STREAM(block, size, stream);
 }
 
+// Only the first used bytes of the block are stored, the rest is written as
+// zeroes.
+static void FreezeBlockPadded (STREAM stream, const char *name, uint8 *block, int used, int size)
+{
+	static uint8	zeroes[4096];
+
+	FreezeBlockHeader(stream, name, size);
+	WRITE_STREAM(block, used, stream);
+
+	for (int len = size - used; len > 0; len -= sizeof(zeroes))
+		WRITE_STREAM(zeroes, len < (int) sizeof(zeroes) ? len : sizeof(zeroes), stream);
+}
+
 static bool CheckBlockName(STREAM stream, const char *name, int &len)
 {
 	char	buffer[16];
@@ -2197,16 +2231,20 @@ static int UnfreezeBlock (STREAM stream, const char *name, uint8 *block, int siz
 		return (WRONG_FORMAT);
 	}
 
-	if (rem)
+	// What doesn't fit is read a piece at a time into a scratch buffer, so
+	// that skipping unreachable SRAM doesn't allocate its size on every load.
+	while (rem > 0)
 	{
-		char	*junk = new char[rem];
-		len = READ_STREAM(junk, rem, stream);
-		delete [] junk;
-		if (len != rem)
+		char	junk[4096];
+		int		piece = rem < (int) sizeof(junk) ? rem : (int) sizeof(junk);
+
+		if (READ_STREAM(junk, piece, stream) != (unsigned int) piece)
 		{
 			REVERT_STREAM(stream, rewind, 0);
 			return (WRONG_FORMAT);
 		}
+
+		rem -= piece;
 	}
 
 	return (SUCCESS);
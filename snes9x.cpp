@@ -23,6 +23,8 @@
 
 #ifdef DEBUGGER
 #include "debug.h"
+#include "profile.h"
+#include "history.h"
 extern FILE	*trace;
 #endif
 
@@ -253,6 +255,7 @@ void S9xLoadConfigFiles (char **argv, int argc)
 	Settings.TurboSkipFrames            =  conf.GetUInt("Settings::TurboFrameSkip",            15);
 	Settings.MovieTruncate              =  conf.GetBool("Settings::MovieTruncateAtEnd",        false);
 	Settings.MovieNotifyIgnored         =  conf.GetBool("Settings::MovieNotifyIgnored",        false);
+	Settings.MovieStateHashes           =  conf.GetBool("Settings::MovieStateHashes",          false);
 	Settings.WrongMovieStateProtection  =  conf.GetBool("Settings::WrongMovieStateProtection", true);
 	Settings.StretchScreenshots         =  conf.GetInt ("Settings::StretchScreenshots",        1);
 	Settings.SnapshotScreenshots        =  conf.GetBool("Settings::SnapshotScreenshots",       true);
@@ -315,6 +318,12 @@ void S9xLoadConfigFiles (char **argv, int argc)
 	Settings.ServerName[0] = '\0';
 	if (conf.Exists("Netplay::Server"))
 		conf.GetString("Netplay::Server", Settings.ServerName, 128);
+
+	Settings.NetPlaySpectate   = conf.GetBool("Netplay::Spectate", false);
+
+	// only read by the server, clients follow the mode of the session they join
+	Settings.NetPlayRollback   = conf.GetBool("Netplay::Rollback", false);
+	Settings.NetPlayInputDelay = conf.GetUInt("Netplay::InputDelay", 2);
 #endif
 
 	// Debug
@@ -323,9 +332,12 @@ void S9xLoadConfigFiles (char **argv, int argc)
 	if (conf.GetBool("DEBUG::Debugger", false))
 		CPU.Flags |= DEBUG_MODE_FLAG;
 
+	Settings.TraceBinary = conf.GetBool("DEBUG::TraceBinary", false);
+
 	if (conf.GetBool("DEBUG::Trace", false))
 	{
-		ENSURE_TRACE_OPEN(trace,"trace.log","wb")
+		if (!Settings.TraceBinary)
+			ENSURE_TRACE_OPEN(trace,"trace.log","wb")
 		CPU.Flags |= TRACE_FLAG;
 	}
 	Settings.TraceSMP = FALSE;
@@ -419,6 +431,10 @@ void S9xUsage (void)
 #ifdef DEBUGGER
 	S9xMessage(S9X_INFO, S9X_USAGE, "-debug                          Set the Debugger flag");
 	S9xMessage(S9X_INFO, S9X_USAGE, "-trace                          Begin CPU instruction tracing");
+	S9xMessage(S9X_INFO, S9X_USAGE, "-tracebinary                    Begin CPU instruction tracing to trace.bin");
+	S9xMessage(S9X_INFO, S9X_USAGE, "-profile                        Profile every instruction, to profile.txt on exit");
+	S9xMessage(S9X_INFO, S9X_USAGE, "-profilesample <n>              Profile one instruction every <n> cycles");
+	S9xMessage(S9X_INFO, S9X_USAGE, "-history                        Record history for the debugger to step back through");
 #endif
 	S9xMessage(S9X_INFO, S9X_USAGE, "-hdmatiming <1-199>             (Not recommended) Changes HDMA transfer timings");
 	S9xMessage(S9X_INFO, S9X_USAGE, "                                event comes");
@@ -688,6 +704,26 @@ char * S9xParseArgs (char **argv, int argc)
 				CPU.Flags |= TRACE_FLAG;
 			}
 			else
+			if (!strcasecmp(argv[i], "-tracebinary"))
+			{
+				Settings.TraceBinary = TRUE;
+				CPU.Flags |= TRACE_FLAG;
+			}
+			else
+			if (!strcasecmp(argv[i], "-profile"))
+				S9xProfileStart((1 << PROFILE_TARGETS) - 1, 0);
+			else
+			if (!strcasecmp(argv[i], "-profilesample"))
+			{
+				if (i + 1 < argc)
+					S9xProfileStart((1 << PROFILE_TARGETS) - 1, atoi(argv[++i]));
+				else
+					S9xUsage();
+			}
+			else
+			if (!strcasecmp(argv[i], "-history"))
+				S9xHistoryStart(0, 0);
+			else
 		#endif
 
 			if (!strcasecmp(argv[i], "-hdmatiming"))
@@ -197,6 +197,7 @@ struct SSettings
 	bool8	TraceDSP;
 	bool8	TraceHCEvent;
 	bool8	TraceSMP;
+	bool8	TraceBinary;
 
 	bool8	SuperFX;
 	uint8	DSP;
@@ -286,9 +287,13 @@ struct SSettings
 	bool8	NetPlayServer;
 	char	ServerName[128];
 	int		Port;
+	bool8	NetPlayRollback;
+	bool8	NetPlaySpectate;
+	uint32	NetPlayInputDelay;
 
 	bool8	MovieTruncate;
 	bool8	MovieNotifyIgnored;
+	bool8	MovieStateHashes;
 	bool8	WrongMovieStateProtection;
 	bool8	DumpStreams;
 	int		DumpStreamsMaxFrames;
@@ -302,6 +307,7 @@ struct SSettings
 	bool8	ApplyCheats;
 	bool8	NoPatch;
 	bool8	IgnorePatchChecksum;
+	bool8	MapROMFile;
 	bool8	IsPatched;
 	int32	AutoSaveDelay;
 	bool8	DontSaveOopsSnapshot;
@@ -339,10 +345,15 @@ void S9xClearPause(uint32);
 void S9xExit(void);
 void S9xMessage(int, int, const char *);
 
-extern struct SSettings			Settings;
-extern struct SCPUState			CPU;
-extern struct STimings			Timings;
-extern struct SSNESGameFixes	SNESGameFixes;
-extern char						String[513];
+extern S9X_INSTANCE struct SSettings			Settings;
+extern S9X_INSTANCE struct SCPUState			CPU;
+extern S9X_INSTANCE struct STimings			Timings;
+extern S9X_INSTANCE struct SSNESGameFixes	SNESGameFixes;
+extern S9X_INSTANCE char						String[513];
+
+#ifdef S9X_MULTI_INSTANCE
+// Must be called on a thread before anything else touches its machine.
+void S9xInitInstance (void);
+#endif
 
 #endif
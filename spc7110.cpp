@@ -39,7 +39,7 @@
 #include "spc7110emu.h"
 #include "spc7110emu.cpp"
 
-SPC7110	s7emu;
+S9X_INSTANCE SPC7110	s7emu;
 
 static void SetSPC7110SRAMMap (uint8);
 
@@ -309,5 +309,8 @@ void S9xSPC7110PostLoadState (int version)
 		s7emu.decomp.context[i].invert = s7snap.context[i].invert;
 	}
 
+	// The snapshot doesn't say how far into its stream the decompressor is.
+	s7emu.decomp.cache_detach();
+
 	s7emu.update_time(0);
 }
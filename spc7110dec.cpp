@@ -32,6 +32,7 @@ uint8 SPC7110Decomp::read() {
   uint8 data = decomp_buffer[decomp_buffer_rdoffset++];
   decomp_buffer_rdoffset &= decomp_buffer_size - 1;
   decomp_buffer_length--;
+  if(stream && ++stream_index % checkpoint_interval == 0) save_checkpoint();
   return data;
 }
 
@@ -51,6 +52,24 @@ void SPC7110Decomp::init(unsigned mode, unsigned offset, unsigned index) {
   decomp_mode = mode;
   decomp_offset = offset;
 
+  stream = 0;
+  stream_index = 0;
+
+  if(mode <= 2) {
+    stream = &cache[((uint64)mode << 32) + offset];
+
+    //resume from the last checkpoint at or before the requested index
+    unsigned n = index / checkpoint_interval;
+    if(n > stream->size()) n = stream->size();
+    if(n) {
+      load_checkpoint((*stream)[n - 1]);
+      stream_index = n * checkpoint_interval;
+      index -= stream_index;
+      while(index--) read();
+      return;
+    }
+  }
+
   decomp_buffer_rdoffset = 0;
   decomp_buffer_wroffset = 0;
   decomp_buffer_length   = 0;
@@ -71,11 +90,53 @@ void SPC7110Decomp::init(unsigned mode, unsigned offset, unsigned index) {
   while(index--) read();
 }
 
+void SPC7110Decomp::save_checkpoint() {
+  //checkpoints are only ever added in order, each following the last
+  if(stream_index / checkpoint_interval != stream->size() + 1) return;
+
+  if(cache_size + sizeof(Checkpoint) > cache_limit) {
+    cache_clear();
+    return;
+  }
+
+  Checkpoint c;
+  c.mode_state = mode_state;
+  memcpy(c.context, context, sizeof(context));
+  c.offset = decomp_offset;
+  memcpy(c.buffer, decomp_buffer, decomp_buffer_size);
+  c.rdoffset = decomp_buffer_rdoffset;
+  c.wroffset = decomp_buffer_wroffset;
+  c.length = decomp_buffer_length;
+
+  stream->push_back(c);
+  cache_size += sizeof(Checkpoint);
+}
+
+void SPC7110Decomp::load_checkpoint(const Checkpoint &c) {
+  mode_state = c.mode_state;
+  memcpy(context, c.context, sizeof(context));
+  decomp_offset = c.offset;
+  memcpy(decomp_buffer, c.buffer, decomp_buffer_size);
+  decomp_buffer_rdoffset = c.rdoffset;
+  decomp_buffer_wroffset = c.wroffset;
+  decomp_buffer_length = c.length;
+}
+
+void SPC7110Decomp::cache_detach() {
+  stream = 0;
+}
+
+void SPC7110Decomp::cache_clear() {
+  cache.clear();
+  cache_size = 0;
+  stream = 0;
+}
+
 //
 
 void SPC7110Decomp::mode0(bool init) {
-  static uint8 val, in, span;
-  static int out, inverts, lps, in_count;
+  uint8 &val = mode_state.val, &in = mode_state.in, &span = mode_state.span;
+  int &out = mode_state.out, &inverts = mode_state.inverts, &lps = mode_state.lps, &in_count = mode_state.in_count;
 
   if(init == true) {
     out = inverts = lps = 0;
@@ -141,9 +202,9 @@ void SPC7110Decomp::mode0(bool init) {
 }
 
 void SPC7110Decomp::mode1(bool init) {
-  static unsigned pixelorder[4], realorder[4];
-  static uint8 in, val, span;
-  static int out, inverts, lps, in_count;
+  unsigned *pixelorder = mode_state.pixelorder, *realorder = mode_state.realorder;
+  uint8 &in = mode_state.in, &val = mode_state.val, &span = mode_state.span;
+  int &out = mode_state.out, &inverts = mode_state.inverts, &lps = mode_state.lps, &in_count = mode_state.in_count;
 
   if(init == true) {
     for(unsigned i = 0; i < 4; i++) pixelorder[i] = i;
@@ -244,10 +305,10 @@ void SPC7110Decomp::mode1(bool init) {
 }
 
 void SPC7110Decomp::mode2(bool init) {
-  static unsigned pixelorder[16], realorder[16];
-  static uint8 bitplanebuffer[16], buffer_index;
-  static uint8 in, val, span;
-  static int out0, out1, inverts, lps, in_count;
+  unsigned *pixelorder = mode_state.pixelorder, *realorder = mode_state.realorder;
+  uint8 *bitplanebuffer = mode_state.bitplanebuffer, &buffer_index = mode_state.buffer_index;
+  uint8 &in = mode_state.in, &val = mode_state.val, &span = mode_state.span;
+  int &out0 = mode_state.out0, &out1 = mode_state.out1, &inverts = mode_state.inverts, &lps = mode_state.lps, &in_count = mode_state.in_count;
 
   if(init == true) {
     for(unsigned i = 0; i < 16; i++) pixelorder[i] = i;
@@ -495,10 +556,14 @@ void SPC7110Decomp::reset() {
   decomp_buffer_rdoffset = 0;
   decomp_buffer_wroffset = 0;
   decomp_buffer_length   = 0;
+
+  //the ROM may have changed
+  cache_clear();
 }
 
 SPC7110Decomp::SPC7110Decomp() {
   decomp_buffer = new uint8[decomp_buffer_size];
+  memset(&mode_state, 0, sizeof(mode_state));
   reset();
 
   //initialize reverse morton lookup tables
@@ -19,6 +19,9 @@
 #ifndef _SPC7110DEC_H_
 #define _SPC7110DEC_H_
 
+#include <map>
+#include <vector>
+
 class SPC7110Decomp {
 public:
   uint8 read();
@@ -53,6 +56,39 @@ public:
     uint8 invert;
   } context[32];
 
+  //decoder state carried between calls to mode0/1/2
+  struct ModeState {
+    unsigned pixelorder[16], realorder[16];
+    uint8 bitplanebuffer[16], buffer_index;
+    uint8 in, val, span;
+    int out, out0, out1, inverts, lps, in_count;
+  } mode_state;
+
+  //decompression cache: the full decoder state is kept every
+  //checkpoint_interval bytes into each (mode, offset) stream, so that init()
+  //with a large index resumes from the nearest one rather than decompressing
+  //from the start of the stream. it is derived from ROM data alone, so it is
+  //never saved in snapshots; one loaded mid-stream just stops adding to it.
+  enum { checkpoint_interval = 1024, cache_limit = 8 << 20 };
+
+  struct Checkpoint {
+    ModeState mode_state;
+    ContextState context[32];
+    unsigned offset;
+    uint8 buffer[decomp_buffer_size];
+    unsigned rdoffset, wroffset, length;
+  };
+
+  std::map<uint64, std::vector<Checkpoint> > cache;
+  std::vector<Checkpoint> *stream;  //checkpoints of the stream being read, if any
+  unsigned stream_index;            //bytes read from it so far
+  size_t cache_size;
+
+  void save_checkpoint();
+  void load_checkpoint(const Checkpoint &c);
+  void cache_detach();
+  void cache_clear();
+
   uint8 probability(unsigned n);
   uint8 next_lps(unsigned n);
   uint8 next_mps(unsigned n);
@@ -34,7 +34,7 @@ static inline unsigned min (unsigned a, unsigned b)
 #include "srtcemu.h"
 #include "srtcemu.cpp"
 
-static SRTC	srtcemu;
+S9X_INSTANCE_STATIC SRTC	srtcemu;
 
 
 void S9xInitSRTC (void)
@@ -19,8 +19,8 @@ struct SSRTCSnapshot
 	int32	rtc_index;	// signed
 };
 
-extern struct SRTCData		RTCData;
-extern struct SSRTCSnapshot	srtcsnap;
+extern S9X_INSTANCE struct SRTCData		RTCData;
+extern S9X_INSTANCE struct SSRTCSnapshot	srtcsnap;
 
 void S9xInitSRTC (void);
 void S9xResetSRTC (void);
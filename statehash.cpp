@@ -0,0 +1,328 @@
+/*****************************************************************************\
+     Snes9x - Portable Super Nintendo Entertainment System (TM) emulator.
+                This file is licensed under the Snes9x License.
+   For further information, consult the LICENSE file in the root directory.
+\*****************************************************************************/
+
+// The hash is XXH64 over each region, fed in a fixed little-endian order so
+// that big and little endian hosts agree. Registers are serialized field by
+// field rather than hashed as structs, which would pick up padding and
+// host-specific layout.
+
+#include "snes9x.h"
+#include "memmap.h"
+#include "cpuexec.h"
+#include "sa1.h"
+#include "fxinst.h"
+#include "fxemu.h"
+#include "statehash.h"
+#include "apu/bapu/snes/snes.hpp"
+
+#define PRIME64_1	0x9E3779B185EBCA87ULL
+#define PRIME64_2	0xC2B2AE3D27D4EB4FULL
+#define PRIME64_3	0x165667B19E3779F9ULL
+#define PRIME64_4	0x85EBCA77C2B2AE63ULL
+#define PRIME64_5	0x27D4EB2F165667C5ULL
+
+static const char	*region_names[STATE_HASH_REGIONS] =
+{
+	"CPU",
+	"WRAM",
+	"VRAM",
+	"OAM",
+	"CGRAM",
+	"I/O",
+	"SRAM",
+	"APU",
+	"Coprocessor"
+};
+
+struct hash_buffer
+{
+	uint8	data[256];
+	uint32	len;
+
+	hash_buffer () : len(0) { }
+
+	void put8 (uint8 v)    { data[len++] = v; }
+	void put16 (uint16 v)  { WRITE_WORD(data + len, v); len += 2; }
+	void put32 (uint32 v)  { WRITE_DWORD(data + len, v); len += 4; }
+};
+
+static inline uint64 rotl64 (uint64 x, int r)
+{
+	return ((x << r) | (x >> (64 - r)));
+}
+
+static inline uint64 read_le64 (const uint8 *p)
+{
+#ifdef LSB_FIRST
+	uint64	v;
+	memcpy(&v, p, 8);
+	return (v);
+#else
+	return ((uint64) READ_DWORD(p) | ((uint64) READ_DWORD(p + 4) << 32));
+#endif
+}
+
+static inline uint32 read_le32 (const uint8 *p)
+{
+#ifdef LSB_FIRST
+	uint32	v;
+	memcpy(&v, p, 4);
+	return (v);
+#else
+	return (READ_DWORD(p));
+#endif
+}
+
+static inline uint64 hash_round (uint64 acc, uint64 input)
+{
+	acc += input * PRIME64_2;
+	acc  = rotl64(acc, 31);
+	return (acc * PRIME64_1);
+}
+
+static inline uint64 hash_merge (uint64 acc, uint64 val)
+{
+	acc ^= hash_round(0, val);
+	return (acc * PRIME64_1 + PRIME64_4);
+}
+
+static inline uint64 hash_avalanche (uint64 h)
+{
+	h ^= h >> 33;
+	h *= PRIME64_2;
+	h ^= h >> 29;
+	h *= PRIME64_3;
+	h ^= h >> 32;
+	return (h);
+}
+
+static uint64 hash_block (const uint8 *p, uint32 len, uint64 seed)
+{
+	const uint8	*end = p + len;
+	uint64		h;
+
+	if (len >= 32)
+	{
+		const uint8	*limit = end - 32;
+		uint64		v1 = seed + PRIME64_1 + PRIME64_2;
+		uint64		v2 = seed + PRIME64_2;
+		uint64		v3 = seed;
+		uint64		v4 = seed - PRIME64_1;
+
+		do
+		{
+			v1 = hash_round(v1, read_le64(p));
+			v2 = hash_round(v2, read_le64(p + 8));
+			v3 = hash_round(v3, read_le64(p + 16));
+			v4 = hash_round(v4, read_le64(p + 24));
+			p += 32;
+		} while (p <= limit);
+
+		h = rotl64(v1, 1) + rotl64(v2, 7) + rotl64(v3, 12) + rotl64(v4, 18);
+		h = hash_merge(h, v1);
+		h = hash_merge(h, v2);
+		h = hash_merge(h, v3);
+		h = hash_merge(h, v4);
+	}
+	else
+		h = seed + PRIME64_5;
+
+	h += len;
+
+	for (; p + 8 <= end; p += 8)
+	{
+		h ^= hash_round(0, read_le64(p));
+		h  = rotl64(h, 27) * PRIME64_1 + PRIME64_4;
+	}
+
+	if (p + 4 <= end)
+	{
+		h ^= (uint64) read_le32(p) * PRIME64_1;
+		h  = rotl64(h, 23) * PRIME64_2 + PRIME64_3;
+		p += 4;
+	}
+
+	for (; p < end; p++)
+	{
+		h ^= *p * PRIME64_5;
+		h  = rotl64(h, 11) * PRIME64_1;
+	}
+
+	return (hash_avalanche(h));
+}
+
+static uint64 hash_cpu (void)
+{
+	hash_buffer	b;
+
+	b.put8(Registers.PB);
+	b.put16(Registers.PCw);
+	b.put16(Registers.A.W);
+	b.put16(Registers.X.W);
+	b.put16(Registers.Y.W);
+	b.put16(Registers.D.W);
+	b.put16(Registers.S.W);
+	b.put8(Registers.DB);
+	b.put16((Registers.P.W & ~(Zero | Negative | Carry | Overflow)) |
+		ICPU._Carry | ((ICPU._Zero == 0) << 1) | (ICPU._Negative & 0x80) | (ICPU._Overflow << 6));
+	b.put32(CPU.Cycles);
+	b.put32(CPU.V_Counter);
+	b.put8(CPU.NMIPending);
+	b.put8(CPU.IRQLine);
+	b.put8(CPU.WaitingForInterrupt);
+
+	return (hash_block(b.data, b.len, STATE_HASH_CPU));
+}
+
+static uint64 hash_vram (void)
+{
+	uint64	h = STATE_HASH_VRAM;
+
+	for (int i = 0; i < STATE_HASH_VRAM_BLOCKS; i++)
+	{
+		if (!StateHash.VRAMHashed[i])
+		{
+			StateHash.VRAMBlock[i]  = hash_block(Memory.VRAM + (i << STATE_HASH_VRAM_BLOCK_SHIFT), 1 << STATE_HASH_VRAM_BLOCK_SHIFT, i);
+			StateHash.VRAMHashed[i] = TRUE;
+		}
+
+		h = hash_merge(h, StateHash.VRAMBlock[i]);
+	}
+
+	return (hash_avalanche(h));
+}
+
+static uint64 hash_cgram (void)
+{
+	uint8	cgram[sizeof(PPU.CGDATA)];
+
+	for (int i = 0; i < 256; i++)
+		WRITE_WORD(cgram + i * 2, PPU.CGDATA[i]);
+
+	return (hash_block(cgram, sizeof(cgram), STATE_HASH_CGRAM));
+}
+
+static uint32 sram_bytes (void)
+{
+	uint32	size = Memory.SRAMSize ? (1 << (Memory.SRAMSize + 3)) * 128 : 0;
+
+	if (Settings.SuperFX && size < SuperFX.nRamBanks * 0x10000)
+		size = SuperFX.nRamBanks * 0x10000;
+
+	return (size < Memory.SRAM_SIZE ? size : Memory.SRAM_SIZE);
+}
+
+static uint64 hash_apu (void)
+{
+	hash_buffer	b;
+
+	b.put16(SNES::smp.regs.pc);
+	b.put8(SNES::smp.regs.sp);
+	b.put8(SNES::smp.regs.B.a);
+	b.put8(SNES::smp.regs.B.y);
+	b.put8(SNES::smp.regs.x);
+	b.put8((unsigned) SNES::smp.regs.p);
+	b.put32(SNES::smp.clock);
+	b.put32(SNES::dsp.clock);
+	for (int i = 0; i < 4; i++)
+		b.put8(SNES::cpu.registers[i]);
+	for (int i = 0; i < 128; i++)
+		b.put8(SNES::dsp.spc_dsp.read(i));
+
+	return (hash_block(SNES::smp.apuram, 0x10000, hash_block(b.data, b.len, STATE_HASH_APU)));
+}
+
+static uint64 hash_coprocessor (void)
+{
+	hash_buffer	b;
+	uint64		h = STATE_HASH_COPROCESSOR;
+
+	if (Settings.SA1)
+	{
+		b.put8(SA1Registers.PB);
+		b.put16(SA1Registers.PCw);
+		b.put16(SA1Registers.A.W);
+		b.put16(SA1Registers.X.W);
+		b.put16(SA1Registers.Y.W);
+		b.put16(SA1Registers.D.W);
+		b.put16(SA1Registers.S.W);
+		b.put8(SA1Registers.DB);
+		b.put16(SA1Registers.P.W);
+		b.put8(SA1._Carry);
+		b.put8(SA1._Zero);
+		b.put8(SA1._Negative);
+		b.put8(SA1._Overflow);
+		b.put32(SA1.Cycles);
+	}
+
+	if (Settings.SuperFX)
+	{
+		for (int i = 0; i < 16; i++)
+			b.put32(GSU.avReg[i]);
+		b.put32(GSU.vColorReg);
+		b.put32(GSU.vPlotOptionReg);
+		b.put32(GSU.vStatusReg);
+		b.put32(GSU.vPrgBankReg);
+		b.put32(GSU.vRomBankReg);
+		b.put32(GSU.vRamBankReg);
+		b.put32(GSU.vCacheBaseReg);
+	}
+
+	if (b.len)
+		h = hash_block(b.data, b.len, h);
+
+	if (Settings.C4)
+		h = hash_block(Memory.C4RAM, 8192, h);
+
+	if (Settings.OBC1)
+		h = hash_block(Memory.OBC1RAM, 8192, h);
+
+	return (h);
+}
+
+void S9xStateHashRegions (uint64 hashes[STATE_HASH_REGIONS])
+{
+	hashes[STATE_HASH_CPU]         = hash_cpu();
+	hashes[STATE_HASH_WRAM]        = hash_block(Memory.RAM, sizeof(Memory.RAM), STATE_HASH_WRAM);
+	hashes[STATE_HASH_VRAM]        = hash_vram();
+	hashes[STATE_HASH_OAM]         = hash_block(PPU.OAMData, sizeof(PPU.OAMData), STATE_HASH_OAM);
+	hashes[STATE_HASH_CGRAM]       = hash_cgram();
+	hashes[STATE_HASH_IO]          = hash_block(Memory.FillRAM, 0x8000, STATE_HASH_IO);
+	hashes[STATE_HASH_SRAM]        = hash_block(Memory.SRAM, sram_bytes(), STATE_HASH_SRAM);
+	hashes[STATE_HASH_APU]         = hash_apu();
+	hashes[STATE_HASH_COPROCESSOR] = hash_coprocessor();
+}
+
+uint64 S9xStateHash (void)
+{
+	uint64	hashes[STATE_HASH_REGIONS];
+	uint64	h = PRIME64_5;
+
+	S9xStateHashRegions(hashes);
+
+	for (int i = 0; i < STATE_HASH_REGIONS; i++)
+		h = hash_merge(h, hashes[i]);
+
+	return (hash_avalanche(h));
+}
+
+uint64 S9xStateHashData (const uint8 *data, uint32 len)
+{
+	return (hash_block(data, len, 0));
+}
+
+const char * S9xStateHashRegionName (int region)
+{
+	if (region < 0 || region >= STATE_HASH_REGIONS)
+		return ("");
+
+	return (region_names[region]);
+}
+
+void S9xStateHashInvalidate (void)
+{
+	memset(StateHash.VRAMHashed, 0, sizeof(StateHash.VRAMHashed));
+}
@@ -0,0 +1,55 @@
+/*****************************************************************************\
+     Snes9x - Portable Super Nintendo Entertainment System (TM) emulator.
+                This file is licensed under the Snes9x License.
+   For further information, consult the LICENSE file in the root directory.
+\*****************************************************************************/
+
+#ifndef _STATEHASH_H_
+#define _STATEHASH_H_
+
+// Fast non-cryptographic 64-bit hash over the emulated machine state.
+// Two instances that report the same hash for the same frame are, for all
+// practical purposes, in the same state; netplay and movie playback use it
+// to detect desyncs without transferring snapshots.
+
+#define STATE_HASH_VRAM_BLOCK_SHIFT	10
+#define STATE_HASH_VRAM_BLOCKS		(0x10000 >> STATE_HASH_VRAM_BLOCK_SHIFT)
+
+enum
+{
+	STATE_HASH_CPU,			// 65c816 registers and timing
+	STATE_HASH_WRAM,
+	STATE_HASH_VRAM,
+	STATE_HASH_OAM,
+	STATE_HASH_CGRAM,
+	STATE_HASH_IO,			// FillRAM: I/O registers, SA-1 I-RAM, GSU registers
+	STATE_HASH_SRAM,		// cartridge RAM: SRAM, SA-1 BW-RAM, GSU RAM
+	STATE_HASH_APU,			// SPC700 registers, ARAM and DSP registers
+	STATE_HASH_COPROCESSOR,	// SA-1 and GSU cores, C4 and OBC1 RAM
+	STATE_HASH_REGIONS
+};
+
+struct SStateHash
+{
+	// VRAM is only written through $2118/$2119, so its hash is kept per block
+	// and a block is only rehashed after one of those writes cleared its flag.
+	bool8	VRAMHashed[STATE_HASH_VRAM_BLOCKS];
+	uint64	VRAMBlock[STATE_HASH_VRAM_BLOCKS];
+};
+
+extern S9X_INSTANCE struct SStateHash	StateHash;
+
+static inline void S9xStateHashMarkVRAM (uint32 address)
+{
+	StateHash.VRAMHashed[address >> STATE_HASH_VRAM_BLOCK_SHIFT] = FALSE;
+}
+
+uint64 S9xStateHash (void);
+void S9xStateHashRegions (uint64 hashes[STATE_HASH_REGIONS]);
+const char * S9xStateHashRegionName (int);
+// The same hash over an arbitrary buffer, for content addressing.
+uint64 S9xStateHashData (const uint8 *, uint32);
+// Must be called after writing Memory.VRAM directly, bypassing the PPU ports.
+void S9xStateHashInvalidate (void);
+
+#endif
@@ -170,7 +170,8 @@ size_t unzStream::buffer_remaining()
 void unzStream::fill_buffer()
 {
     buf_pos_in_unzipped = unztell(file);
-    bytes_in_buf = unzReadCurrentFile(file, buffer, unz_BUFFSIZ);
+    int bytes = unzReadCurrentFile(file, buffer, unz_BUFFSIZ);
+    bytes_in_buf = bytes > 0 ? bytes : 0;
     pos_in_buf = 0;
 }
 
@@ -235,7 +236,25 @@ size_t unzStream::read (void *buf, size_t len)
         }
 
         memcpy(read_to, buffer + pos_in_buf, in_buffer);
+        read_to += in_buffer;
         to_read -= in_buffer;
+
+        // inflate large reads straight into the destination
+        if (to_read >= unz_BUFFSIZ)
+        {
+            int bytes = unzReadCurrentFile(file, read_to, to_read);
+            if (bytes > 0)
+            {
+                read_to += bytes;
+                to_read -= bytes;
+            }
+            buf_pos_in_unzipped = unztell(file);
+            bytes_in_buf = 0;
+            pos_in_buf = 0;
+            if (bytes <= 0 || to_read == 0)
+                break;
+        }
+
         fill_buffer();
     } while (bytes_in_buf);
 
@@ -54,7 +54,7 @@ class fStream : public Stream
 #    include "unzip.h"
 #  endif
 
-#define unz_BUFFSIZ	1024
+#define unz_BUFFSIZ	0x10000
 
 class unzStream : public Stream
 {
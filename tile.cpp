@@ -10,9 +10,9 @@ using namespace TileImpl;
 
 namespace {
 
-	uint32	pixbit[8][16];
-	uint8	hrbit_odd[256];
-	uint8	hrbit_even[256];
+	S9X_INSTANCE uint32	pixbit[8][16];
+	S9X_INSTANCE uint8	hrbit_odd[256];
+	S9X_INSTANCE uint8	hrbit_even[256];
 
 	// Here are the tile converters, selected by S9xSelectTileConverter().
 	// Really, except for the definition of DOBIT and the number of times it is called, they're all the same.
@@ -11,4 +11,83 @@ void S9xInitTileRenderer (void);
 void S9xSelectTileRenderers (int, bool8, bool8);
 void S9xSelectTileConverter (int, bool8, bool8, bool8);
 
+// Chunky to planar conversion, the reverse of what the tile converters do, for
+// the SA-1's character conversion and the SuperFX's PLOT. A row of eight
+// pixels is held one byte a pixel in a uint64, leftmost pixel in the top byte,
+// and is turned into bitplanes with an 8x8 bit transpose, plane n in byte n
+// and the leftmost pixel in bit 7 of each.
+
+static inline uint64 S9xPlanarRow (uint64 c)
+{
+	uint64	t;
+
+	t = (c ^ (c >>  7)) & 0x00aa00aa00aa00aaULL;
+	c ^= t ^ (t <<  7);
+	t = (c ^ (c >> 14)) & 0x0000cccc0000ccccULL;
+	c ^= t ^ (t << 14);
+	t = (c ^ (c >> 28)) & 0x00000000f0f0f0f0ULL;
+	c ^= t ^ (t << 28);
+
+	return (c);
+}
+
+// Reads a row of eight pixels packed depth bits to a pixel, leftmost pixel in
+// the low bits of the first byte, as the SA-1 keeps bitmaps in BW-RAM.
+static inline uint64 S9xChunkyRow (const uint8 *q, int depth)
+{
+	uint64	c;
+
+	switch (depth)
+	{
+		case 2:
+			c = q[0] | (q[1] << 8);
+			c = (c | (c << 24)) & 0x000000ff000000ffULL;
+			c = (c | (c << 12)) & 0x000f000f000f000fULL;
+			c = (c | (c <<  6)) & 0x0303030303030303ULL;
+			break;
+
+		case 4:
+			c = q[0] | (q[1] << 8) | (q[2] << 16) | ((uint32) q[3] << 24);
+			c = (c | (c << 16)) & 0x0000ffff0000ffffULL;
+			c = (c | (c <<  8)) & 0x00ff00ff00ff00ffULL;
+			c = (c | (c <<  4)) & 0x0f0f0f0f0f0f0f0fULL;
+			break;
+
+		default:
+			c = 0;
+			for (int i = 0; i < 8; i++)
+				c = (c << 8) | q[i];
+			return (c);
+	}
+
+	// The leftmost pixel is in the low byte so far.
+	c = ((c & 0x00ff00ff00ff00ffULL) <<  8) | ((c >>  8) & 0x00ff00ff00ff00ffULL);
+	c = ((c & 0x0000ffff0000ffffULL) << 16) | ((c >> 16) & 0x0000ffff0000ffffULL);
+	c = (c << 32) | (c >> 32);
+
+	return (c);
+}
+
+// Writes the first depth planes of a row to the character row at p, where the
+// planes are stored in pairs 16 bytes apart.
+static inline void S9xStorePlanarRow (uint8 *p, uint64 planes, int depth)
+{
+	p[ 0] = (uint8) planes;
+	p[ 1] = (uint8) (planes >>  8);
+
+	if (depth > 2)
+	{
+		p[16] = (uint8) (planes >> 16);
+		p[17] = (uint8) (planes >> 24);
+	}
+
+	if (depth > 4)
+	{
+		p[32] = (uint8) (planes >> 32);
+		p[33] = (uint8) (planes >> 40);
+		p[48] = (uint8) (planes >> 48);
+		p[49] = (uint8) (planes >> 56);
+	}
+}
+
 #endif
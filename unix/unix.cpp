@@ -57,6 +57,7 @@
 #endif
 #ifdef DEBUGGER
 #include "debug.h"
+#include "profile.h"
 #endif
 #include "statemanager.h"
 
@@ -89,6 +90,11 @@ static const char	*s9x_base_dir        = NULL,
 					*play_smv_filename   = NULL,
 					*record_smv_filename = NULL;
 
+#ifdef DEBUGGER
+static const char	*decode_trace_filename = NULL;
+static STraceFilter	decode_trace_filter = { 0, 0xffffff, 0, 0xffffffff };
+#endif
+
 static char		default_dir[PATH_MAX + 1];
 
 static const char	dirNames[13][32] =
@@ -382,6 +388,15 @@ void S9xExtraUsage (void)
 	S9xMessage(S9X_INFO, S9X_USAGE, "-rwgranularity                  Rewind granularity in frames");
 	S9xMessage(S9X_INFO, S9X_USAGE, "");
 
+#ifdef DEBUGGER
+	S9xMessage(S9X_INFO, S9X_USAGE, "-decodetrace <filename>         Print a binary instruction trace as text and exit");
+	S9xMessage(S9X_INFO, S9X_USAGE, "-tracerange <from> <to>         Only print instructions at these hex addresses");
+	S9xMessage(S9X_INFO, S9X_USAGE, "                                (use with -decodetrace)");
+	S9xMessage(S9X_INFO, S9X_USAGE, "-traceframes <first> <last>     Only print instructions in these frames");
+	S9xMessage(S9X_INFO, S9X_USAGE, "                                (use with -decodetrace)");
+	S9xMessage(S9X_INFO, S9X_USAGE, "");
+#endif
+
 	S9xExtraDisplayUsage();
 }
 
@@ -497,6 +512,38 @@ void S9xParseArg (char **argv, int &i, int argc)
 			S9xUsage();
 	}
 	else
+#ifdef DEBUGGER
+	if (!strcasecmp(argv[i], "-decodetrace"))
+	{
+		if (i + 1 < argc)
+			decode_trace_filename = argv[++i];
+		else
+			S9xUsage();
+	}
+	else
+	if (!strcasecmp(argv[i], "-tracerange"))
+	{
+		if (i + 2 < argc)
+		{
+			decode_trace_filter.From = strtoul(argv[++i], NULL, 16);
+			decode_trace_filter.To   = strtoul(argv[++i], NULL, 16);
+		}
+		else
+			S9xUsage();
+	}
+	else
+	if (!strcasecmp(argv[i], "-traceframes"))
+	{
+		if (i + 2 < argc)
+		{
+			decode_trace_filter.FirstFrame = strtoul(argv[++i], NULL, 10);
+			decode_trace_filter.LastFrame  = strtoul(argv[++i], NULL, 10);
+		}
+		else
+			S9xUsage();
+	}
+	else
+#endif
 		S9xParseDisplayArg(argv, i, argc);
 }
 
@@ -819,6 +866,13 @@ void S9xSyncSpeed (void)
 		return;
 
 #ifdef NETPLAY_SUPPORT
+	if (Settings.NetPlay && NetPlay.Connected && NetPlay.Rollback)
+	{
+		// Frames re-run after a rollback are neither timed nor shown.
+		if (NPRollback.Resimulating)
+			return;
+	}
+	else
 	if (Settings.NetPlay && NetPlay.Connected)
 	{
 	#if defined(NP_DEBUG) && NP_DEBUG == 2
@@ -1597,6 +1651,14 @@ void S9xExit (void)
 	delete s_AudioOutput;
 #endif
 
+#ifdef DEBUGGER
+	if (S9xProfile.Targets)
+	{
+		S9xProfileStop();
+		S9xProfileWrite();
+	}
+#endif
+
 	Memory.SaveSRAM(S9xGetFilename(".srm", SRAM_DIR).c_str());
 	S9xResetSaveTimer(FALSE);
 	S9xSaveCheatFile(S9xGetFilename(".cht", CHEAT_DIR));
@@ -1687,6 +1749,19 @@ int main (int argc, char **argv)
 		exit(1);
 	}
 
+#ifdef DEBUGGER
+	if (decode_trace_filename)
+	{
+		bool8	decoded = S9xDecodeTrace(decode_trace_filename, stdout, &decode_trace_filter);
+		if (!decoded)
+			fprintf(stderr, "Snes9x: %s is not a binary trace.\n", decode_trace_filename);
+
+		Memory.Deinit();
+		S9xDeinitAPU();
+		exit(decoded ? 0 : 1);
+	}
+#endif
+
 	S9xInitSound(0);
 	S9xSetSoundMute(TRUE);
 
@@ -1790,6 +1865,7 @@ int main (int argc, char **argv)
 	if (Settings.NetPlay)
 	{
 		NetPlay.MaxFrameSkip = 10;
+		NetPlay.RollbackCapable = TRUE;
 
 		unixSettings.rewindBufferSize = 0;
 
@@ -1853,7 +1929,7 @@ int main (int argc, char **argv)
 	#ifdef NETPLAY_SUPPORT
 		if (NP_Activated)
 		{
-			if (NetPlay.PendingWait4Sync && !S9xNPWaitForHeartBeatDelay(100))
+			if (!NetPlay.Rollback && NetPlay.PendingWait4Sync && !S9xNPWaitForHeartBeatDelay(100))
 			{
 				S9xProcessEvents(FALSE);
 				continue;
@@ -1862,12 +1938,24 @@ int main (int argc, char **argv)
 			for (int J = 0; J < 8; J++)
 				old_joypads[J] = MovieGetJoypad(J);
 
-			for (int J = 0; J < 8; J++)
-				MovieSetJoypad(J, joypads[J]);
+			if (NetPlay.Rollback)
+			{
+				// Input for the next frame is set here, confirmed or predicted.
+				if (!Settings.Paused && NetPlay.Connected && !S9xNPRollbackUpdate(old_joypads[0]))
+				{
+					S9xProcessEvents(FALSE);
+					continue;
+				}
+			}
+			else
+			{
+				for (int J = 0; J < 8; J++)
+					MovieSetJoypad(J, joypads[J]);
+			}
 
 			if (NetPlay.Connected)
 			{
-				if (NetPlay.PendingWait4Sync)
+				if (!NetPlay.Rollback && NetPlay.PendingWait4Sync)
 				{
 					NetPlay.PendingWait4Sync = FALSE;
 					NetPlay.FrameCount++;
@@ -3437,6 +3437,10 @@ int WINAPI WinMain(
         }
 
 #ifdef NETPLAY_SUPPORT
+        // Between frames, even while waiting for the server.
+        if (Settings.NetPlay)
+            S9xNPServeFreeze ();
+
         if (!Settings.NetPlay || !NetPlay.PendingWait4Sync ||
             WaitForSingleObject (GUI.ClientSemaphore, 100) != WAIT_TIMEOUT)
         {